@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+    struct Benchmark {
+        const char* name;
+        void (*function)();
+    };
+
+    inline std::vector<Benchmark>& registry() {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    struct Registration {
+        Registration(const char* name, void (*function)()) {
+            registry().push_back({name, function});
+        }
+    };
+
+    // Number of heap allocations made so far by the process.
+    uint64_t getAllocationCount();
+
+    // Prevent the compiler from optimizing away a computed value.
+    template <typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        static volatile const void* sink;
+        sink = &value;
+#else
+        asm volatile("" : : "r,m"(value) : "memory");
+#endif
+    }
+
+    // Run the function until enough time elapsed to get a stable measurement, and print the average time per call.
+    // The optional items count is used to report a throughput.
+    inline double measure(const std::string& label,
+                          const std::function<void()>& function,
+                          uint64_t items = 0,
+                          bool itemsAreBytes = false) {
+        using namespace std::chrono;
+
+        function(); // Warm up.
+
+        uint64_t iterations = 1;
+        double elapsed = 0;
+        while (true) {
+            const auto start = steady_clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                function();
+            }
+            elapsed = duration<double>(steady_clock::now() - start).count();
+            if (elapsed > 0.2 || iterations >= (1ull << 30)) {
+                break;
+            }
+            iterations *= elapsed > 0.02 ? 2 : 10;
+        }
+
+        const double perCall = elapsed / iterations;
+        if (items && itemsAreBytes) {
+            printf("  %-56s %12.3f us/op %12.2f GB/s\n", label.c_str(), perCall * 1e6, items / perCall / 1e9);
+        } else if (items) {
+            printf("  %-56s %12.3f us/op %12.1f Mitems/s\n", label.c_str(), perCall * 1e6, items / perCall / 1e6);
+        } else {
+            printf("  %-56s %12.3f us/op\n", label.c_str(), perCall * 1e6);
+        }
+        return perCall;
+    }
+
+} // namespace Bench
+
+#define BENCHMARK(name)                                                                                                \
+    static void name();                                                                                                \
+    static Bench::Registration name##_registration(#name, name);                                                       \
+    static void name()
@@ -0,0 +1,143 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <vector>
+
+#include "bench.h"
+#include "capture_source.h"
+
+namespace {
+
+    // A source whose frames and surfaces are set by the test.
+    class FakeCaptureSource : public Capture::ICaptureSource {
+      public:
+        uint64_t update() override {
+            return m_sequence;
+        }
+
+        void* getSurface() const override {
+            return m_surface;
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_desc;
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return {m_desc.width, m_desc.height};
+        }
+
+        uint64_t getLatency() const override {
+            return 0;
+        }
+
+        void setPaused(bool) override {
+        }
+
+        void getAllocations(GpuMemory::Level, std::vector<GpuMemory::Allocation>&) const override {
+        }
+
+        void setMemoryLevel(GpuMemory::Level) override {
+        }
+
+        // Deliver a frame, into the given surface.
+        void deliver(void* surface, uint64_t frames = 1) {
+            m_sequence += frames;
+            m_surface = surface;
+        }
+
+      private:
+        Capture::SurfaceDesc m_desc{1280, 720, 28};
+        uint64_t m_sequence = 0;
+        void* m_surface = nullptr;
+    };
+
+    bool isEqual(const Capture::FrameStats& stats, uint64_t delivered, uint64_t rebound, uint64_t skipped) {
+        return stats.delivered == delivered && stats.rebound == rebound && stats.skipped == skipped;
+    }
+
+    size_t check() {
+        size_t failures = 0;
+        int surfaces[2];
+
+        FakeCaptureSource source;
+        Capture::FrameBinder binder;
+        const auto update = [&] { return binder.update(source.update(), source.getSurface()); };
+
+        // Nothing to bind before the first frame.
+        failures += update();
+        failures += !isEqual(binder.getStats(), 0, 0, 1);
+
+        // The first frame is bound, polling again without a new frame is skipped.
+        source.deliver(&surfaces[0]);
+        failures += !update();
+        failures += update();
+        failures += !isEqual(binder.getStats(), 1, 1, 2);
+
+        // A new frame in another surface is bound, a new frame in the bound surface (updated in place) is skipped.
+        source.deliver(&surfaces[1]);
+        failures += !update();
+        source.deliver(&surfaces[1]);
+        failures += update();
+        failures += !isEqual(binder.getStats(), 3, 2, 3);
+
+        // Several frames delivered between two polls are all counted.
+        source.deliver(&surfaces[0], 3);
+        failures += !update();
+        failures += !isEqual(binder.getStats(), 6, 3, 3);
+
+        // Invalidation forces a re-bind of the same frame, once.
+        binder.invalidate();
+        failures += !update();
+        failures += update();
+        failures += !isEqual(binder.getStats(), 6, 4, 4);
+
+        // Invalidation waits for a surface to bind.
+        binder.invalidate();
+        source.deliver(nullptr);
+        failures += update();
+        source.deliver(&surfaces[0]);
+        failures += !update();
+        failures += !isEqual(binder.getStats(), 8, 5, 5);
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(FrameBinder) {
+    printf("  Checks: %zu failed\n", check());
+
+    // A 45 FPS source alternating between 2 surfaces, polled at 90 Hz.
+    int surfaces[2];
+    FakeCaptureSource source;
+    Capture::FrameBinder binder;
+    uint64_t frame = 0;
+    Bench::measure("update, 45 FPS source polled at 90 Hz", [&] {
+        if (frame++ % 2 == 0) {
+            source.deliver(&surfaces[frame / 2 % 2]);
+        }
+        Bench::doNotOptimize(binder.update(source.update(), source.getSurface()));
+    });
+}
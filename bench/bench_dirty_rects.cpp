@@ -0,0 +1,225 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <random>
+
+#include "bench.h"
+#include "dirty_rects.h"
+
+namespace {
+
+    using DirtyRects::Rect;
+
+    struct Trace {
+        const char* name;
+        int32_t width;
+        int32_t height;
+        std::vector<std::vector<Rect>> frames;
+    };
+
+    // Synthetic traces reproducing the dirty regions typically reported by the capture API. They stand in for recorded
+    // traces, which would need a capture session.
+    std::vector<Trace> makeTraces() {
+        std::mt19937 random(42);
+        std::vector<Trace> traces;
+
+        // A blinking cursor and a clock on a 4K monitor.
+        {
+            Trace trace{"4K monitor, cursor and clock", 3840, 2160, {}};
+            for (int i = 0; i < 240; i++) {
+                std::vector<Rect> frame;
+                frame.push_back({1200 + (i / 30) * 9, 640, 2, 18});
+                if (i % 60 == 0) {
+                    frame.push_back({3700, 2110, 90, 40});
+                }
+                trace.frames.push_back(frame);
+            }
+            traces.push_back(trace);
+        }
+
+        // A chat window receiving messages, with the text scrolling up.
+        {
+            Trace trace{"1080p chat, scrolling", 1920, 1080, {}};
+            for (int i = 0; i < 240; i++) {
+                std::vector<Rect> frame;
+                if (i % 20 == 0) {
+                    frame.push_back({320, 80, 1500, 900});
+                }
+                frame.push_back({320, 1000, 200 + static_cast<int32_t>(random() % 1200), 24});
+                trace.frames.push_back(frame);
+            }
+            traces.push_back(trace);
+        }
+
+        // A dashboard with many small gauges updating independently.
+        {
+            Trace trace{"1440p dashboard, scattered gauges", 2560, 1440, {}};
+            for (int i = 0; i < 240; i++) {
+                std::vector<Rect> frame;
+                for (int j = 0; j < 24; j++) {
+                    if (random() % 3 == 0) {
+                        frame.push_back({(j % 6) * 420 + 40, (j / 6) * 350 + 40, 120, 60});
+                    }
+                }
+                trace.frames.push_back(frame);
+            }
+            traces.push_back(trace);
+        }
+
+        // A video playing in part of a 4K monitor.
+        {
+            Trace trace{"4K monitor, embedded video", 3840, 2160, {}};
+            for (int i = 0; i < 240; i++) {
+                trace.frames.push_back({{400, 300, 1280, 720}});
+            }
+            traces.push_back(trace);
+        }
+
+        return traces;
+    }
+
+    // Whether the plan is valid for the dirty regions of a frame: every dirty tile copied, tile-aligned rectangles
+    // within the surface and the budget, and a full copy instead above the threshold.
+    bool isValid(const DirtyRects::Plan& plan,
+                 const DirtyRects::Config& config,
+                 int32_t width,
+                 int32_t height,
+                 const std::vector<Rect>& dirty) {
+        if (plan.fullCopy) {
+            return plan.rects.empty();
+        }
+        if (plan.rects.size() > config.maxRects ||
+            plan.copiedArea(width, height) > static_cast<int64_t>(config.fullCopyThreshold * width * height)) {
+            return false;
+        }
+
+        const int32_t tileSize = config.tileSize;
+        for (const auto& rect : plan.rects) {
+            if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 || rect.x + rect.width > width ||
+                rect.y + rect.height > height || rect.x % tileSize || rect.y % tileSize ||
+                ((rect.x + rect.width) % tileSize && rect.x + rect.width != width) ||
+                ((rect.y + rect.height) % tileSize && rect.y + rect.height != height)) {
+                return false;
+            }
+        }
+
+        // The rectangles are tile-aligned, so a dirty pixel is covered if the top-left pixel of its tile is.
+        for (const auto& rect : dirty) {
+            const int32_t left = std::max(rect.x, 0);
+            const int32_t top = std::max(rect.y, 0);
+            const int32_t right = std::min(rect.x + rect.width, width);
+            const int32_t bottom = std::min(rect.y + rect.height, height);
+            for (int32_t y = top / tileSize * tileSize; y < bottom; y += tileSize) {
+                for (int32_t x = left / tileSize * tileSize; x < right; x += tileSize) {
+                    const bool covered = std::any_of(plan.rects.begin(), plan.rects.end(), [&](const Rect& copy) {
+                        return x >= copy.x && x < copy.x + copy.width && y >= copy.y && y < copy.y + copy.height;
+                    });
+                    if (!covered) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    size_t check(const std::vector<Trace>& traces) {
+        size_t failures = 0;
+        DirtyRects::TileMerger merger;
+        const DirtyRects::Config& config = merger.getConfig();
+
+        for (const auto& trace : traces) {
+            for (const auto& frame : trace.frames) {
+                const auto& plan = merger.plan(trace.width, trace.height, frame.data(), frame.size());
+                failures += !isValid(plan, config, trace.width, trace.height, frame);
+            }
+        }
+
+        // Nothing dirty, nothing to copy.
+        const auto& empty = merger.plan(1920, 1080, nullptr, 0);
+        failures += empty.fullCopy || !empty.rects.empty();
+
+        // Just under and just over the threshold, unaligned and partly outside of the surface.
+        const std::vector<Rect> under{{-10, -10, 900, 500}};
+        const auto& underPlan = merger.plan(1920, 1080, under.data(), under.size());
+        failures += underPlan.fullCopy || !isValid(underPlan, config, 1920, 1080, under);
+        const std::vector<Rect> over{{1000, 500, 1000, 600}};
+        failures += !merger.plan(1920, 1080, over.data(), over.size()).fullCopy;
+
+        // Too many scattered tiles to merge efficiently, even though few pixels are dirty.
+        std::vector<Rect> scattered;
+        for (int32_t i = 0; i < 100; i++) {
+            scattered.push_back({(i % 10) * 128 + 1, (i / 10) * 128 + 1, 1, 1});
+        }
+        failures += !merger.plan(1920, 1080, scattered.data(), scattered.size()).fullCopy;
+
+        // Fewer scattered tiles are merged within the budget.
+        scattered.resize(20);
+        const auto& merged = merger.plan(1920, 1080, scattered.data(), scattered.size());
+        failures += merged.fullCopy || merged.rects.size() > config.maxRects ||
+                    !isValid(merged, config, 1920, 1080, scattered);
+
+        // Partial tiles at the right and bottom edges are clipped to the surface.
+        const std::vector<Rect> corner{{1900, 1070, 20, 10}};
+        const auto& clipped = merger.plan(1910, 1075, corner.data(), corner.size());
+        failures += clipped.rects.size() != 1 || clipped.rects[0].x + clipped.rects[0].width != 1910 ||
+                    clipped.rects[0].y + clipped.rects[0].height != 1075;
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(DirtyRegions) {
+    DirtyRects::TileMerger merger;
+    const auto traces = makeTraces();
+    printf("  Checks: %zu failed\n", check(traces));
+
+    for (const auto& trace : traces) {
+        int64_t copied = 0;
+        int64_t rects = 0;
+        size_t fullCopies = 0;
+        for (const auto& frame : trace.frames) {
+            const auto& plan = merger.plan(trace.width, trace.height, frame.data(), frame.size());
+            copied += plan.copiedArea(trace.width, trace.height);
+            rects += plan.rects.size();
+            fullCopies += plan.fullCopy;
+        }
+        const double total = static_cast<double>(trace.width) * trace.height * trace.frames.size();
+        printf("  %s: %.2f%% of the pixels copied, %.1f copies/frame, %zu full copies\n",
+               trace.name,
+               100.0 * copied / total,
+               static_cast<double>(rects) / trace.frames.size(),
+               fullCopies);
+
+        Bench::measure(
+            std::string("plan, ") + trace.name,
+            [&] {
+                for (const auto& frame : trace.frames) {
+                    Bench::doNotOptimize(merger.plan(trace.width, trace.height, frame.data(), frame.size()));
+                }
+            },
+            trace.frames.size());
+    }
+}
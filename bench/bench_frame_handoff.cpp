@@ -0,0 +1,286 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "frame_handoff.h"
+
+namespace {
+
+    using DirtyRects::Rect;
+    using Image = std::vector<uint32_t>;
+    using Handoff = Capture::FrameHandoff<std::shared_ptr<const Image>>;
+
+    constexpr int32_t Width = 256;
+    constexpr int32_t Height = 192;
+
+    // A window whose content changes in a few random places between frames.
+    class Screen {
+      public:
+        explicit Screen(uint32_t seed) : m_random(seed), m_pixels(Width * Height) {
+        }
+
+        // Returns the regions that changed.
+        std::vector<Rect> change() {
+            std::vector<Rect> dirty;
+            const uint32_t count = 1 + m_random() % 3;
+            for (uint32_t i = 0; i < count; i++) {
+                Rect rect;
+                rect.width = 1 + m_random() % 48;
+                rect.height = 1 + m_random() % 48;
+                rect.x = m_random() % (Width - rect.width + 1);
+                rect.y = m_random() % (Height - rect.height + 1);
+                m_value++;
+                for (int32_t y = rect.y; y < rect.y + rect.height; y++) {
+                    std::fill_n(&m_pixels[y * Width + rect.x], rect.width, m_value);
+                }
+                dirty.push_back(rect);
+            }
+            return dirty;
+        }
+
+        std::shared_ptr<const Image> capture() const {
+            return std::make_shared<const Image>(m_pixels);
+        }
+
+      private:
+        std::mt19937 m_random;
+        Image m_pixels;
+        uint32_t m_value = 0;
+    };
+
+    // Small tiles, so that most frames are copied in part rather than entirely.
+    DirtyRects::Config makeConfig() {
+        DirtyRects::Config config;
+        config.tileSize = 8;
+        config.fullCopyThreshold = 0.5f;
+        return config;
+    }
+
+    // The persistent texture of the render thread, updated like CaptureWindow::copyDirtyRegions().
+    class Texture {
+      public:
+        // Returns true if only the dirty regions were copied.
+        bool update(const Handoff::Value& value) {
+            const Image& frame = *value.frame;
+            if (!m_pixels.empty() && !value.fullCopy) {
+                const auto& plan = m_merger.plan(Width, Height, value.dirtyRects.data(), value.dirtyRects.size());
+                if (!plan.fullCopy) {
+                    for (const auto& rect : plan.rects) {
+                        for (int32_t y = rect.y; y < rect.y + rect.height; y++) {
+                            std::copy_n(&frame[y * Width + rect.x], rect.width, &m_pixels[y * Width + rect.x]);
+                        }
+                    }
+                    return true;
+                }
+            }
+            m_pixels = frame;
+            return false;
+        }
+
+        bool matches(const Image& frame) const {
+            return m_pixels == frame;
+        }
+
+      private:
+        DirtyRects::TileMerger m_merger{makeConfig()};
+        Image m_pixels;
+    };
+
+    // A free-threaded frame pool: the capture stops when all its buffers hold frames, and the changes carry over to
+    // the next frame captured.
+    class FramePool {
+      public:
+        struct Frame {
+            std::shared_ptr<const Image> image;
+            std::vector<Rect> dirtyRects;
+        };
+
+        explicit FramePool(size_t depth) : m_depth(depth) {
+        }
+
+        // Returns false if the capture was held back.
+        bool capture(const Screen& screen, const std::vector<Rect>& dirtyRects) {
+            std::unique_lock lock(m_mutex);
+            m_changes.insert(m_changes.end(), dirtyRects.begin(), dirtyRects.end());
+            if (m_frames.size() >= m_depth) {
+                return false;
+            }
+            m_frames.push_back({screen.capture(), std::move(m_changes)});
+            m_changes.clear();
+            return true;
+        }
+
+        // Like CaptureWindow::drainFramePool().
+        void drain(Handoff& handoff) {
+            if (!handoff.beginProduce()) {
+                return;
+            }
+            {
+                std::unique_lock lock(m_mutex);
+                for (const auto& frame : m_frames) {
+                    handoff.add(frame.image, frame.dirtyRects.data(), frame.dirtyRects.size(), true);
+                }
+                m_frames.clear();
+            }
+            handoff.endProduce();
+        }
+
+      private:
+        const size_t m_depth;
+        std::mutex m_mutex;
+        std::deque<Frame> m_frames;
+        std::vector<Rect> m_changes;
+    };
+
+    size_t check() {
+        size_t failures = 0;
+
+        // Between two polls of the render thread, the pool is drained a few times with a few frames each time: the
+        // frames skipped in the pool and the frames replaced in the mailbox are never seen by the render thread.
+        {
+            std::mt19937 random(7);
+            Screen screen(1);
+            Handoff handoff;
+            Texture texture;
+            size_t partialCopies = 0;
+            size_t replaced = 0;
+            for (int i = 0; i < 300; i++) {
+                const uint32_t drains = 1 + random() % 3;
+                for (uint32_t j = 0; j < drains; j++) {
+                    failures += !handoff.beginProduce();
+                    const uint32_t frames = 1 + random() % 3;
+                    for (uint32_t k = 0; k < frames; k++) {
+                        const auto dirtyRects = screen.change();
+                        // Some frames come without dirty regions.
+                        const bool hasDirtyRegions = random() % 32 != 0;
+                        handoff.add(screen.capture(), dirtyRects.data(), dirtyRects.size(), hasDirtyRegions);
+                    }
+                    replaced += handoff.endProduce();
+                }
+
+                Handoff::Value value;
+                if (!handoff.take(value)) {
+                    failures++;
+                    continue;
+                }
+                partialCopies += texture.update(value);
+                failures += !texture.matches(*value.frame) || !texture.matches(*screen.capture());
+            }
+            failures += !partialCopies || !replaced;
+        }
+
+        // Only one thread drains the pool at a time, and handing a frame over stops taking the next ones until asked.
+        {
+            Screen screen(2);
+            Handoff handoff;
+            handoff.setWanted(true);
+            failures += !handoff.beginProduce() || handoff.beginProduce();
+            const auto dirtyRects = screen.change();
+            handoff.add(screen.capture(), dirtyRects.data(), dirtyRects.size(), true);
+            failures += handoff.endProduce() || handoff.isWanted();
+
+            // Draining an empty pool does not count as handing a frame over.
+            handoff.setWanted(true);
+            failures += !handoff.beginProduce();
+            failures += handoff.endProduce() || !handoff.isWanted();
+
+            Handoff::Value value;
+            failures += !handoff.take(value) || handoff.take(value);
+        }
+
+        // Both threads draining the pool concurrently, with the capture held back whenever the pool is full.
+        {
+            Screen screen(3);
+            FramePool pool(3);
+            Handoff handoff;
+            std::atomic<bool> stop{false};
+            std::thread capture([&] {
+                for (int i = 0; i < 5000; i++) {
+                    pool.capture(screen, screen.change());
+                    if (handoff.isWanted()) {
+                        pool.drain(handoff);
+                    }
+                    if (i % 8 == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+                stop = true;
+            });
+
+            std::mt19937 random(4);
+            Texture texture;
+            size_t taken = 0;
+            while (!stop.load()) {
+                Handoff::Value value;
+                bool hasFrame = handoff.take(value);
+                if (!hasFrame) {
+                    pool.drain(handoff);
+                    hasFrame = handoff.take(value);
+                }
+                handoff.setWanted(!hasFrame);
+                if (hasFrame) {
+                    texture.update(value);
+                    failures += !texture.matches(*value.frame);
+                    taken++;
+                }
+                for (uint32_t spin = random() % 64; spin > 0; spin--) {
+                    std::this_thread::yield();
+                }
+            }
+            capture.join();
+            failures += !taken;
+        }
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(FrameHandoff) {
+    printf("  Checks: %zu failed\n", check());
+
+    // The capture thread drains 2 frames with 3 dirty regions each, and the render thread takes the newest.
+    Screen screen(5);
+    Handoff handoff;
+    const auto image = screen.capture();
+    const auto dirtyRects = screen.change();
+    Handoff::Value value;
+    Bench::measure("beginProduce() + 2 add() + endProduce() + take()", [&] {
+        handoff.beginProduce();
+        handoff.add(image, dirtyRects.data(), dirtyRects.size(), true);
+        handoff.add(image, dirtyRects.data(), dirtyRects.size(), true);
+        handoff.endProduce();
+        handoff.take(value);
+        Bench::doNotOptimize(value);
+    });
+}
@@ -0,0 +1,264 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "bench.h"
+#include "frame_pacing.h"
+
+namespace {
+
+    // Stands in for the Varjo runtime: replays the CPU time spent by the application on each frame, and produces the
+    // timings that varjo_WaitSync() would report at 90 Hz.
+    class StubVarjo {
+      public:
+        static constexpr uint64_t Period = 11'111'111;
+
+        explicit StubVarjo(std::vector<uint64_t> frameTimes) : m_frameTimes(std::move(frameTimes)) {
+        }
+
+        // The session changes when the application restarts it, at the given frame.
+        void restartSessionAt(size_t frame) {
+            m_restartFrame = frame;
+        }
+
+        // The next calls to setPriority() fail.
+        void failPriority(uint32_t count) {
+            m_priorityFailures = count;
+        }
+
+        const void* getSession() const {
+            return m_index >= m_restartFrame ? &m_sessions[1] : &m_sessions[0];
+        }
+
+        // Like varjo_SessionSetPriority() followed by varjo_GetError().
+        bool setPriority(const void* session, int32_t priority) {
+            m_priorityCalls++;
+            if (m_priorityFailures) {
+                m_priorityFailures--;
+                return false;
+            }
+            m_priorities[session == &m_sessions[1]] = priority;
+            return true;
+        }
+
+        uint32_t getPriorityCalls() const {
+            return m_priorityCalls;
+        }
+
+        int32_t getPriority(size_t session) const {
+            return m_priorities[session];
+        }
+
+        bool waitSync(FramePacing::Sample& sample) {
+            if (m_index >= m_frameTimes.size()) {
+                return false;
+            }
+
+            // The application works, then waits for the next frame it can still make.
+            sample.waitStart = m_now + m_frameTimes[m_index++];
+            const uint64_t frame = sample.waitStart / Period + 1;
+            sample.waitEnd = frame * Period;
+            sample.displayTime = sample.waitEnd + 2 * Period;
+            sample.frameNumber = frame;
+            m_now = sample.waitEnd;
+            return true;
+        }
+
+      private:
+        const std::vector<uint64_t> m_frameTimes;
+        size_t m_index = 0;
+        uint64_t m_now = 0;
+
+        char m_sessions[2]{};
+        size_t m_restartFrame = SIZE_MAX;
+        int32_t m_priorities[2]{};
+        uint32_t m_priorityCalls = 0;
+        uint32_t m_priorityFailures = 0;
+    };
+
+    // Like hooked_varjo_WaitSync() in main.cpp.
+    bool hookedWaitSync(StubVarjo& varjo,
+                        FramePacing::PriorityTracker& priority,
+                        FramePacing::Controller& controller,
+                        FramePacing::Sample& sample) {
+        const void* session = varjo.getSession();
+        if (priority.isNeeded(session)) {
+            priority.setResult(session, varjo.setPriority(session, 1000));
+        }
+        if (!varjo.waitSync(sample)) {
+            return false;
+        }
+        controller.addSample(sample);
+        return true;
+    }
+
+    struct LevelChange {
+        size_t frame = 0;
+        uint32_t level = 0;
+    };
+
+    // The level after each frame of the trace, and the frames where it changed.
+    std::vector<uint32_t> replayLevels(const std::vector<uint64_t>& trace, std::vector<LevelChange>& changes) {
+        StubVarjo varjo(trace);
+        FramePacing::PriorityTracker priority;
+        FramePacing::Controller controller;
+        FramePacing::Sample sample;
+        std::vector<uint32_t> levels;
+        changes.clear();
+        while (hookedWaitSync(varjo, priority, controller, sample)) {
+            if (controller.getLevel() != (levels.empty() ? 0 : levels.back())) {
+                changes.push_back({levels.size(), controller.getLevel()});
+            }
+            levels.push_back(controller.getLevel());
+        }
+        return levels;
+    }
+
+    constexpr size_t LightFrames = 450;
+    constexpr size_t NearFrames = 270;
+    constexpr size_t OverFrames = 180;
+
+    // Light load, then the application gets close to its budget, then over it, then light again.
+    std::vector<uint64_t> makeTrace() {
+        std::vector<uint64_t> frameTimes;
+        auto append = [&](size_t count, uint64_t time, uint64_t jitter) {
+            for (size_t i = 0; i < count; i++) {
+                frameTimes.push_back(time + (i * 7919) % (jitter + 1));
+            }
+        };
+        append(LightFrames, 5'000'000, 1'000'000);
+        append(NearFrames, 10'200'000, 500'000);
+        append(OverFrames, 12'000'000, 2'000'000);
+        append(900, 5'000'000, 1'000'000);
+        return frameTimes;
+    }
+
+    size_t check(const std::vector<uint64_t>& trace) {
+        size_t failures = 0;
+        const FramePacing::Config config;
+
+        std::vector<LevelChange> changes;
+        const auto levels = replayLevels(trace, changes);
+
+        // Nothing to shed under light load, shedding while overloaded, and back to the full load at the end.
+        failures += *std::max_element(levels.begin(), levels.begin() + LightFrames) != 0;
+        const auto overloaded = levels.begin() + LightFrames;
+        const uint32_t maxLevel = *std::max_element(overloaded, overloaded + NearFrames + OverFrames);
+        failures += maxLevel != FramePacing::Controller::MaxLevel;
+        failures += levels.back() != 0;
+
+        // At most one change per window, restoring only after enough good windows, and no back and forth.
+        for (size_t i = 1; i < changes.size(); i++) {
+            const size_t elapsed = changes[i].frame - changes[i - 1].frame;
+            const bool isRestore = changes[i].level < changes[i - 1].level;
+            failures += elapsed < config.windowFrames ||
+                        (isRestore && elapsed < config.windowFrames * config.restoreWindows);
+        }
+        failures += changes.size() != 2 * FramePacing::Controller::MaxLevel;
+
+        // Between the two thresholds, the level stays where it is.
+        std::vector<uint64_t> steady(900, 8'500'000);
+        replayLevels(steady, changes);
+        failures += !changes.empty();
+
+        // Alternating bad and good windows sheds load, and never restores it.
+        std::vector<uint64_t> alternating;
+        for (int window = 0; window < 20; window++) {
+            alternating.insert(alternating.end(), config.windowFrames, window % 2 ? 5'000'000 : 10'500'000);
+        }
+        replayLevels(alternating, changes);
+        failures += changes.empty();
+        for (size_t i = 1; i < changes.size(); i++) {
+            failures += changes[i].level < changes[i - 1].level;
+        }
+
+        // The priority is set once per session, and again after a failure or when the session changes.
+        {
+            StubVarjo varjo(trace);
+            varjo.failPriority(2);
+            varjo.restartSessionAt(1000);
+            FramePacing::PriorityTracker priority;
+            FramePacing::Controller controller;
+            FramePacing::Sample sample;
+            while (hookedWaitSync(varjo, priority, controller, sample)) {
+            }
+            failures += varjo.getPriorityCalls() != 4 || varjo.getPriority(0) != 1000 || varjo.getPriority(1) != 1000;
+        }
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(FramePacingReplay) {
+    const auto trace = makeTrace();
+    printf("  Checks: %zu failed\n", check(trace));
+
+    {
+        StubVarjo varjo(trace);
+        FramePacing::Controller controller;
+        FramePacing::Sample sample;
+        uint32_t level = 0;
+        uint64_t lastMissed = 0;
+        while (varjo.waitSync(sample)) {
+            controller.addSample(sample);
+            if (controller.getLevel() != level) {
+                level = controller.getLevel();
+                const auto& stats = controller.getStats();
+                printf("  %6.2fs: level %u (headroom %3.0f%%, %llu frames missed since last change)\n",
+                       sample.waitEnd / 1e9,
+                       level,
+                       stats.headroom * 100,
+                       (unsigned long long)(stats.missedFrames - lastMissed));
+                lastMissed = stats.missedFrames;
+            }
+        }
+        printf("  %llu frames, %llu missed\n",
+               (unsigned long long)controller.getStats().frames,
+               (unsigned long long)controller.getStats().missedFrames);
+    }
+
+    std::vector<FramePacing::Sample> samples;
+    {
+        StubVarjo varjo(trace);
+        FramePacing::Sample sample;
+        while (varjo.waitSync(sample)) {
+            samples.push_back(sample);
+        }
+    }
+    uint32_t levels = 0;
+    Bench::measure(
+        "addSample",
+        [&] {
+            FramePacing::Controller controller;
+            for (const auto& sample : samples) {
+                controller.addSample(sample);
+            }
+            levels += controller.getLevel();
+        },
+        samples.size());
+    Bench::doNotOptimize(levels);
+}
@@ -0,0 +1,130 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "frame_ring.h"
+#include "instrumentation.h"
+
+namespace {
+
+    struct Result {
+        uint64_t produced = 0;
+        uint64_t consumed = 0;
+        uint64_t torn = 0;
+        uint64_t bytes = 0;
+        Instrumentation::Histogram latency;
+    };
+
+    // A producer and a consumer on separate threads, through a real shared memory. The consumer copies the frames out
+    // like an upload to a texture would, the whole frame unless the previous frame was consumed too.
+    Result run(uint32_t width,
+               uint32_t height,
+               const DirtyRects::Rect& dirty,
+               std::chrono::microseconds producerInterval,
+               std::chrono::milliseconds duration) {
+        using namespace std::chrono;
+
+        FrameRing::Producer producer("SKOverlayBench", "Bench", width, height);
+        FrameRing::Consumer consumer("SKOverlayBench");
+
+        Result result;
+        std::atomic<bool> stop{false};
+        std::thread producerThread([&] {
+            auto next = steady_clock::now();
+            while (!stop.load()) {
+                uint8_t* pixels = producer.beginFrame();
+                const uint8_t value = static_cast<uint8_t>(result.produced);
+                for (int32_t y = dirty.y; y < dirty.y + dirty.height; y++) {
+                    memset(pixels + y * producer.getPitch() + dirty.x * 4, value, dirty.width * 4);
+                }
+                producer.publish(width, height, FrameRing::PixelFormat::B8G8R8A8, dirty);
+                result.produced++;
+
+                if (producerInterval.count()) {
+                    next += producerInterval;
+                    while (steady_clock::now() < next) {
+                    }
+                }
+            }
+        });
+
+        std::vector<uint8_t> texture(static_cast<size_t>(width) * height * 4);
+        uint64_t last = 0;
+        const auto end = steady_clock::now() + duration;
+        while (steady_clock::now() < end) {
+            FrameRing::Frame frame;
+            if (!consumer.acquire(last, frame)) {
+                continue;
+            }
+            result.latency.record(Instrumentation::now() - frame.timestamp);
+
+            const DirtyRects::Rect copy =
+                frame.sequence == last + 1 ? frame.dirty : DirtyRects::Rect{0, 0, int32_t(width), int32_t(height)};
+            for (int32_t y = copy.y; y < copy.y + copy.height; y++) {
+                memcpy(texture.data() + (y * width + copy.x) * 4,
+                       frame.pixels + y * frame.pitch + copy.x * 4,
+                       copy.width * 4);
+            }
+            if (!consumer.validate(frame)) {
+                result.torn++;
+                last = 0;
+                continue;
+            }
+            result.bytes += copy.area() * 4;
+            result.consumed++;
+            last = frame.sequence;
+        }
+        stop = true;
+        producerThread.join();
+
+        return result;
+    }
+
+    void print(const char* label, const Result& result, double seconds) {
+        printf("  %-40s produced %7.0f fps, consumed %7.0f fps, %6.2f GB/s, %llu torn, latency p50 %.1f us, "
+               "p99 %.1f us\n",
+               label,
+               result.produced / seconds,
+               result.consumed / seconds,
+               result.bytes / seconds / 1e9,
+               (unsigned long long)result.torn,
+               result.latency.getPercentile(0.5) / 1e3,
+               result.latency.getPercentile(0.99) / 1e3);
+    }
+
+} // namespace
+
+BENCHMARK(FrameRingStream) {
+    using namespace std::chrono;
+
+    const milliseconds duration(500);
+    print("1080p, full frames, unpaced", run(1920, 1080, {0, 0, 1920, 1080}, microseconds(0), duration), 0.5);
+    print("1080p, 256x256 dirty, unpaced", run(1920, 1080, {512, 256, 256, 256}, microseconds(0), duration), 0.5);
+    print("1080p, full frames, 90 Hz", run(1920, 1080, {0, 0, 1920, 1080}, microseconds(11111), duration), 0.5);
+    print("4K, full frames, 90 Hz", run(3840, 2160, {0, 0, 3840, 2160}, microseconds(11111), duration), 0.5);
+}
@@ -0,0 +1,171 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "gpu_memory.h"
+
+namespace {
+
+    using GpuMemory::Decision;
+    using GpuMemory::Level;
+    using GpuMemory::Request;
+
+    constexpr uint64_t MB = 1 << 20;
+
+    // A capture of 3 buffers plus a texture, or 2 buffers plus a texture at half the resolution.
+    Request makeRequest(uint64_t id, int32_t width, int32_t height, float importance) {
+        Request request;
+        request.id = id;
+        request.importance = importance;
+        const uint64_t frame = static_cast<uint64_t>(width) * height * 4;
+        request.bytes[static_cast<size_t>(Level::Full)] = 4 * frame;
+        request.bytes[static_cast<size_t>(Level::Reduced)] = 3 * frame / 4;
+        return request;
+    }
+
+    uint64_t getUsage(const std::vector<Request>& requests, const std::vector<Decision>& decisions) {
+        uint64_t usage = 0;
+        for (size_t i = 0; i < requests.size(); i++) {
+            usage += requests[i].bytes[static_cast<size_t>(decisions[i].level)];
+        }
+        return usage;
+    }
+
+    // Properties of the decisions that must hold regardless of the input.
+    size_t check() {
+        size_t failures = 0;
+
+        // 4 monitors of 4K, the first one the most important: 126.6 MB each at full resolution, 23.7 MB reduced.
+        std::vector<Request> requests;
+        for (uint64_t i = 0; i < 4; i++) {
+            requests.push_back(makeRequest(i + 1, 3840, 2160, 4.f - i));
+        }
+        std::vector<Decision> decisions;
+
+        // No cap, or under the cap: everything at full resolution.
+        GpuMemory::Policy unlimited;
+        unlimited.decide(requests, 0, decisions);
+        failures += std::any_of(decisions.begin(), decisions.end(), [](const Decision& d) {
+            return d.level != Level::Full;
+        });
+        GpuMemory::Policy large({600 * MB});
+        large.decide(requests, 0, decisions);
+        failures += std::any_of(decisions.begin(), decisions.end(), [](const Decision& d) {
+            return d.level != Level::Full;
+        });
+
+        // Over the cap: the least important are reduced first, and the cap holds.
+        GpuMemory::Policy medium({320 * MB});
+        medium.decide(requests, 0, decisions);
+        failures += decisions[0].level != Level::Full || decisions[1].level != Level::Full ||
+                    decisions[2].level != Level::Reduced || decisions[3].level != Level::Reduced;
+        failures += getUsage(requests, decisions) > 320 * MB;
+
+        // Far over the cap: the least important are released.
+        GpuMemory::Policy small({50 * MB, 0});
+        small.decide(requests, 0, decisions);
+        failures += decisions[0].level != Level::Reduced || decisions[1].level != Level::Reduced ||
+                    decisions[2].level != Level::Released || decisions[3].level != Level::Released;
+        failures += getUsage(requests, decisions) > 50 * MB;
+
+        // The reserved memory comes first.
+        small.decide(requests, 40 * MB, decisions);
+        failures += decisions[0].level != Level::Released;
+
+        // Hysteresis: an overlay that was reduced stays reduced while the memory left is within the margin, one that
+        // was at full resolution stays there.
+        GpuMemory::Policy tight({2 * 127 * MB + 2 * 24 * MB});
+        for (auto& request : requests) {
+            request.level = Level::Reduced;
+        }
+        tight.decide(requests, 0, decisions);
+        failures += decisions[0].level != Level::Full || decisions[1].level != Level::Reduced;
+        requests[1].level = Level::Full;
+        tight.decide(requests, 0, decisions);
+        failures += decisions[0].level != Level::Full || decisions[1].level != Level::Full;
+
+        // The order of the requests does not matter.
+        std::vector<Request> shuffled = requests;
+        std::reverse(shuffled.begin(), shuffled.end());
+        std::vector<Decision> shuffledDecisions;
+        tight.decide(shuffled, 0, shuffledDecisions);
+        for (size_t i = 0; i < requests.size(); i++) {
+            failures += shuffledDecisions[requests.size() - 1 - i].level != decisions[i].level;
+        }
+
+        // The summary merges the allocations of the same kind, size and format.
+        std::vector<GpuMemory::Allocation> allocations{{GpuMemory::Kind::Texture, 1280, 720, 28},
+                                                       {GpuMemory::Kind::Capture, 3840, 2160, 28, 3},
+                                                       {GpuMemory::Kind::Texture, 1280, 720, 28},
+                                                       {GpuMemory::Kind::Texture, 1280, 720, 87}};
+        const uint64_t total = GpuMemory::getTotal(allocations);
+        GpuMemory::summarize(allocations);
+        failures += allocations.size() != 3 || GpuMemory::getTotal(allocations) != total;
+        failures += allocations[0].kind != GpuMemory::Kind::Capture || allocations[1].count != 2;
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(MemoryPolicy) {
+    printf("  Checks: %zu failed\n", check());
+
+    // 50 overlays of various sizes and importance, under a 1 GB cap.
+    constexpr size_t OverlayCount = 50;
+    std::mt19937 random(42);
+    const std::pair<int32_t, int32_t> sizes[] = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+    std::vector<Request> requests;
+    uint64_t full = 0;
+    for (size_t i = 0; i < OverlayCount; i++) {
+        const auto size = sizes[random() % 4];
+        requests.push_back(
+            makeRequest(i + 1, size.first, size.second, std::uniform_real_distribution<float>(1, 17)(random)));
+        full += requests.back().bytes[static_cast<size_t>(Level::Full)];
+    }
+
+    GpuMemory::Policy policy({1024 * MB});
+    std::vector<Decision> decisions;
+    Bench::measure("decide(), " + std::to_string(OverlayCount) + " overlays", [&] {
+        policy.decide(requests, 0, decisions);
+        Bench::doNotOptimize(decisions.data());
+    });
+
+    size_t counts[GpuMemory::LevelCount] = {};
+    for (const auto& decision : decisions) {
+        counts[static_cast<size_t>(decision.level)]++;
+    }
+    printf("  %.0f MB uncapped, %.0f MB under a %.0f MB cap: %zu full, %zu reduced, %zu released\n",
+           full / double(MB),
+           getUsage(requests, decisions) / double(MB),
+           policy.getConfig().cap / double(MB),
+           counts[0],
+           counts[1],
+           counts[2]);
+}
@@ -0,0 +1,120 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "bench.h"
+#include "instrumentation.h"
+
+namespace {
+
+    // The same phase name may have a different address in each translation unit.
+    size_t check() {
+        using namespace Instrumentation;
+
+        static const char name[] = "phase";
+        static const char sameName[] = "phase";
+        static const char otherName[] = "other";
+
+        Recorder recorder(64);
+        Statistics statistics(recorder, 0);
+        recorder.record(name, 1, 0, 1000);
+        recorder.record(sameName, 1, 0, 1000);
+        recorder.record(sameName, 2, 0, 1000);
+        recorder.record(otherName, 1, 0, 1000);
+        statistics.update();
+
+        size_t failed = 0;
+        const auto& entries = statistics.getEntries();
+        failed += entries.size() != 3;
+        if (entries.size() == 3) {
+            failed += strcmp(entries[0].name, "other") != 0 || entries[0].count != 1;
+            failed += strcmp(entries[1].name, "phase") != 0 || entries[1].key != 1 || entries[1].count != 2;
+            failed += strcmp(entries[2].name, "phase") != 0 || entries[2].key != 2 || entries[2].count != 1;
+        }
+        return failed;
+    }
+
+} // namespace
+
+BENCHMARK(InstrumentationOverhead) {
+    using namespace Instrumentation;
+
+    printf("  Checks: %zu failed\n", check());
+
+    Recorder recorder(1 << 16);
+    Statistics statistics(recorder);
+
+    Bench::measure("now()", [] { Bench::doNotOptimize(now()); });
+
+    Bench::measure("record()", [&] { recorder.record("bench", 1, 0, 1000); });
+    statistics.update();
+
+    Bench::measure("scoped timer (global recorder)", [&] { Scope scope("bench"); });
+    {
+        Statistics globalStatistics(getRecorder());
+        globalStatistics.update();
+    }
+
+    Histogram histogram;
+    uint64_t value = 1;
+    Bench::measure("histogram record()", [&] {
+        histogram.record(value);
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    });
+    Bench::measure("histogram p99", [&] { Bench::doNotOptimize(histogram.getPercentile(0.99)); });
+
+    // Drain cost, for a frame worth of events from 100 overlays.
+    Bench::measure(
+        "record and aggregate 300 events",
+        [&] {
+            for (uint64_t i = 0; i < 300; i++) {
+                recorder.record(i % 3 ? "getSurface" : "capture latency", i % 100, i, 1000 + i);
+            }
+            statistics.update();
+        },
+        300);
+
+    // Contention between producers.
+    for (const int producers : {2, 4}) {
+        Bench::measure(
+            "record() from " + std::to_string(producers) + " threads, 10k events each",
+            [&] {
+                std::vector<std::thread> threads;
+                for (int i = 0; i < producers; i++) {
+                    threads.emplace_back([&] {
+                        for (int j = 0; j < 10000; j++) {
+                            recorder.record("contended", 0, j, j);
+                        }
+                    });
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                statistics.update();
+            },
+            producers * 10000);
+    }
+}
@@ -0,0 +1,213 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "layout.h"
+
+namespace {
+
+    Layout::Profile makeProfile(const std::string& name, size_t entryCount) {
+        Layout::Profile profile;
+        profile.name = name;
+        for (size_t i = 0; i < entryCount; i++) {
+            Layout::Entry entry;
+            entry.kind = i % 10 == 0 ? Layout::Kind::Monitor : Layout::Kind::Window;
+            entry.process = entry.kind == Layout::Kind::Window ? "App" + std::to_string(i % 7) + ".exe" : "";
+            entry.titlePattern = Layout::makeTitlePattern("Document (" + std::to_string(i) + ") - App");
+            entry.position[0] = static_cast<float>(i);
+            entry.scale = 0.5f + i * 0.01f;
+            entry.flags = Layout::Decorate | (i % 3 == 0 ? uint32_t{Layout::Pinned} : 0);
+            entry.crop[2] = 1 - i * 0.01f;
+            profile.entries.push_back(entry);
+        }
+        return profile;
+    }
+
+    std::vector<Layout::Identity> makeCandidates(size_t count) {
+        std::vector<Layout::Identity> candidates;
+        for (size_t i = 0; i < count; i++) {
+            const bool isMonitor = i % 10 == 0;
+            candidates.push_back({isMonitor ? Layout::Kind::Monitor : Layout::Kind::Window,
+                                  isMonitor ? "" : "app" + std::to_string(i % 7) + ".EXE",
+                                  "Document (" + std::to_string(i) + ") - App"});
+        }
+        return candidates;
+    }
+
+    void writeBytes(const std::string& path, const std::vector<char>& bytes) {
+        FILE* file = fopen(path.c_str(), "wb");
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+    }
+
+    std::vector<char> readBytes(const std::string& path) {
+        std::vector<char> bytes;
+        FILE* file = fopen(path.c_str(), "rb");
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        fclose(file);
+        return bytes;
+    }
+
+    bool isRejected(const std::string& path) {
+        try {
+            Layout::File::open(path);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    // Round trips, rejection of damaged files, and matching.
+    size_t check(const std::string& path) {
+        size_t failures = 0;
+
+        remove(path.c_str());
+        failures += Layout::File::open(path) != nullptr;
+
+        const std::vector<Layout::Profile> profiles{makeProfile("default", 20), makeProfile("work", 3)};
+        Layout::save(path, profiles);
+        const auto loaded = Layout::loadAll(path);
+        failures += loaded.size() != profiles.size();
+        for (size_t i = 0; i < std::min(loaded.size(), profiles.size()); i++) {
+            failures += loaded[i].name != profiles[i].name || loaded[i].entries.size() != profiles[i].entries.size();
+            for (size_t j = 0; j < std::min(loaded[i].entries.size(), profiles[i].entries.size()); j++) {
+                const auto& a = loaded[i].entries[j];
+                const auto& b = profiles[i].entries[j];
+                failures += a.kind != b.kind || a.process != b.process || a.titlePattern != b.titlePattern ||
+                            a.position[0] != b.position[0] || a.scale != b.scale || a.flags != b.flags ||
+                            a.crop[2] != b.crop[2];
+            }
+        }
+
+        // Version 1 files have no crop in their entries: rewrite the file without them.
+        const std::vector<char> bytes = readBytes(path);
+        {
+            uint32_t header[8];
+            memcpy(header, bytes.data(), sizeof(header));
+            const uint32_t entryCount = header[3];
+            const uint32_t entryOffset = header[5];
+            const uint32_t stringOffset = header[6];
+            const uint32_t entrySize = (stringOffset - entryOffset) / entryCount;
+            const uint32_t cropSize = 4 * sizeof(float);
+            header[1] = 1;
+            header[6] = stringOffset - entryCount * cropSize;
+            std::vector<char> version1(bytes.begin(), bytes.begin() + entryOffset);
+            memcpy(version1.data(), header, sizeof(header));
+            for (uint32_t i = 0; i < entryCount; i++) {
+                const auto entry = bytes.begin() + entryOffset + i * entrySize;
+                version1.insert(version1.end(), entry, entry + entrySize - cropSize);
+            }
+            version1.insert(version1.end(), bytes.begin() + stringOffset, bytes.end());
+            writeBytes(path, version1);
+
+            const auto upgraded = Layout::loadAll(path);
+            failures += upgraded.size() != profiles.size();
+            for (size_t i = 0; i < std::min(upgraded.size(), profiles.size()); i++) {
+                failures += upgraded[i].entries.size() != profiles[i].entries.size();
+                for (size_t j = 0; j < std::min(upgraded[i].entries.size(), profiles[i].entries.size()); j++) {
+                    const auto& a = upgraded[i].entries[j];
+                    const auto& b = profiles[i].entries[j];
+                    failures += a.titlePattern != b.titlePattern || a.scale != b.scale || a.crop[2] != 1;
+                }
+            }
+        }
+
+        // Truncated, newer version, out of bounds offsets.
+        writeBytes(path, std::vector<char>(bytes.begin(), bytes.end() - 1));
+        failures += !isRejected(path);
+        std::vector<char> damaged = bytes;
+        damaged[4] = Layout::Version + 1;
+        writeBytes(path, damaged);
+        failures += !isRejected(path);
+        damaged = bytes;
+        damaged[20] = 0x7f;
+        writeBytes(path, damaged);
+        failures += !isRejected(path);
+
+        // Each entry takes the first window of the same process and title that is not taken yet.
+        Layout::Profile profile;
+        profile.entries.resize(3);
+        profile.entries[0].process = profile.entries[1].process = "notepad.exe";
+        profile.entries[0].titlePattern = profile.entries[1].titlePattern = "notepad$";
+        profile.entries[2].kind = Layout::Kind::Monitor;
+        profile.entries[2].titlePattern = Layout::makeTitlePattern("Monitor \\\\.\\DISPLAY2");
+        const std::vector<Layout::Identity> candidates{{Layout::Kind::Window, "calc.exe", "Notepad"},
+                                                       {Layout::Kind::Window, "NOTEPAD.EXE", "a.txt - Notepad"},
+                                                       {Layout::Kind::Monitor, "", "Monitor \\\\.\\DISPLAY1"},
+                                                       {Layout::Kind::Monitor, "", "Monitor \\\\.\\DISPLAY2"},
+                                                       {Layout::Kind::Window, "notepad.exe", "b.txt - Notepad"}};
+        const auto assignments = Layout::match(profile, candidates);
+        const std::vector<std::pair<size_t, size_t>> expected{{0, 1}, {1, 4}, {2, 3}};
+        failures += assignments != expected;
+
+        // The views of the same capture follow the entry before them, even to a taken candidate.
+        profile.entries.resize(6);
+        profile.entries[3].flags = profile.entries[4].flags = Layout::SameCapture;
+        profile.entries[5].kind = Layout::Kind::Monitor;
+        profile.entries[5].titlePattern = "nothing";
+        profile.entries.push_back(profile.entries[4]);
+        const std::vector<std::pair<size_t, size_t>> expectedViews{{0, 1}, {1, 4}, {2, 3}, {3, 3}, {4, 3}};
+        failures += Layout::match(profile, candidates) != expectedViews;
+
+        remove(path.c_str());
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(LayoutRestore) {
+    const std::string path = "bench_layout_check.bin";
+    printf("  Checks: %zu failed\n", check(path));
+
+    constexpr size_t EntryCount = 100;
+    Layout::save(path, {makeProfile("work", 10), makeProfile("default", EntryCount)});
+    const auto candidates = makeCandidates(300);
+
+    Bench::measure("open + getProfile(), " + std::to_string(EntryCount) + " entries", [&] {
+        const auto file = Layout::File::open(path);
+        Layout::Profile profile;
+        file->getProfile("default", profile);
+        Bench::doNotOptimize(profile.entries.data());
+    });
+
+    Layout::Profile profile;
+    Layout::File::open(path)->getProfile("default", profile);
+    size_t matched = 0;
+    Bench::measure("match(), " + std::to_string(EntryCount) + " entries against " +
+                       std::to_string(candidates.size()) + " windows",
+                   [&] { matched = Layout::match(profile, candidates).size(); });
+    printf("  %zu entries matched\n", matched);
+
+    remove(path.c_str());
+}
@@ -0,0 +1,191 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "instrumentation.h"
+#include "mailbox.h"
+
+namespace {
+
+    // A frame handle: the payload must arrive intact, and the sequence numbers in increasing order.
+    struct Message {
+        uint64_t sequence = 0;
+        uint64_t timestamp = 0;
+        uint64_t payload[6]{};
+
+        bool isIntact() const {
+            for (uint64_t value : payload) {
+                if (value != sequence * 0x9e3779b97f4a7c15ull) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    Message makeMessage(uint64_t sequence) {
+        Message message;
+        message.sequence = sequence;
+        message.timestamp = Instrumentation::now();
+        for (uint64_t& value : message.payload) {
+            value = sequence * 0x9e3779b97f4a7c15ull;
+        }
+        return message;
+    }
+
+    // The same handoff under a lock, for comparison.
+    class LockedMailbox {
+      public:
+        bool publish(Message value) {
+            std::unique_lock lock(m_mutex);
+            const bool replaced = m_hasValue;
+            m_value = value;
+            m_hasValue = true;
+            return replaced;
+        }
+
+        bool take(Message& value) {
+            std::unique_lock lock(m_mutex);
+            if (!m_hasValue) {
+                return false;
+            }
+            value = m_value;
+            m_hasValue = false;
+            return true;
+        }
+
+      private:
+        std::mutex m_mutex;
+        Message m_value;
+        bool m_hasValue = false;
+    };
+
+    struct Result {
+        uint64_t published = 0;
+        uint64_t replaced = 0;
+        uint64_t taken = 0;
+        uint64_t failures = 0;
+        Instrumentation::Histogram latency;
+    };
+
+    // The producer publishes as fast as possible or at an interval (like frames arriving), while the consumer polls
+    // continuously or at an interval (like the render thread).
+    template <typename Box>
+    Result run(std::chrono::microseconds producerInterval,
+               std::chrono::microseconds consumerInterval,
+               std::chrono::milliseconds duration) {
+        using namespace std::chrono;
+
+        Box box;
+        Result result;
+        std::atomic<bool> stop{false};
+        std::thread producer([&] {
+            auto next = steady_clock::now();
+            for (uint64_t sequence = 1; !stop.load(std::memory_order_relaxed); sequence++) {
+                result.replaced += box.publish(makeMessage(sequence));
+                result.published++;
+
+                if (producerInterval.count()) {
+                    next += producerInterval;
+                    std::this_thread::sleep_until(next);
+                }
+            }
+        });
+
+        uint64_t last = 0;
+        auto next = steady_clock::now();
+        const auto end = next + duration;
+        while (steady_clock::now() < end) {
+            if (consumerInterval.count()) {
+                next += consumerInterval;
+                std::this_thread::sleep_until(next);
+            }
+            Message message;
+            if (!box.take(message)) {
+                std::this_thread::yield();
+                continue;
+            }
+            result.latency.record(Instrumentation::now() - message.timestamp);
+            result.failures += !message.isIntact() || message.sequence <= last;
+            last = message.sequence;
+            result.taken++;
+        }
+        stop = true;
+        producer.join();
+
+        // The last value is always delivered.
+        Message message;
+        if (box.take(message)) {
+            result.failures += !message.isIntact() || message.sequence <= last;
+            last = message.sequence;
+        }
+        result.failures += last != result.published;
+
+        return result;
+    }
+
+    void print(const char* label, const Result& result, double seconds) {
+        printf("  %-40s published %9.0f/s, taken %9.0f/s, %5.1f%% replaced, %llu failed, latency p50 %.2f us, "
+               "p99 %.2f us\n",
+               label,
+               result.published / seconds,
+               result.taken / seconds,
+               100.0 * result.replaced / std::max<uint64_t>(result.published, 1),
+               (unsigned long long)result.failures,
+               result.latency.getPercentile(0.5) / 1e3,
+               result.latency.getPercentile(0.99) / 1e3);
+    }
+
+} // namespace
+
+BENCHMARK(MailboxHandoff) {
+    using namespace std::chrono;
+    constexpr auto Duration = milliseconds(500);
+
+    // Contention: both sides hammer the mailbox.
+    const auto unthrottled = microseconds(0);
+    print("Mailbox, unthrottled", run<Utils::Mailbox<Message>>(unthrottled, unthrottled, Duration), 0.5);
+    print("Locked, unthrottled", run<LockedMailbox>(unthrottled, unthrottled, Duration), 0.5);
+
+    // Frames arriving at 144 Hz, taken by a 90 Hz render loop. The latency is the age of the frame when taken.
+    const auto display = microseconds(6944);
+    const auto headset = microseconds(11111);
+    print("Mailbox, 144 Hz to 90 Hz", run<Utils::Mailbox<Message>>(display, headset, Duration), 0.5);
+    print("Locked, 144 Hz to 90 Hz", run<LockedMailbox>(display, headset, Duration), 0.5);
+
+    // Uncontended cost of a handoff, on a single thread.
+    Utils::Mailbox<Message> box;
+    const Message message = makeMessage(1);
+    Message taken;
+    Bench::measure("publish() + take(), single thread", [&] {
+        box.publish(message);
+        box.take(taken);
+        Bench::doNotOptimize(taken);
+    });
+}
@@ -0,0 +1,686 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "bench.h"
+#include "overlay.h"
+
+namespace {
+
+    // A desktop with a fixed set of windows and monitors.
+    class SyntheticWindowSource : public WindowList::IWindowEventSource {
+      public:
+        SyntheticWindowSource(size_t windowCount, size_t monitorCount) {
+            for (size_t i = 0; i < windowCount; i++) {
+                m_windows.push_back({reinterpret_cast<WindowList::Handle>(i + 1), "Window " + std::to_string(i), {}});
+            }
+            for (size_t i = 0; i < monitorCount; i++) {
+                m_monitors.push_back({reinterpret_cast<WindowList::Handle>(0x100000 + i),
+                                      "Monitor \\\\.\\DISPLAY" + std::to_string(i),
+                                      {}});
+            }
+        }
+
+        void start(std::function<void(const WindowList::Event&)>) override {
+        }
+
+        void stop() override {
+        }
+
+        void enumerate(std::vector<WindowList::WindowInfo>& windows) override {
+            windows = m_windows;
+        }
+
+        std::optional<WindowList::WindowInfo> query(WindowList::Handle handle) override {
+            const size_t index = reinterpret_cast<size_t>(handle) - 1;
+            if (index >= m_windows.size()) {
+                return {};
+            }
+            return m_windows[index];
+        }
+
+        bool isAlive(WindowList::Handle handle) override {
+            return query(handle).has_value();
+        }
+
+        void enumerateMonitors(std::vector<WindowList::WindowInfo>& monitors) override {
+            monitors = m_monitors;
+        }
+
+        void enumerateStreams(std::vector<WindowList::WindowInfo>&) override {
+        }
+
+      private:
+        std::vector<WindowList::WindowInfo> m_windows;
+        std::vector<WindowList::WindowInfo> m_monitors;
+    };
+
+    // Delivers a new frame every other update, like a 45 FPS source on a 90 Hz headset. Captures into 2 buffers then
+    // copies into its own texture, at half the resolution when reduced.
+    class SyntheticCaptureSource : public Capture::ICaptureSource {
+      public:
+        SyntheticCaptureSource(int32_t width, int32_t height) : m_size(width, height) {
+            m_desc.width = width;
+            m_desc.height = height;
+            m_desc.format = 28; // DXGI_FORMAT_R8G8B8A8_UNORM
+        }
+
+        uint64_t update() override {
+            m_polls++;
+            if (!m_paused && m_level != GpuMemory::Level::Released && (m_updates++ % 2) == 0) {
+                m_sequence++;
+            }
+            return m_sequence;
+        }
+
+        // Alternates between the surfaces of a frame pool of 2.
+        void* getSurface() const override {
+            return m_sequence && m_level != GpuMemory::Level::Released
+                       ? const_cast<char*>(&m_surfaces[m_sequence % 2])
+                       : nullptr;
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_desc;
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return m_size;
+        }
+
+        void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const override {
+            const int32_t scale = level == GpuMemory::Level::Reduced ? 2 : 1;
+            if (level != GpuMemory::Level::Released) {
+                const int32_t width = m_size.first / scale;
+                const int32_t height = m_size.second / scale;
+                allocations.push_back({GpuMemory::Kind::Capture, width, height, m_desc.format, 2});
+                allocations.push_back({GpuMemory::Kind::Texture, width, height, m_desc.format});
+            }
+        }
+
+        void setMemoryLevel(GpuMemory::Level level) override {
+            const int32_t scale = level == GpuMemory::Level::Reduced ? 2 : 1;
+            m_desc.width = m_size.first / scale;
+            m_desc.height = m_size.second / scale;
+            m_level = level;
+        }
+
+        uint64_t getLatency() const override {
+            return 8'000'000;
+        }
+
+        void setPaused(bool paused) override {
+            m_paused = paused;
+        }
+
+        uint64_t getFrameCount() const {
+            return m_sequence;
+        }
+
+        uint64_t getPollCount() const {
+            return m_polls;
+        }
+
+      private:
+        const std::pair<int32_t, int32_t> m_size;
+        Capture::SurfaceDesc m_desc;
+        GpuMemory::Level m_level = GpuMemory::Level::Full;
+        uint64_t m_updates = 0;
+        uint64_t m_sequence = 0;
+        uint64_t m_polls = 0;
+        char m_surfaces[2] = {};
+        bool m_paused = false;
+    };
+
+    class SyntheticCaptureFactory : public Capture::ICaptureSourceFactory {
+      public:
+        // Creating a real capture session takes a few milliseconds.
+        explicit SyntheticCaptureFactory(std::chrono::milliseconds creationTime = {},
+                                         std::pair<int32_t, int32_t> windowSize = {1280, 720})
+            : m_creationTime(creationTime), m_windowSize(windowSize) {
+        }
+
+        std::shared_ptr<Capture::ICaptureSource> createForWindow(void*) override {
+            std::this_thread::sleep_for(m_creationTime);
+            return std::make_shared<SyntheticCaptureSource>(m_windowSize.first, m_windowSize.second);
+        }
+
+        std::shared_ptr<Capture::ICaptureSource> createForMonitor(void*) override {
+            auto source = std::make_shared<SyntheticCaptureSource>(3840, 2160);
+            std::lock_guard lock(m_mutex);
+            m_monitorSources.push_back(source);
+            return source;
+        }
+
+        std::shared_ptr<Capture::ICaptureSource> createForStream(void*) override {
+            return std::make_shared<SyntheticCaptureSource>(1920, 1080);
+        }
+
+        std::vector<std::shared_ptr<SyntheticCaptureSource>> getMonitorSources() {
+            std::lock_guard lock(m_mutex);
+            return m_monitorSources;
+        }
+
+      private:
+        const std::chrono::milliseconds m_creationTime;
+        const std::pair<int32_t, int32_t> m_windowSize;
+
+        std::mutex m_mutex;
+        std::vector<std::shared_ptr<SyntheticCaptureSource>> m_monitorSources;
+    };
+
+    class NullTexture : public Overlay::ITexture {
+      public:
+        explicit NullTexture(uint64_t& binds) : m_binds(binds) {
+        }
+
+        void setSurface(void* surface, int64_t) override {
+            m_surface = surface;
+            m_binds++;
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return {0, 0};
+        }
+
+      private:
+        uint64_t& m_binds;
+        void* m_surface = nullptr;
+    };
+
+    class NullAtlasPage : public Overlay::IAtlasPage {
+      public:
+        explicit NullAtlasPage(uint64_t& drawCalls) : m_drawCalls(drawCalls) {
+        }
+
+        void copySurface(void*, const Atlas::Rect&) override {
+        }
+
+        void addQuad(const Atlas::Rect&, const Overlay::Vec3&, const Overlay::Vec2&) override {
+            m_quads++;
+        }
+
+        void draw() override {
+            m_drawCalls += m_quads ? 1 : 0;
+            m_quads = 0;
+        }
+
+      private:
+        uint64_t& m_drawCalls;
+        uint64_t m_quads = 0;
+    };
+
+    // Reads back frames with content in the middle half of the width and the middle 80% of the height, on a black
+    // background.
+    class NullThumbnailReader : public Overlay::IThumbnailReader {
+      public:
+        void request(void*) override {
+            m_pending = true;
+        }
+
+        bool read(Overlay::Thumbnail& thumbnail) override {
+            if (!m_pending) {
+                return false;
+            }
+            m_pending = false;
+
+            thumbnail.width = 128;
+            thumbnail.height = 72;
+            thumbnail.pixels.assign(static_cast<size_t>(thumbnail.width) * thumbnail.height * 4, 0);
+            for (int32_t y = 0; y < thumbnail.height; y++) {
+                for (int32_t x = 0; x < thumbnail.width; x++) {
+                    const bool isContent = x >= 32 && x < 96 && y >= 7 && y < 65;
+                    uint8_t* pixel = &thumbnail.pixels[(static_cast<size_t>(y) * thumbnail.width + x) * 4];
+                    pixel[0] = pixel[1] = pixel[2] = isContent ? 200 : 0;
+                    pixel[3] = 255;
+                }
+            }
+            return true;
+        }
+
+        void getAllocations(std::vector<GpuMemory::Allocation>& allocations) const override {
+            allocations.push_back({GpuMemory::Kind::Staging, 128, 72, 28});
+        }
+
+      private:
+        bool m_pending = false;
+    };
+
+    // Renders nothing, and turns on every toggle so that every window and monitor gets mirrored.
+    class NullRenderer : public Overlay::IRenderer {
+      public:
+        Overlay::Pose getHeadPose() override {
+            return {};
+        }
+
+        void getPointers(std::vector<Overlay::Ray>&) override {
+        }
+
+        double getTime() override {
+            return m_time;
+        }
+
+        void logWarning(const char*) override {
+        }
+
+        std::unique_ptr<Overlay::ITexture> createTexture() override {
+            return std::make_unique<NullTexture>(m_binds);
+        }
+
+        void drawQuad(const Overlay::ITexture&,
+                      const Overlay::Vec3&,
+                      const Overlay::Vec2& size,
+                      const Overlay::UvRect&) override {
+            m_quads++;
+            m_quadArea += size.x * size.y;
+        }
+
+        std::unique_ptr<Overlay::IAtlasPage> createAtlasPage(int32_t, int32_t, int64_t) override {
+            return std::make_unique<NullAtlasPage>(m_quads);
+        }
+
+        std::unique_ptr<Overlay::IThumbnailReader> createThumbnailReader() override {
+            return std::make_unique<NullThumbnailReader>();
+        }
+
+        void windowBegin(const char*, Overlay::Pose&, Overlay::WindowStyle) override {
+        }
+
+        void windowEnd() override {
+        }
+
+        void layoutReserve(const Overlay::Vec2&) override {
+        }
+
+        bool button(const char*) override {
+            return false;
+        }
+
+        bool toggle(const char*, bool& value) override {
+            const bool changed = !value;
+            value = true;
+            return changed;
+        }
+
+        bool hslider(const char*, float&, float, float) override {
+            return false;
+        }
+
+        void label(const char*) override {
+        }
+
+        void sameLine() override {
+        }
+
+        void separator() override {
+        }
+
+        void setHandsVisible(bool) override {
+        }
+
+        void advance() {
+            m_time += 1 / 90.0;
+        }
+
+        uint64_t m_quads = 0;
+        // Of a capture surface to a texture.
+        uint64_t m_binds = 0;
+        // Drawn by drawQuad(), in square meters.
+        double m_quadArea = 0;
+
+      private:
+        double m_time = 0;
+    };
+
+} // namespace
+
+BENCHMARK(OverlayStep) {
+    constexpr size_t MonitorCount = 4;
+
+    for (const size_t windowCount : {10, 100, 200}) {
+        auto renderer = std::make_shared<NullRenderer>();
+        Overlay::SKOverlay overlay(std::make_shared<SyntheticWindowSource>(windowCount, MonitorCount),
+                                   std::make_shared<SyntheticCaptureFactory>(),
+                                   renderer);
+
+        // Wait for the enumeration, then let the overlays open.
+        while (overlay.getOverlayCount() < windowCount + MonitorCount) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::yield();
+        }
+        for (int i = 0; i < 10; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+
+        constexpr int Frames = 100;
+        const uint64_t allocationsBefore = Bench::getAllocationCount();
+        for (int i = 0; i < Frames; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+        const uint64_t allocations = Bench::getAllocationCount() - allocationsBefore;
+
+        Bench::measure(std::to_string(windowCount) + " windows + " + std::to_string(MonitorCount) +
+                           " monitors, step()",
+                       [&] {
+                           overlay.step();
+                           renderer->advance();
+                       });
+        printf("  %.1f allocations/frame\n", static_cast<double>(allocations) / Frames);
+    }
+}
+
+BENCHMARK(OverlayAtlas) {
+    constexpr size_t WindowCount = 50;
+
+    for (const bool atlas : {false, true}) {
+        auto renderer = std::make_shared<NullRenderer>();
+        Overlay::SKOverlay overlay(
+            std::make_shared<SyntheticWindowSource>(WindowCount, 0),
+            std::make_shared<SyntheticCaptureFactory>(std::chrono::milliseconds(0), std::make_pair(320, 240)),
+            renderer);
+        overlay.setAtlasEnabled(atlas);
+
+        while (overlay.getOverlayCount() < WindowCount) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::yield();
+        }
+        for (int i = 0; i < 10; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+
+        constexpr int Frames = 100;
+        const uint64_t quadsBefore = renderer->m_quads;
+        for (int i = 0; i < Frames; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+        const double drawCalls = static_cast<double>(renderer->m_quads - quadsBefore) / Frames;
+
+        Bench::measure(std::to_string(WindowCount) + " windows of 320x240, atlas " + (atlas ? "on" : "off"), [&] {
+            overlay.step();
+            renderer->advance();
+        });
+        printf("  %.1f draw calls/frame\n", drawCalls);
+    }
+}
+
+BENCHMARK(OverlayMemoryCap) {
+    // 4 monitors of 4K and 20 windows: about 620 MB at full resolution.
+    auto renderer = std::make_shared<NullRenderer>();
+    Overlay::SKOverlay overlay(
+        std::make_shared<SyntheticWindowSource>(20, 4), std::make_shared<SyntheticCaptureFactory>(), renderer);
+    const auto run = [&](double seconds) {
+        for (double time = 0; time < seconds || overlay.getOverlayCount() < 24; time += 1 / 90.0) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::yield();
+        }
+    };
+
+    run(1);
+    printf("  %-40s %6.0f MB\n", "No cap", overlay.getMemoryUsage() / 1048576.0);
+    for (const uint64_t cap : {256, 64, 1024}) {
+        overlay.setMemoryBudget({cap << 20});
+        run(1);
+        printf("  %-40s %6.0f MB\n",
+               ("Cap of " + std::to_string(cap) + " MB").c_str(),
+               overlay.getMemoryUsage() / 1048576.0);
+    }
+}
+
+BENCHMARK(OverlaySharedCapture) {
+    // Regions of one 4K monitor, each in its own overlay.
+    const std::string layoutPath = "bench_views.bin";
+    const size_t viewCounts[] = {1, 4, 16};
+    uint64_t singleViewFrames = 0;
+    uint64_t singleViewBinds = 0;
+    size_t failures = 0;
+
+    for (const size_t viewCount : viewCounts) {
+        Layout::Profile profile;
+        profile.name = "default";
+        for (size_t i = 0; i < viewCount; i++) {
+            Layout::Entry entry;
+            entry.kind = Layout::Kind::Monitor;
+            entry.titlePattern = Layout::makeTitlePattern("Monitor \\\\.\\DISPLAY0");
+            entry.position[0] = 0.1f * i;
+            entry.position[2] = -0.5f;
+            entry.flags = Layout::Decorate | (i > 0 ? uint32_t{Layout::SameCapture} : 0);
+            if (i > 0) {
+                entry.crop[0] = 0.25f * (i % 4);
+                entry.crop[1] = 0.25f * (i / 4 % 4);
+                entry.crop[2] = entry.crop[3] = 0.25f;
+            }
+            profile.entries.push_back(entry);
+        }
+        Layout::save(layoutPath, {profile});
+
+        auto renderer = std::make_shared<NullRenderer>();
+        auto factory = std::make_shared<SyntheticCaptureFactory>();
+        Overlay::SKOverlay overlay(std::make_shared<SyntheticWindowSource>(0, 1), factory, renderer);
+        overlay.restoreLayout(layoutPath, "default");
+        while (!overlay.getTimeToFirstPixel()) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::yield();
+        }
+
+        const auto countFrames = [&] {
+            uint64_t frames = 0;
+            for (const auto& source : factory->getMonitorSources()) {
+                frames += source->getFrameCount();
+            }
+            return frames;
+        };
+        const auto countPolls = [&] {
+            uint64_t polls = 0;
+            for (const auto& source : factory->getMonitorSources()) {
+                polls += source->getPollCount();
+            }
+            return polls;
+        };
+
+        // Let the scheduler settle on a capture rate, then start measuring right after a frame was captured, so that
+        // every run starts at the same phase of the capture interval, whenever the session was created.
+        for (int i = 0; i < 180; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+        const uint64_t firstFrames = countFrames();
+        while (countFrames() == firstFrames) {
+            overlay.step();
+            renderer->advance();
+        }
+
+        constexpr int Frames = 90;
+        const uint64_t framesBefore = countFrames();
+        const uint64_t pollsBefore = countPolls();
+        const uint64_t bindsBefore = renderer->m_binds;
+        const uint64_t quadsBefore = renderer->m_quads;
+        for (int i = 0; i < Frames; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+        const uint64_t frames = countFrames() - framesBefore;
+        const uint64_t polls = countPolls() - pollsBefore;
+        const uint64_t binds = renderer->m_binds - bindsBefore;
+        const double drawCalls = static_cast<double>(renderer->m_quads - quadsBefore) / Frames;
+
+        // A single capture, polled at most once per frame whatever the number of views, that captures and copies
+        // exactly the frames of a single overlay. Each new frame is on another surface of the pool, and re-binds the
+        // texture once.
+        if (viewCount == 1) {
+            singleViewFrames = frames;
+            singleViewBinds = binds;
+        }
+        failures += overlay.getOverlayCount() != viewCount || factory->getMonitorSources().size() != 1;
+        failures += polls > Frames || frames != singleViewFrames || binds != frames || binds != singleViewBinds;
+
+        Bench::measure(std::to_string(viewCount) + " views of one 3840x2160 monitor, step()", [&] {
+            overlay.step();
+            renderer->advance();
+        });
+        printf("  %zu capture session(s), %.1f Mpixels captured/s, %.1f Mpixels copied/s, %.1f draw calls/frame\n",
+               factory->getMonitorSources().size(),
+               frames * 3840.0 * 2160 / (Frames / 90.0) / 1e6,
+               binds * 3840.0 * 2160 / (Frames / 90.0) / 1e6,
+               drawCalls);
+    }
+    printf("  Checks: %zu failed\n", failures);
+
+    remove(layoutPath.c_str());
+}
+
+BENCHMARK(OverlayBorderTrim) {
+    // A 4K monitor with content in 40% of its area, shown whole and trimmed.
+    const std::string layoutPath = "bench_trim.bin";
+    double fullArea = 0;
+    size_t failures = 0;
+
+    for (const bool isTrimmed : {false, true}) {
+        Layout::Profile profile;
+        profile.name = "default";
+        Layout::Entry entry;
+        entry.kind = Layout::Kind::Monitor;
+        entry.titlePattern = Layout::makeTitlePattern("Monitor \\\\.\\DISPLAY0");
+        entry.position[2] = -0.5f;
+        entry.flags = Layout::Decorate | (isTrimmed ? uint32_t{Layout::TrimBorders} : 0);
+        profile.entries.push_back(entry);
+        Layout::save(layoutPath, {profile});
+
+        auto renderer = std::make_shared<NullRenderer>();
+        Overlay::SKOverlay overlay(
+            std::make_shared<SyntheticWindowSource>(0, 1), std::make_shared<SyntheticCaptureFactory>(), renderer);
+        overlay.restoreLayout(layoutPath, "default");
+        while (!overlay.getTimeToFirstPixel()) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::yield();
+        }
+
+        // Long enough for the bounds to shrink.
+        for (int i = 0; i < 180; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+        constexpr int Frames = 90;
+        const double areaBefore = renderer->m_quadArea;
+        for (int i = 0; i < Frames; i++) {
+            overlay.step();
+            renderer->advance();
+        }
+        const double area = (renderer->m_quadArea - areaBefore) / Frames;
+
+        // The content and 1 thumbnail pixel of padding around it.
+        if (!isTrimmed) {
+            fullArea = area;
+        } else {
+            const double expected = (66 / 128.0) * (60 / 72.0);
+            failures += std::abs(area / fullArea - expected) > 0.01;
+        }
+
+        Bench::measure(std::string("3840x2160 monitor, ") + (isTrimmed ? "trimmed" : "whole") + ", step()", [&] {
+            overlay.step();
+            renderer->advance();
+        });
+        printf("  %.1f%% of the area drawn\n", 100 * area / fullArea);
+    }
+    printf("  Checks: %zu failed\n", failures);
+
+    remove(layoutPath.c_str());
+}
+
+BENCHMARK(TimeToFirstPixel) {
+    constexpr size_t WindowCount = 8;
+    const std::string layoutPath = "bench_layout.bin";
+    const auto creationTime = std::chrono::milliseconds(10);
+    remove(layoutPath.c_str());
+
+    // Mirror the windows from the selection menu, then save the layout.
+    {
+        auto renderer = std::make_shared<NullRenderer>();
+        Overlay::SKOverlay overlay(std::make_shared<SyntheticWindowSource>(WindowCount, 0),
+                                   std::make_shared<SyntheticCaptureFactory>(creationTime),
+                                   renderer);
+        overlay.restoreLayout(layoutPath, "default");
+        while (!overlay.getTimeToFirstPixel()) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        printf("  %-56s %9.1f ms\n", "From the selection menu", overlay.getTimeToFirstPixel() / 1e6);
+        overlay.saveLayout();
+    }
+
+    // Restore the layout, with the sessions created before the first frame.
+    {
+        auto renderer = std::make_shared<NullRenderer>();
+        Overlay::SKOverlay overlay(std::make_shared<SyntheticWindowSource>(WindowCount, 0),
+                                   std::make_shared<SyntheticCaptureFactory>(creationTime),
+                                   renderer);
+        overlay.restoreLayout(layoutPath, "default");
+        const size_t restored = overlay.getOverlayCount();
+        while (!overlay.getTimeToFirstPixel()) {
+            overlay.step();
+            renderer->advance();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        printf("  %-56s %9.1f ms (%zu overlays restored)\n",
+               "From the saved layout",
+               overlay.getTimeToFirstPixel() / 1e6,
+               restored);
+    }
+
+    // Restore and save without half of the windows, as when their application is not running: their entries are kept
+    // for the next time, and not duplicated.
+    size_t failures = 0;
+    const auto countEntries = [&] {
+        Layout::Profile profile;
+        const auto file = Layout::File::open(layoutPath);
+        return file && file->getProfile("default", profile) ? profile.entries.size() : 0;
+    };
+    for (const size_t windowCount : {WindowCount / 2, WindowCount / 2, WindowCount}) {
+        auto renderer = std::make_shared<NullRenderer>();
+        Overlay::SKOverlay overlay(std::make_shared<SyntheticWindowSource>(windowCount, 0),
+                                   std::make_shared<SyntheticCaptureFactory>(),
+                                   renderer);
+        overlay.restoreLayout(layoutPath, "default");
+        failures += overlay.getOverlayCount() != windowCount;
+        overlay.step();
+        overlay.saveLayout();
+        failures += countEntries() != WindowCount;
+    }
+    printf("  Checks: %zu failed\n", failures);
+
+    remove(layoutPath.c_str());
+}
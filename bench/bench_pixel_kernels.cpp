@@ -0,0 +1,279 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "pixel_kernels.h"
+
+namespace {
+
+    using PixelKernels::Isa;
+
+    std::vector<uint8_t> makeFrame(int32_t width, int32_t height) {
+        std::mt19937 random(42);
+        std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4);
+        for (auto& value : frame) {
+            value = static_cast<uint8_t>(random());
+        }
+        return frame;
+    }
+
+    // Compare every kernel against the scalar reference, including the tails that are not a multiple of the vector
+    // width.
+    size_t crossCheck(const PixelKernels::Kernels& kernels) {
+        const auto& reference = PixelKernels::getKernels(Isa::Scalar);
+        size_t mismatches = 0;
+        for (const auto& [width, height] : {std::pair{1, 1}, {7, 3}, {33, 17}, {1921, 9}, {64, 64}}) {
+            const auto source = makeFrame(width, height);
+            const size_t pixels = source.size() / 4;
+
+            auto expected = source;
+            auto actual = source;
+            reference.swizzle(source.data(), expected.data(), pixels);
+            kernels.swizzle(source.data(), actual.data(), pixels);
+            mismatches += expected != actual;
+
+            expected = actual = source;
+            reference.fixAlpha(expected.data(), pixels);
+            kernels.fixAlpha(actual.data(), pixels);
+            mismatches += expected != actual;
+
+            expected = actual = source;
+            reference.premultiply(expected.data(), pixels);
+            kernels.premultiply(actual.data(), pixels);
+            mismatches += expected != actual;
+
+            const size_t pitch = (width / 2) * 4;
+            std::vector<uint8_t> expectedSmall(pitch * (height / 2) + 1), actualSmall(expectedSmall.size());
+            reference.downscale2x(source.data(), width * 4, width, height, expectedSmall.data(), pitch);
+            kernels.downscale2x(source.data(), width * 4, width, height, actualSmall.data(), pitch);
+            mismatches += expectedSmall != actualSmall;
+        }
+        return mismatches;
+    }
+
+    // Pixel by pixel, independently of the scanners of the kernels.
+    PixelKernels::Bounds findContentBoundsReference(const std::vector<uint8_t>& frame,
+                                                    int32_t width,
+                                                    int32_t height,
+                                                    const uint8_t background[4],
+                                                    const uint8_t mask[4],
+                                                    uint8_t tolerance) {
+        int32_t left = width, top = height, right = 0, bottom = 0;
+        for (int32_t y = 0; y < height; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                for (int32_t c = 0; c < 4; c++) {
+                    if (mask[c] && std::abs(frame[4 * (y * width + x) + c] - background[c]) > tolerance) {
+                        left = std::min(left, x);
+                        right = std::max(right, x + 1);
+                        top = std::min(top, y);
+                        bottom = std::max(bottom, y + 1);
+                    }
+                }
+            }
+        }
+        return right ? PixelKernels::Bounds{left, top, right - left, bottom - top} : PixelKernels::Bounds{};
+    }
+
+    bool operator!=(const PixelKernels::Bounds& a, const PixelKernels::Bounds& b) {
+        return a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height;
+    }
+
+    // A uniform or transparent frame, with content in a rectangle.
+    std::vector<uint8_t> makeBorderedFrame(int32_t width,
+                                           int32_t height,
+                                           const uint8_t background[4],
+                                           const PixelKernels::Bounds& content,
+                                           std::mt19937& random) {
+        std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4);
+        for (int32_t y = 0; y < height; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                uint8_t* pixel = &frame[4 * (static_cast<size_t>(y) * width + x)];
+                const bool isContent = x >= content.x && x < content.x + content.width && y >= content.y &&
+                                       y < content.y + content.height;
+                for (int32_t c = 0; c < 4; c++) {
+                    pixel[c] = isContent ? static_cast<uint8_t>(random()) : background[c];
+                }
+            }
+        }
+        return frame;
+    }
+
+    // Compare the kernels against the reference, on frames with content at the edges of the vector widths, noise
+    // around the tolerance, and transparent backgrounds of any color.
+    size_t checkContentBounds(const PixelKernels::Kernels& kernels) {
+        std::mt19937 random(7);
+        size_t mismatches = 0;
+        const uint8_t opaque[4] = {32, 32, 40, 255};
+        const uint8_t allChannels[4] = {255, 255, 255, 255};
+        const uint8_t alphaOnly[4] = {0, 0, 0, 255};
+        const auto toPixel = [](const uint8_t bytes[4]) {
+            uint32_t pixel;
+            memcpy(&pixel, bytes, sizeof(pixel));
+            return pixel;
+        };
+        const auto check = [&](const std::vector<uint8_t>& frame,
+                               int32_t width,
+                               int32_t height,
+                               const uint8_t background[4],
+                               const uint8_t mask[4],
+                               uint8_t tolerance) {
+            const auto expected = findContentBoundsReference(frame, width, height, background, mask, tolerance);
+            const auto actual = kernels.findContentBounds(
+                frame.data(), width * 4, width, height, toPixel(background), toPixel(mask), tolerance);
+            mismatches += actual != expected;
+        };
+
+        for (const auto& [width, height] : {std::pair{1, 1}, {7, 3}, {33, 17}, {1921, 9}, {64, 64}, {128, 72}}) {
+            const auto empty = makeBorderedFrame(width, height, opaque, {}, random);
+            check(empty, width, height, opaque, allChannels, 0);
+
+            for (int i = 0; i < 50; i++) {
+                PixelKernels::Bounds content;
+                content.x = random() % width;
+                content.y = random() % height;
+                content.width = 1 + random() % (width - content.x);
+                content.height = 1 + random() % (height - content.y);
+                if (i % 2) {
+                    content.width = content.height = 1;
+                }
+                check(makeBorderedFrame(width, height, opaque, content, random), width, height, opaque, allChannels, 8);
+            }
+
+            // Noise up to the tolerance, and a single pixel just over it.
+            auto noisy = empty;
+            for (size_t j = 0; j < noisy.size(); j++) {
+                noisy[j] = static_cast<uint8_t>(opaque[j % 4] + static_cast<int>(random() % 17) - 8);
+            }
+            check(noisy, width, height, opaque, allChannels, 8);
+            noisy[4 * (random() % (width * height)) + random() % 3] = opaque[0] + 9;
+            check(noisy, width, height, opaque, allChannels, 8);
+
+            // Transparent pixels of any color are background.
+            auto transparent = makeFrame(width, height);
+            for (size_t j = 3; j < transparent.size(); j += 4) {
+                transparent[j] = random() % 8 ? 0 : static_cast<uint8_t>(random());
+            }
+            const uint8_t clear[4] = {};
+            check(transparent, width, height, clear, alphaOnly, 0);
+        }
+        return mismatches;
+    }
+
+} // namespace
+
+BENCHMARK(PixelConversion) {
+    const Isa best = PixelKernels::getBestIsa();
+    printf("  Best instruction set: %s\n", PixelKernels::toString(best));
+
+    std::vector<Isa> isas{Isa::Scalar};
+    for (Isa isa : {Isa::SSE2, Isa::AVX2}) {
+        if (isa <= best) {
+            isas.push_back(isa);
+            printf("  %s: %zu mismatches against the scalar kernels\n",
+                   PixelKernels::toString(isa),
+                   crossCheck(PixelKernels::getKernels(isa)));
+        }
+    }
+
+    for (const auto& [name, width, height] : {std::tuple{"1080p", 1920, 1080}, {"4K", 3840, 2160}}) {
+        const auto source = makeFrame(width, height);
+        const size_t pixels = source.size() / 4;
+        std::vector<uint8_t> destination(source.size());
+
+        for (Isa isa : isas) {
+            const auto& kernels = PixelKernels::getKernels(isa);
+            const std::string suffix = std::string(", ") + name + ", " + PixelKernels::toString(isa);
+
+            Bench::measure(
+                "swizzle" + suffix,
+                [&] { kernels.swizzle(source.data(), destination.data(), pixels); },
+                source.size(),
+                true);
+            Bench::measure(
+                "fixAlpha" + suffix, [&] { kernels.fixAlpha(destination.data(), pixels); }, source.size(), true);
+            Bench::measure(
+                "premultiply" + suffix,
+                [&] {
+                    memcpy(destination.data(), source.data(), source.size());
+                    kernels.premultiply(destination.data(), pixels);
+                },
+                source.size(),
+                true);
+            Bench::measure(
+                "downscale2x" + suffix,
+                [&] {
+                    kernels.downscale2x(source.data(), width * 4, width, height, destination.data(), width * 2);
+                },
+                source.size(),
+                true);
+        }
+    }
+}
+
+BENCHMARK(ContentBounds) {
+    const Isa best = PixelKernels::getBestIsa();
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2}) {
+        if (isa <= best) {
+            isas.push_back(isa);
+        }
+    }
+
+    size_t failures = 0;
+    for (Isa isa : isas) {
+        failures += checkContentBounds(PixelKernels::getKernels(isa));
+    }
+    printf("  Checks: %zu failed\n", failures);
+
+    // Thumbnails are small, the larger frames show the throughput.
+    std::mt19937 random(42);
+    const uint8_t background[4] = {32, 32, 40, 255};
+    uint32_t backgroundPixel;
+    memcpy(&backgroundPixel, background, sizeof(backgroundPixel));
+    for (const auto& [name, width, height] :
+         {std::tuple{"thumbnail", 240, 135}, {"1080p", 1920, 1080}, {"4K", 3840, 2160}}) {
+        const auto empty = makeBorderedFrame(width, height, background, {}, random);
+        const auto bordered =
+            makeBorderedFrame(width, height, background, {width / 4, height / 4, width / 2, height / 2}, random);
+
+        for (Isa isa : isas) {
+            const auto& kernels = PixelKernels::getKernels(isa);
+            for (const auto& [content, frame] : {std::pair{"empty", &empty}, {"bordered", &bordered}}) {
+                Bench::measure(
+                    std::string("findContentBounds, ") + name + " " + content + ", " + PixelKernels::toString(isa),
+                    [&] {
+                        Bench::doNotOptimize(kernels.findContentBounds(
+                            frame->data(), width * 4, width, height, backgroundPixel, 0xFFFFFFFF, 8));
+                    },
+                    frame->size(),
+                    true);
+            }
+        }
+    }
+}
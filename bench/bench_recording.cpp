@@ -0,0 +1,203 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "recording.h"
+
+namespace {
+
+    constexpr uint32_t Width = 1280;
+    constexpr uint32_t Height = 720;
+
+    // A desktop-like session: a static background, a blinking cursor and a region of text being typed, with a full
+    // redraw from time to time (eg: scrolling).
+    void makeFrame(uint32_t index, std::vector<uint8_t>& pixels) {
+        pixels.resize(size_t{Width} * Height * 4);
+        const bool isScroll = index % 60 == 59;
+        for (uint32_t y = 0; y < Height; y++) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels.data()) + size_t{y} * Width;
+            for (uint32_t x = 0; x < Width; x++) {
+                const uint32_t line = (y + (isScroll ? index : 0)) / 16;
+                row[x] = 0xff202020 + ((line * 7 + x / 8) % 5 == 0 ? 0x00c0c0c0 : 0);
+            }
+        }
+        const uint32_t cursorX = 100 + (index % 120) * 8;
+        for (uint32_t y = 200; y < 216; y++) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels.data()) + size_t{y} * Width;
+            for (uint32_t x = 100; x < cursorX; x++) {
+                row[x] = 0xff000000 | ((x * 2654435761u) >> 8);
+            }
+            if (index % 2) {
+                row[cursorX] = 0xffffffff;
+            }
+        }
+    }
+
+    size_t checkCompression() {
+        size_t failures = 0;
+
+        std::vector<uint8_t> source(100000);
+        for (size_t i = 0; i < source.size(); i++) {
+            source[i] = static_cast<uint8_t>(i % 251 < 100 ? 0 : (i * 2654435761u) >> 13);
+        }
+        std::vector<uint8_t> compressed(Recording::getMaxCompressedSize(source.size()));
+        const size_t compressedSize = Recording::compress(source.data(), source.size(), compressed.data());
+        std::vector<uint8_t> decompressed(source.size());
+        Recording::decompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size());
+        failures += decompressed != source;
+
+        // Truncated, or decompressing to the wrong size.
+        try {
+            Recording::decompress(compressed.data(), compressedSize / 2, decompressed.data(), decompressed.size());
+            failures++;
+        } catch (const std::runtime_error&) {
+        }
+        try {
+            Recording::decompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size() - 1);
+            failures++;
+        } catch (const std::runtime_error&) {
+        }
+
+        // Empty and incompressible blocks.
+        failures += Recording::compress(source.data(), 0, compressed.data()) > Recording::getMaxCompressedSize(0);
+        for (size_t i = 0; i < source.size(); i++) {
+            source[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+        }
+        const size_t randomSize = Recording::compress(source.data(), source.size(), compressed.data());
+        failures += randomSize > Recording::getMaxCompressedSize(source.size());
+        Recording::decompress(compressed.data(), randomSize, decompressed.data(), decompressed.size());
+        failures += decompressed != source;
+
+        return failures;
+    }
+
+    // Replay the recording and compare each frame to the generated one.
+    size_t checkReplay(const std::string& path, uint32_t frameCount) {
+        size_t failures = 0;
+
+        Recording::Reader reader(path);
+        std::vector<uint8_t> expected;
+        Recording::Frame frame;
+        uint32_t index = 0;
+        while (reader.next(frame)) {
+            makeFrame(index, expected);
+            failures += frame.width != Width || frame.height != Height || frame.timestamp != uint64_t{index} * 11111111;
+            for (uint32_t y = 0; y < std::min(frame.height, Height); y++) {
+                failures += memcmp(frame.pixels + size_t{y} * frame.pitch,
+                                   expected.data() + size_t{y} * Width * 4,
+                                   Width * 4) != 0;
+            }
+            index++;
+        }
+        failures += index != frameCount;
+
+        return failures;
+    }
+
+    // Copy the dirty regions of every frame, like an upload to a texture would.
+    void replay(const std::string& label, const std::string& path) {
+        using namespace std::chrono;
+
+        Recording::Reader reader(path);
+        std::vector<uint8_t> texture;
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        const auto start = steady_clock::now();
+        Recording::Frame frame;
+        while (reader.next(frame)) {
+            texture.resize(size_t{frame.width} * frame.height * 4);
+            const DirtyRects::Rect& dirty = frame.dirty;
+            for (int32_t y = dirty.y; y < dirty.y + dirty.height; y++) {
+                memcpy(texture.data() + (size_t(y) * frame.width + dirty.x) * 4,
+                       frame.pixels + size_t(y) * frame.pitch + dirty.x * 4,
+                       dirty.width * 4);
+            }
+            bytes += dirty.area() * 4;
+            frames++;
+        }
+        const double seconds = duration<double>(steady_clock::now() - start).count();
+        printf("  %-40s %llu frames, %8.0f fps, %6.2f GB/s uploaded\n",
+               label.c_str(),
+               (unsigned long long)frames,
+               frames / seconds,
+               bytes / seconds / 1e9);
+    }
+
+} // namespace
+
+BENCHMARK(RecordReplay) {
+    const std::string path = "bench_recording.skrec";
+    constexpr uint32_t FrameCount = 600;
+
+    // Record a 90 Hz session, as fast as the frames can be generated.
+    Recording::RecorderStats stats;
+    {
+        Recording::Recorder recorder(path);
+        std::vector<uint8_t> pixels;
+        for (uint32_t i = 0; i < FrameCount; i++) {
+            makeFrame(i, pixels);
+            recorder.addFrame(uint64_t{i} * 11111111, Width, Height, Width * 4, 87, pixels.data());
+        }
+        recorder.flush();
+        stats = recorder.getStats();
+    }
+    printf("  Checks: %zu failed\n", checkCompression() + (stats.dropped ? 0 : checkReplay(path, FrameCount)));
+    printf("  Recorded %llu frames, %llu dropped, %.1f MB -> %.1f MB (%.1fx)\n",
+           (unsigned long long)stats.frames,
+           (unsigned long long)stats.dropped,
+           stats.rawBytes / 1e6,
+           stats.writtenBytes / 1e6,
+           double(stats.rawBytes) / std::max<uint64_t>(stats.writtenBytes, 1));
+
+    std::vector<uint8_t> pixels;
+    makeFrame(7, pixels);
+    std::vector<uint8_t> compressed(Recording::getMaxCompressedSize(pixels.size()));
+    Bench::measure(
+        "compress(), 1280x720 frame",
+        [&] { Bench::doNotOptimize(Recording::compress(pixels.data(), pixels.size(), compressed.data())); },
+        pixels.size(),
+        true);
+    const size_t compressedSize = Recording::compress(pixels.data(), pixels.size(), compressed.data());
+    std::vector<uint8_t> decompressed(pixels.size());
+    Bench::measure(
+        "decompress(), 1280x720 frame",
+        [&] { Recording::decompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size()); },
+        pixels.size(),
+        true);
+
+    replay("Replay at maximum speed", path);
+    remove(path.c_str());
+
+    // A session recorded in the field, with --record.
+    if (const char* fieldRecording = getenv("SKOVERLAY_RECORDING")) {
+        replay(fieldRecording, fieldRecording);
+    }
+}
@@ -0,0 +1,134 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "rect_packer.h"
+
+namespace {
+
+    constexpr int32_t PageSize = 2048;
+
+    // Sizes of small status windows, from tiny widgets up to 512x512.
+    std::pair<int32_t, int32_t> makeSize(std::mt19937& random) {
+        std::uniform_int_distribution<int32_t> distribution(48, 512);
+        return {distribution(random), std::min(distribution(random), 384)};
+    }
+
+    // The rectangles are within the page and do not overlap, including the padding.
+    size_t countOverlaps(const Atlas::RectPacker& packer, const std::vector<Atlas::RectPacker::Id>& ids) {
+        size_t overlaps = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            const Atlas::Rect& a = packer.get(ids[i]);
+            overlaps += a.x < 0 || a.y < 0 || a.x + a.width > packer.getWidth() || a.y + a.height > packer.getHeight();
+            for (size_t j = i + 1; j < ids.size(); j++) {
+                const Atlas::Rect& b = packer.get(ids[j]);
+                overlaps += a.x < b.x + b.width + 1 && b.x < a.x + a.width + 1 && a.y < b.y + b.height + 1 &&
+                            b.y < a.y + a.height + 1;
+            }
+        }
+        return overlaps;
+    }
+
+} // namespace
+
+BENCHMARK(RectPacking) {
+    // Efficiency: offer random rectangles to an empty page until 100 in a row do not fit, as is, then sorted by
+    // repacking after each failure.
+    for (const bool repack : {false, true}) {
+        std::mt19937 random(42);
+        Atlas::RectPacker packer(PageSize, PageSize);
+        std::vector<Atlas::RectPacker::Id> ids;
+        for (int failures = 0; failures < 100;) {
+            const auto [width, height] = makeSize(random);
+            auto id = packer.allocate(width, height);
+            if (!id && repack && packer.repack()) {
+                id = packer.allocate(width, height);
+            }
+            if (id) {
+                ids.push_back(id.value());
+                failures = 0;
+            } else {
+                failures++;
+            }
+        }
+        printf("  Fill%s: %zu rects, %.1f%% occupancy, %zu overlaps\n",
+               repack ? " with repacking" : "",
+               packer.getCount(),
+               100 * packer.getOccupancy(),
+               countOverlaps(packer, ids));
+    }
+
+    // Churn: overlays opening, resizing and closing at random, around 30 at a time. Failed allocations trigger a
+    // repack, like the overlay does.
+    std::mt19937 random(42);
+    Atlas::RectPacker packer(PageSize, PageSize);
+    std::vector<Atlas::RectPacker::Id> ids;
+    uint64_t operations = 0;
+    uint64_t failures = 0;
+    uint64_t repacks = 0;
+    double occupancy = 0;
+    const auto step = [&] {
+        const uint32_t action = random() % 3;
+        const bool open = ids.size() < 10 || (action == 0 && ids.size() < 50);
+        if (!open && !ids.empty()) {
+            const size_t index = random() % ids.size();
+            packer.free(ids[index]);
+            ids[index] = ids.back();
+            ids.pop_back();
+        }
+        // Opening, or resizing (closing then opening).
+        if (open || action == 1) {
+            const auto [width, height] = makeSize(random);
+            auto id = packer.allocate(width, height);
+            if (!id && packer.repack()) {
+                repacks++;
+                id = packer.allocate(width, height);
+            }
+            if (id) {
+                ids.push_back(id.value());
+            } else {
+                failures++;
+            }
+        }
+        operations++;
+        occupancy += packer.getOccupancy();
+    };
+
+    constexpr int TraceLength = 100000;
+    for (int i = 0; i < TraceLength; i++) {
+        step();
+    }
+    printf("  Churn, %d operations: %.1f%% mean occupancy, %llu failed allocations, %llu repacks, %zu overlaps\n",
+           TraceLength,
+           100 * occupancy / operations,
+           (unsigned long long)failures,
+           (unsigned long long)repacks,
+           countOverlaps(packer, ids));
+
+    Bench::measure("open/resize/close", step);
+    Bench::measure("repack(), " + std::to_string(packer.getCount()) + " rects", [&] { packer.repack(); });
+}
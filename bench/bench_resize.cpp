@@ -0,0 +1,174 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <random>
+
+#include "bench.h"
+#include "resize_debouncer.h"
+#include "texture_pool.h"
+
+namespace {
+
+    // The content size of a window, polled at 60 Hz, and whether a frame arrived since the previous poll.
+    struct Size {
+        int32_t width;
+        int32_t height;
+        bool hasFrame = true;
+    };
+
+    // An interactive drag, a pause, a maximize, a restore, then a resize of a window that stops presenting right after
+    // (only the first frame at the new size arrives).
+    std::vector<Size> makeResizeTrace() {
+        std::vector<Size> trace;
+        for (int i = 0; i < 60; i++) {
+            trace.push_back({1280, 720});
+        }
+        for (int i = 0; i < 90; i++) {
+            trace.push_back({1280 + i * 6, 720 + i * 3});
+        }
+        for (int i = 0; i < 60; i++) {
+            trace.push_back({1820, 990});
+        }
+        for (int i = 0; i < 60; i++) {
+            trace.push_back({2560, 1377});
+        }
+        for (int i = 0; i < 60; i++) {
+            trace.push_back({1820, 990});
+        }
+        trace.push_back({1600, 900});
+        for (int i = 0; i < 60; i++) {
+            trace.push_back({1600, 900, false});
+        }
+        return trace;
+    }
+
+    struct ReplayResult {
+        size_t recreations = 0;
+        size_t mismatchedFrames = 0;
+        bool isSettled = false; // Whether the pool matches the content at the end.
+    };
+
+    // Like the capture of a window: the content size comes with the frames, and the debouncer runs on every poll, so
+    // that a resize settles even when no frame follows it.
+    ReplayResult replay(const std::vector<Size>& trace, Capture::ResizeDebouncer* debouncer) {
+        ReplayResult result;
+        Size pool = trace.front();
+        Size content = trace.front();
+        for (size_t i = 0; i < trace.size(); i++) {
+            if (trace[i].hasFrame) {
+                content = trace[i];
+            }
+            const bool resize = debouncer ? debouncer->update(
+                                                content.width, content.height, pool.width, pool.height, i / 60.0)
+                                          : (content.width != pool.width || content.height != pool.height);
+            if (resize) {
+                pool = content;
+                result.recreations++;
+            }
+            if (content.width != pool.width || content.height != pool.height) {
+                result.mismatchedFrames++;
+            }
+        }
+        result.isSettled = content.width == pool.width && content.height == pool.height;
+        return result;
+    }
+
+} // namespace
+
+BENCHMARK(ResizeTrace) {
+    const auto trace = makeResizeTrace();
+
+    const ReplayResult immediate = replay(trace, nullptr);
+    Capture::ResizeDebouncer debouncer;
+    const ReplayResult debounced = replay(trace, &debouncer);
+    printf("  %zu frames: %zu pool recreations without debouncing, %zu with (%zu frames at the previous size)\n",
+           trace.size(),
+           immediate.recreations,
+           debounced.recreations,
+           debounced.mismatchedFrames);
+
+    // The last resize is followed by no frame, and must settle anyway.
+    const size_t failures = !immediate.isSettled + !debounced.isSettled;
+    printf("  Checks: %zu failed\n", failures);
+
+    size_t recreations = 0;
+    Bench::measure(
+        "debounce",
+        [&] {
+            Capture::ResizeDebouncer debouncer;
+            recreations += replay(trace, &debouncer).recreations;
+        },
+        trace.size());
+    Bench::doNotOptimize(recreations);
+}
+
+BENCHMARK(TexturePoolChurn) {
+    // Overlays opened and closed over a handful of window and monitor sizes, with the resize trace of one overlay.
+    const Capture::TextureKey keys[] = {
+        {3840, 2160, 28}, {2560, 1440, 28}, {1920, 1080, 28}, {1280, 720, 28}, {1820, 990, 28}, {800, 600, 28}};
+    constexpr size_t KeyCount = sizeof(keys) / sizeof(keys[0]);
+
+    auto churn = [&](Capture::TexturePool<int>& pool, size_t operations) {
+        std::mt19937 random(42);
+        std::vector<std::pair<Capture::TextureKey, int>> live;
+        int nextTexture = 1;
+        uint64_t allocated = 0;
+        for (size_t i = 0; i < operations; i++) {
+            if (live.size() < 4 || (live.size() < 12 && random() % 2)) {
+                const auto& key = keys[random() % KeyCount];
+                int texture = pool.acquire(key);
+                if (!texture) {
+                    texture = nextTexture++;
+                    allocated += key.getSize();
+                }
+                live.emplace_back(key, texture);
+            } else {
+                const size_t index = random() % live.size();
+                pool.release(live[index].first, live[index].second);
+                live.erase(live.begin() + index);
+            }
+        }
+        return allocated;
+    };
+
+    {
+        Capture::TexturePool<int> pool;
+        const uint64_t allocated = churn(pool, 10000);
+        const auto stats = pool.getStats();
+        printf("  10000 operations: %.1f%% hit rate, %llu evictions, %.1f MB allocated, %.1f MB pooled\n",
+               100.0 * stats.hits / (stats.hits + stats.misses),
+               (unsigned long long)stats.evictions,
+               allocated / 1048576.0,
+               pool.getBytes() / 1048576.0);
+    }
+
+    uint64_t allocated = 0;
+    Bench::measure(
+        "acquire/release",
+        [&] {
+            Capture::TexturePool<int> pool;
+            allocated += churn(pool, 1000);
+        },
+        1000);
+    Bench::doNotOptimize(allocated);
+}
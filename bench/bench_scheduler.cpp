@@ -0,0 +1,274 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "capture_scheduler.h"
+
+namespace {
+
+    using CaptureScheduler::Allocation;
+    using CaptureScheduler::Request;
+
+    double getUsage(const std::vector<Request>& requests, const std::vector<Allocation>& allocations) {
+        double usage = 0;
+        for (size_t i = 0; i < requests.size(); i++) {
+            usage += allocations[i].rate * static_cast<double>(requests[i].pixels);
+        }
+        return usage;
+    }
+
+    // A budget in frames per second, as given with --capture-budget.
+    size_t checkFrameBudget() {
+        size_t failures = 0;
+
+        CaptureScheduler::Config config;
+        failures += !CaptureScheduler::parseBudget("120fps", config) ||
+                    config.unit != CaptureScheduler::Unit::Frames || config.budget != 120;
+        CaptureScheduler::Scheduler scheduler(config);
+
+        // Sources of all sizes, with the same priority.
+        const std::pair<int32_t, int32_t> sizes[] = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+        std::vector<Request> requests;
+        for (const auto& size : sizes) {
+            Request request;
+            request.id = requests.size() + 1;
+            request.pixels = static_cast<int64_t>(size.first) * size.second;
+            request.demand = 20;
+            requests.push_back(request);
+        }
+        std::vector<Allocation> allocations;
+
+        // Under budget, everyone gets what they ask for.
+        scheduler.schedule(requests, allocations);
+        for (const auto& allocation : allocations) {
+            failures += std::abs(allocation.rate - 20) > 1e-3f;
+        }
+
+        // Over budget, the frames are split evenly whatever the size of the sources, and add up to the budget.
+        for (auto& request : requests) {
+            request.demand = 60;
+        }
+        scheduler.schedule(requests, allocations);
+        float total = 0;
+        for (const auto& allocation : allocations) {
+            failures += std::abs(allocation.rate - 30) > 1e-3f;
+            total += allocation.rate;
+        }
+        failures += std::abs(total - 120) > 1e-3f;
+
+        // The same budget in pixels favors the smaller sources instead.
+        CaptureScheduler::Config pixels;
+        failures += !CaptureScheduler::parseBudget("249Mpx", pixels) ||
+                    pixels.unit != CaptureScheduler::Unit::Pixels || pixels.budget != 249e6;
+        CaptureScheduler::Scheduler pixelScheduler(pixels);
+        pixelScheduler.schedule(requests, allocations);
+        failures += !(allocations[0].rate > allocations[3].rate);
+
+        // Anything else leaves the config as-is.
+        for (const char* text : {"", "120", "fps", "-5fps", "0Mpx", "120 fps", "120Hz", "500mpx"}) {
+            CaptureScheduler::Config invalid;
+            failures += CaptureScheduler::parseBudget(text, invalid);
+            failures += invalid.unit != CaptureScheduler::Unit::Pixels ||
+                        invalid.budget != CaptureScheduler::Config{}.budget;
+        }
+
+        return failures;
+    }
+
+    // Properties of the allocations that must hold regardless of the input.
+    size_t check() {
+        size_t failures = 0;
+
+        CaptureScheduler::Config config;
+        config.budget = 1920.0 * 1080 * 120;
+        CaptureScheduler::Scheduler scheduler(config);
+
+        std::vector<Request> requests;
+        for (uint64_t i = 0; i < 4; i++) {
+            Request request;
+            request.id = i + 1;
+            request.pixels = 1920 * 1080;
+            request.demand = 30;
+            requests.push_back(request);
+        }
+        std::vector<Allocation> allocations;
+
+        // Under budget, everyone gets what they ask for.
+        scheduler.schedule(requests, allocations);
+        for (const auto& allocation : allocations) {
+            failures += std::abs(allocation.rate - 30) > 1e-3f;
+        }
+
+        // Over budget, the budget is used up and the priority decides the split.
+        for (auto& request : requests) {
+            request.demand = 60;
+        }
+        requests[1].gaze = 1;
+        requests[2].pinned = true;
+        requests[3].apparentSize = 0.5f;
+        scheduler.schedule(requests, allocations);
+        failures += std::abs(getUsage(requests, allocations) - config.budget) > config.budget * 1e-4;
+        failures += !(allocations[2].rate > allocations[1].rate && allocations[1].rate > allocations[3].rate &&
+                      allocations[3].rate > allocations[0].rate);
+
+        // A source asking for little leaves its share to the others.
+        requests[2].demand = 5;
+        scheduler.schedule(requests, allocations);
+        failures += std::abs(allocations[2].rate - 5) > 1e-3f;
+        failures += std::abs(getUsage(requests, allocations) - config.budget) > config.budget * 1e-4;
+
+        // Everyone keeps the minimum rate, even far over budget.
+        requests[0].pixels = 1 << 30;
+        scheduler.schedule(requests, allocations);
+        failures += allocations[0].rate < config.minimumRate;
+
+        // The order of the requests does not matter.
+        std::vector<Request> shuffled = requests;
+        std::reverse(shuffled.begin(), shuffled.end());
+        std::vector<Allocation> shuffledAllocations;
+        scheduler.schedule(shuffled, shuffledAllocations);
+        for (size_t i = 0; i < requests.size(); i++) {
+            failures += shuffledAllocations[requests.size() - 1 - i].rate != allocations[i].rate;
+        }
+
+        failures += checkFrameBudget();
+
+        return failures;
+    }
+
+    struct Source {
+        Request request;
+        float sourceRate = 0;
+        double nextFrame = 0;
+        bool hasFrame = false;
+        double lastCapture = 0;
+        float captureRate = 0;
+        float captureInterval = 0;
+        uint64_t captured = 0;
+        uint64_t scheduledCaptured = 0;
+    };
+
+} // namespace
+
+BENCHMARK(CaptureScheduling) {
+    const size_t failures = check();
+    printf("  Deterministic checks: %zu failed\n", failures);
+
+    // 50 sources competing for the budget: videos, animated and mostly static windows, of various sizes.
+    constexpr size_t SourceCount = 50;
+    std::mt19937 random(42);
+    std::vector<Source> sources(SourceCount);
+    const std::pair<int32_t, int32_t> sizes[] = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+    const float rates[] = {60, 30, 10, 1};
+    for (size_t i = 0; i < SourceCount; i++) {
+        Source& source = sources[i];
+        const auto size = sizes[random() % 4];
+        source.request.id = i + 1;
+        source.request.pixels = static_cast<int64_t>(size.first) * size.second;
+        source.request.gaze = std::uniform_real_distribution<float>(0, 1)(random);
+        source.request.gaze *= source.request.gaze * source.request.gaze;
+        source.request.apparentSize = std::uniform_real_distribution<float>(0.05f, 0.5f)(random);
+        source.request.pinned = i % 10 == 0;
+        source.sourceRate = rates[random() % 4];
+    }
+
+    CaptureScheduler::Config config;
+    CaptureScheduler::Scheduler scheduler(config);
+    std::vector<Request> requests;
+    std::vector<Allocation> allocations;
+
+    // Same loop as the overlay: the sources present at their own rate, the overlay only consumes when allowed to, and
+    // the capture is rescheduled every 0.25s from the rates observed.
+    constexpr double FrameTime = 1 / 90.0;
+    constexpr double Duration = 10;
+    double demandedPixels = 0;
+    double capturedPixels = 0;
+    for (double now = 0; now < Duration; now += FrameTime) {
+        if (std::fmod(now, 0.25) < FrameTime) {
+            requests.clear();
+            for (auto& source : sources) {
+                const float deliveredRate = static_cast<float>((source.captured - source.scheduledCaptured) / 0.25);
+                source.scheduledCaptured = source.captured;
+                source.request.demand =
+                    deliveredRate >= 0.9f * source.captureRate ? config.maximumRate : deliveredRate * 1.25f + 1;
+                requests.push_back(source.request);
+            }
+            scheduler.schedule(requests, allocations);
+            for (size_t i = 0; i < SourceCount; i++) {
+                sources[i].captureRate = allocations[i].rate;
+                sources[i].captureInterval = allocations[i].minimumInterval;
+            }
+        }
+
+        for (auto& source : sources) {
+            if (now >= source.nextFrame) {
+                source.hasFrame = true;
+                source.nextFrame += 1 / source.sourceRate;
+                demandedPixels += static_cast<double>(source.request.pixels);
+            }
+            if (source.hasFrame && now - source.lastCapture >= source.captureInterval) {
+                source.hasFrame = false;
+                source.lastCapture = now;
+                source.captured++;
+                capturedPixels += static_cast<double>(source.request.pixels);
+            }
+        }
+    }
+
+    printf("  %zu sources, budget %.0f Mpixels/s: presented %.0f Mpixels/s, captured %.0f Mpixels/s\n",
+           SourceCount,
+           config.budget / 1e6,
+           demandedPixels / Duration / 1e6,
+           capturedPixels / Duration / 1e6);
+
+    const auto printClass = [&](const char* name, const auto& predicate) {
+        double presented = 0;
+        double captured = 0;
+        size_t count = 0;
+        for (const auto& source : sources) {
+            if (predicate(source)) {
+                presented += source.sourceRate;
+                captured += source.captured / Duration;
+                count++;
+            }
+        }
+        printf("  %-40s %2zu sources, %5.1f%% of the frames captured\n", name, count, 100 * captured / presented);
+    };
+    printClass("Pinned", [](const Source& source) { return source.request.pinned; });
+    printClass("Looked at", [](const Source& source) { return !source.request.pinned && source.request.gaze > 0.5f; });
+    printClass("Others", [](const Source& source) { return !source.request.pinned && source.request.gaze <= 0.5f; });
+
+    Bench::measure(
+        std::to_string(SourceCount) + " sources, schedule()",
+        [&] {
+            scheduler.schedule(requests, allocations);
+            Bench::doNotOptimize(allocations.data());
+        },
+        SourceCount);
+}
@@ -0,0 +1,131 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "bench.h"
+#include "slot_map.h"
+
+namespace {
+
+    using Handle = void*;
+
+    // Roughly the size and the members of a mirrored window.
+    struct Entry {
+        Handle window = nullptr;
+        std::string title;
+        std::shared_ptr<int> captureSource;
+        char state[256] = {};
+    };
+
+    Handle makeHandle(size_t index) {
+        return reinterpret_cast<Handle>((index + 1) * 16);
+    }
+
+    constexpr size_t AvailableCount = 1000;
+    constexpr size_t MirroredCount = 100;
+
+} // namespace
+
+BENCHMARK(MirroredWindows) {
+    std::mt19937 random(42);
+    std::vector<size_t> mirrored;
+    for (size_t i = 0; i < AvailableCount; i++) {
+        mirrored.push_back(i);
+    }
+    std::shuffle(mirrored.begin(), mirrored.end(), random);
+    mirrored.resize(MirroredCount);
+
+    auto makeEntry = [](size_t index) {
+        Entry entry;
+        entry.window = makeHandle(index);
+        entry.title = "Window " + std::to_string(index);
+        entry.captureSource = std::make_shared<int>(0);
+        return entry;
+    };
+
+    std::vector<Entry> vector;
+    Utils::SlotMap<Handle, Entry> slotMap;
+    for (size_t index : mirrored) {
+        vector.push_back(makeEntry(index));
+        slotMap.insert(makeHandle(index), makeEntry(index));
+    }
+
+    // Refreshing the list of available windows: is each of them mirrored?
+    size_t found = 0;
+    Bench::measure(
+        "refresh, vector scan",
+        [&] {
+            for (size_t i = 0; i < AvailableCount; i++) {
+                for (const auto& entry : vector) {
+                    if (entry.window == makeHandle(i)) {
+                        found++;
+                        break;
+                    }
+                }
+            }
+        },
+        AvailableCount);
+    Bench::measure(
+        "refresh, slot map",
+        [&] {
+            for (size_t i = 0; i < AvailableCount; i++) {
+                found += slotMap.find(makeHandle(i)) != nullptr;
+            }
+        },
+        AvailableCount);
+    Bench::doNotOptimize(found);
+
+    // Closing then re-opening a window from the middle of the list.
+    const Handle middle = vector[MirroredCount / 2].window;
+    const size_t middleIndex = reinterpret_cast<size_t>(middle) / 16 - 1;
+    Bench::measure("toggle, vector", [&] {
+        auto it = std::find_if(
+            vector.begin(), vector.end(), [&](const Entry& entry) { return entry.window == middle; });
+        vector.erase(it);
+        vector.push_back(makeEntry(middleIndex));
+    });
+    Bench::measure("toggle, slot map", [&] {
+        slotMap.erase(middle);
+        slotMap.insert(middle, makeEntry(middleIndex));
+    });
+
+    // Iterating over the mirrored windows every frame.
+    size_t visited = 0;
+    Bench::measure(
+        "iterate, vector",
+        [&] {
+            for (auto& entry : vector) {
+                visited += entry.state[0] + 1;
+            }
+        },
+        MirroredCount);
+    Bench::measure(
+        "iterate, slot map",
+        [&] { slotMap.forEach([&](uint64_t, Entry& entry) { visited += entry.state[0] + 1; }); },
+        MirroredCount);
+    Bench::doNotOptimize(visited);
+}
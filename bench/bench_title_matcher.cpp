@@ -0,0 +1,134 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <random>
+
+#include "bench.h"
+#include "title_matcher.h"
+
+namespace {
+
+    const char* Words[] = {"Google",   "Chrome",  "Discord", "SimHub",   "Crew",     "Chief",  "Notepad", "Visual",
+                           "Studio",   "Spotify", "Steam",   "Telemetry", "Dashboard", "Radio", "Map",     "Chat",
+                           "Explorer", "Mozilla", "Firefox", "Terminal", "PowerShell", "Setup", "Update",  "Overlay"};
+
+    std::string randomPhrase(std::mt19937& random, size_t words) {
+        std::string phrase;
+        for (size_t i = 0; i < words; i++) {
+            if (i) {
+                phrase += ' ';
+            }
+            phrase += Words[random() % std::size(Words)];
+            if (random() % 4 == 0) {
+                phrase += std::to_string(random() % 100);
+            }
+        }
+        return phrase;
+    }
+
+} // namespace
+
+BENCHMARK(TitleMatching) {
+    constexpr size_t TitleCount = 1000;
+    constexpr size_t PatternCount = 50;
+
+    std::mt19937 random(42);
+    std::vector<std::string> titles;
+    for (size_t i = 0; i < TitleCount; i++) {
+        titles.push_back(randomPhrase(random, 2 + random() % 6) + " - " + randomPhrase(random, 1));
+    }
+
+    // Mostly literals, as typically passed on the command line, with a few real expressions.
+    std::vector<std::string> patterns;
+    for (size_t i = 0; i < PatternCount; i++) {
+        std::string pattern = randomPhrase(random, 1 + random() % 2);
+        switch (i % 10) {
+        case 0:
+            pattern = "^" + pattern;
+            break;
+        case 1:
+            pattern += "$";
+            break;
+        case 2:
+            pattern += ".*\\d+";
+            break;
+        }
+        patterns.push_back(pattern);
+    }
+
+    std::vector<std::regex> regexes;
+    TitleMatcher::Matcher matcher;
+    for (const auto& pattern : patterns) {
+        regexes.push_back(std::regex(pattern, std::regex_constants::ECMAScript | std::regex_constants::icase));
+        matcher.add(pattern);
+    }
+
+    // Sanity check that both agree.
+    for (const auto& title : titles) {
+        const auto matches = matcher.match(title);
+        for (size_t i = 0; i < PatternCount; i++) {
+            if (matches[i] != std::regex_search(title, regexes[i])) {
+                printf("  Mismatch for '%s' with '%s'\n", title.c_str(), patterns[i].c_str());
+            }
+        }
+    }
+
+    Bench::measure(
+        "std::regex loop, 1k titles x 50 patterns",
+        [&] {
+            size_t hits = 0;
+            for (const auto& title : titles) {
+                for (const auto& regex : regexes) {
+                    hits += std::regex_search(title, regex);
+                }
+            }
+            Bench::doNotOptimize(hits);
+        },
+        TitleCount);
+
+    Bench::measure(
+        "compiled matcher, 1k titles x 50 patterns",
+        [&] {
+            size_t hits = 0;
+            for (const auto& title : titles) {
+                const auto matches = matcher.match(title);
+                hits += std::count(matches.begin(), matches.end(), true);
+            }
+            Bench::doNotOptimize(hits);
+        },
+        TitleCount);
+
+    TitleMatcher::MatchCache<size_t> cache;
+    Bench::measure(
+        "cached matcher, 1k unchanged titles x 50 patterns",
+        [&] {
+            size_t hits = 0;
+            for (size_t i = 0; i < TitleCount; i++) {
+                const auto& matches = *cache.match(matcher, i, titles[i]).first;
+                hits += std::count(matches.begin(), matches.end(), true);
+            }
+            cache.sweep();
+            Bench::doNotOptimize(hits);
+        },
+        TitleCount);
+}
@@ -0,0 +1,223 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "visibility.h"
+
+namespace {
+
+    using Visibility::Bounds;
+    using Visibility::Class;
+    using Visibility::Head;
+
+    constexpr float Degrees = 3.14159265f / 180.f;
+
+    // An overlay at an angle from the forward direction, to the right of a head at the origin looking down -Z.
+    Bounds makeBounds(float angle, float distance, float radius) {
+        return {{std::sin(angle) * distance, 0, -std::cos(angle) * distance}, radius};
+    }
+
+    // Head poses at 90 Hz, with the yaw jittering by up to the amplitude around an angle to the overlay.
+    struct Replay {
+        size_t classChanges = 0;
+        size_t captureStops = 0;
+        size_t rawChanges = 0;
+    };
+
+    Replay replayJitter(float angle, float amplitude, double duration, const Visibility::Config& config) {
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> jitter(-amplitude, amplitude);
+        const Bounds bounds = makeBounds(0, 1, 0);
+
+        Replay replay;
+        Visibility::State state;
+        Class previous = Class::InView;
+        Class previousRaw = Class::InView;
+        for (int frame = 0; frame < duration * 90; frame++) {
+            const float yaw = angle + jitter(random);
+            const Head head{{0, 0, 0}, {-std::sin(yaw), 0, -std::cos(yaw)}};
+            const Class visibility = Visibility::track(state, head, bounds, false, frame / 90.0, config);
+            const Class raw = Visibility::classify(head, bounds, false, config);
+            if (frame > 0) {
+                replay.classChanges += visibility != previous;
+                replay.captureStops += Visibility::getPolicy(previous).capture &&
+                                       !Visibility::getPolicy(visibility).capture;
+                replay.rawChanges += raw != previousRaw;
+            }
+            previous = visibility;
+            previousRaw = raw;
+        }
+        return replay;
+    }
+
+    size_t checkTracking(const Visibility::Config& config) {
+        size_t failures = 0;
+
+        // Hovering at each edge of the cones: without the hysteresis, the class would flip all the time.
+        for (const float edge : {config.inViewHalfAngle, config.peripheralHalfAngle}) {
+            const Replay replay = replayJitter(edge, 2 * Degrees, 10, config);
+            failures += replay.rawChanges < 100 || replay.classChanges > 2 || replay.captureStops > 1;
+        }
+
+        // Jittering more than the hysteresis margin around the out-of-view edge: the capture is only stopped after
+        // staying out of view for the suspend delay.
+        const Replay wide = replayJitter(config.peripheralHalfAngle, 15 * Degrees, 10, config);
+        failures += wide.rawChanges < 100 || wide.captureStops > 10 / config.suspendDelay;
+
+        // Turning away suspends the capture after the delay, turning back resumes it right away, minimizing is
+        // immediate.
+        const Head head{{0, 0, 0}, {0, 0, -1}};
+        const Bounds behind = makeBounds(180 * Degrees, 1, 0.1f);
+        const Bounds ahead = makeBounds(0, 1, 0.1f);
+        Visibility::State state;
+        failures += Visibility::track(state, head, ahead, false, 0, config) != Class::InView;
+        failures += Visibility::track(state, head, behind, false, 1, config) != Class::InView;
+        failures += Visibility::track(state, head, behind, false, 1 + config.suspendDelay * 0.9, config) !=
+                    Class::InView;
+        failures += Visibility::track(state, head, behind, false, 1 + config.suspendDelay, config) != Class::OutOfView;
+        failures += Visibility::track(state, head, behind, false, 3, config) != Class::OutOfView;
+        failures += Visibility::track(state, head, ahead, false, 3.01, config) != Class::InView;
+        failures += Visibility::track(state, head, ahead, true, 3.02, config) != Class::Minimized;
+        failures += Visibility::track(state, head, behind, false, 3.03, config) != Class::OutOfView;
+
+        // Coming back before the delay keeps the capture running, and the delay starts over.
+        failures += Visibility::track(state, head, ahead, false, 4, config) != Class::InView;
+        failures += Visibility::track(state, head, behind, false, 4.1, config) != Class::InView;
+        failures += Visibility::track(state, head, ahead, false, 4.2, config) != Class::InView;
+        failures += Visibility::track(state, head, behind, false, 4.3, config) != Class::InView;
+        failures += Visibility::track(state, head, behind, false, 4.3 + config.suspendDelay * 0.9, config) !=
+                    Class::InView;
+
+        return failures;
+    }
+
+    size_t check() {
+        size_t failures = 0;
+        const Head head{{0, 0, 0}, {0, 0, -1}};
+        const Visibility::Config config;
+
+        // In front, in the periphery, behind, and minimized wherever it is.
+        failures += Visibility::classify(head, makeBounds(0, 1, 0.2f), false) != Class::InView;
+        failures += Visibility::classify(head, makeBounds(70 * Degrees, 1, 0.01f), false) != Class::Peripheral;
+        failures += Visibility::classify(head, makeBounds(180 * Degrees, 1, 0.2f), false) != Class::OutOfView;
+        failures += Visibility::classify(head, makeBounds(0, 1, 0.2f), true) != Class::Minimized;
+        failures += Visibility::classify(head, makeBounds(180 * Degrees, 1, 0.2f), true) != Class::Minimized;
+
+        // The edges of the cones, for a point and for an overlay that still reaches into the cone.
+        const float inView = config.inViewHalfAngle;
+        const float peripheral = config.peripheralHalfAngle;
+        failures += Visibility::classify(head, makeBounds(inView - 0.01f, 1, 0), false) != Class::InView;
+        failures += Visibility::classify(head, makeBounds(inView + 0.01f, 1, 0), false) != Class::Peripheral;
+        failures += Visibility::classify(head, makeBounds(peripheral - 0.01f, 1, 0), false) != Class::Peripheral;
+        failures += Visibility::classify(head, makeBounds(peripheral + 0.01f, 1, 0), false) != Class::OutOfView;
+        const float radius = std::sin(10 * Degrees);
+        failures += Visibility::classify(head, makeBounds(inView + 9 * Degrees, 1, radius), false) != Class::InView;
+        failures +=
+            Visibility::classify(head, makeBounds(peripheral + 9 * Degrees, 1, radius), false) != Class::Peripheral;
+
+        // Other head poses: looking up, and standing inside of the overlay.
+        const Head up{{0, 1.6f, 0}, {0, 1, 0}};
+        failures += Visibility::classify(up, {{0, 3, 0}, 0.2f}, false) != Class::InView;
+        failures += Visibility::classify(up, {{0, 0, 0}, 0.2f}, false) != Class::OutOfView;
+        failures += Visibility::classify(head, {{0, 0, 0.1f}, 0.5f}, false) != Class::InView;
+
+        // The attention falls off from the center of the view, larger overlays appear larger.
+        const auto center = Visibility::getAttention(head, makeBounds(0, 1, 0.1f));
+        const auto side = Visibility::getAttention(head, makeBounds(30 * Degrees, 1, 0.1f));
+        const auto outside = Visibility::getAttention(head, makeBounds(120 * Degrees, 1, 0.1f));
+        const auto large = Visibility::getAttention(head, makeBounds(0, 1, 0.4f));
+        failures += center.gaze != 1 || !(side.gaze > 0 && side.gaze < 1) || outside.gaze != 0;
+        failures += !(large.apparentSize > center.apparentSize) || large.apparentSize > 1;
+        failures += std::abs(center.apparentSize - side.apparentSize) > 1e-5f;
+        const auto inside = Visibility::getAttention(head, {{0, 0, 0.1f}, 0.5f});
+        failures += inside.gaze != 1 || inside.apparentSize != 1;
+
+        // Pointing goes through the bounds, not beside or behind them.
+        const Visibility::Ray ray{{0, 0, 0}, {0, 0, -1}};
+        failures += !Visibility::isPointedAt(ray, {{0.05f, 0, -1}, 0.1f});
+        failures += Visibility::isPointedAt(ray, {{0.2f, 0, -1}, 0.1f});
+        failures += Visibility::isPointedAt(ray, {{0, 0, 1}, 0.1f});
+        failures += !Visibility::isPointedAt(ray, {{0, 0, 0.05f}, 0.1f});
+
+        // What each class is allowed to do.
+        const auto inViewPolicy = Visibility::getPolicy(Class::InView);
+        const auto peripheralPolicy = Visibility::getPolicy(Class::Peripheral);
+        const auto outOfViewPolicy = Visibility::getPolicy(Class::OutOfView);
+        const auto minimizedPolicy = Visibility::getPolicy(Class::Minimized);
+        failures += !inViewPolicy.capture || !inViewPolicy.render || inViewPolicy.minimumInterval != 0;
+        failures += !peripheralPolicy.capture || !peripheralPolicy.render ||
+                    peripheralPolicy.minimumInterval != config.peripheralInterval;
+        failures += outOfViewPolicy.capture || outOfViewPolicy.render;
+        failures += minimizedPolicy.capture || minimizedPolicy.render;
+
+        // Hysteresis: leaving a class takes going past the edge by the margin, entering it does not.
+        const float margin = config.hysteresis;
+        failures += Visibility::classify(head, makeBounds(inView + margin / 2, 1, 0), false, Class::InView) !=
+                    Class::InView;
+        failures += Visibility::classify(head, makeBounds(inView + margin * 2, 1, 0), false, Class::InView) !=
+                    Class::Peripheral;
+        failures += Visibility::classify(head, makeBounds(inView - 0.01f, 1, 0), false, Class::Peripheral) !=
+                    Class::InView;
+        failures += Visibility::classify(head, makeBounds(peripheral + margin / 2, 1, 0), false, Class::InView) !=
+                    Class::Peripheral;
+        failures += Visibility::classify(head, makeBounds(peripheral - 0.01f, 1, 0), false, Class::OutOfView) !=
+                    Class::Peripheral;
+
+        failures += checkTracking(config);
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(VisibilityClassify) {
+    printf("  Checks: %zu failed\n", check());
+
+    // 100 overlays all around the user.
+    std::vector<Bounds> overlays;
+    for (int i = 0; i < 100; i++) {
+        overlays.push_back(makeBounds(i * 3.6f * Degrees, 1 + (i % 5) * 0.2f, 0.1f + (i % 3) * 0.1f));
+    }
+    const Head head{{0, 0, 0}, {0, 0, -1}};
+    Bench::measure(
+        "classify, 100 overlays",
+        [&] {
+            for (const auto& bounds : overlays) {
+                Bench::doNotOptimize(Visibility::classify(head, bounds, false));
+            }
+        },
+        overlays.size());
+    Bench::measure(
+        "getAttention, 100 overlays",
+        [&] {
+            for (const auto& bounds : overlays) {
+                Bench::doNotOptimize(Visibility::getAttention(head, bounds));
+            }
+        },
+        overlays.size());
+}
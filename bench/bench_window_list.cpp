@@ -0,0 +1,170 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <atomic>
+#include <mutex>
+
+#include "bench.h"
+#include "window_list.h"
+
+namespace {
+
+    using namespace WindowList;
+
+    // Simulated desktop, driven by the benchmark instead of the OS.
+    class FakeWindowEventSource : public IWindowEventSource {
+      public:
+        explicit FakeWindowEventSource(size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                m_windows.push_back({reinterpret_cast<Handle>(i + 1), "Window " + std::to_string(i), {}});
+            }
+        }
+
+        void start(std::function<void(const Event&)> sink) override {
+            m_sink = std::move(sink);
+        }
+
+        void stop() override {
+            m_sink = {};
+        }
+
+        void enumerate(std::vector<WindowInfo>& windows) override {
+            std::unique_lock lock(m_mutex);
+            windows = m_windows;
+        }
+
+        std::optional<WindowInfo> query(Handle handle) override {
+            std::unique_lock lock(m_mutex);
+            const size_t index = reinterpret_cast<size_t>(handle) - 1;
+            if (index >= m_windows.size()) {
+                return {};
+            }
+            return m_windows[index];
+        }
+
+        bool isAlive(Handle handle) override {
+            return query(handle).has_value();
+        }
+
+        void enumerateMonitors(std::vector<WindowInfo>&) override {
+        }
+
+        void enumerateStreams(std::vector<WindowInfo>&) override {
+        }
+
+        void rename(size_t index, const std::string& title) {
+            {
+                std::unique_lock lock(m_mutex);
+                m_windows[index].title = title;
+            }
+            if (m_sink) {
+                m_sink({EventType::NameChanged, m_windows[index].handle});
+            }
+        }
+
+        std::vector<WindowInfo>& windows() {
+            return m_windows;
+        }
+
+      private:
+        std::mutex m_mutex;
+        std::vector<WindowInfo> m_windows;
+        std::function<void(const Event&)> m_sink;
+    };
+
+    // The process of a known window is refreshed with its title, eg: when its name was not ready at the first scan,
+    // or when the handle was reused by another process.
+    size_t check() {
+        size_t failures = 0;
+        const Handle handle = reinterpret_cast<Handle>(1);
+        const auto getProcess = [](const WindowListModel& model) {
+            const auto snapshot = model.makeSnapshot(0);
+            return snapshot->windows.empty() ? std::string("<none>") : snapshot->windows[0].process;
+        };
+
+        WindowListModel model;
+        model.reset({{handle, "Window", ""}});
+        failures += !model.reset({{handle, "Window", "app.exe"}});
+        failures += getProcess(model) != "app.exe";
+        failures += model.reset({{handle, "Window", "app.exe"}});
+
+        FakeWindowEventSource source(1);
+        source.windows()[0] = {handle, "Window", "other.exe"};
+        failures += !model.apply({EventType::NameChanged, handle}, source);
+        failures += getProcess(model) != "other.exe";
+        failures += model.apply({EventType::NameChanged, handle}, source);
+
+        return failures;
+    }
+
+} // namespace
+
+BENCHMARK(WindowEnumeration) {
+    printf("  Checks: %zu failed\n", check());
+
+    constexpr size_t WindowCount = 10000;
+
+    FakeWindowEventSource source(WindowCount);
+    std::vector<WindowInfo> windows;
+    source.enumerate(windows);
+
+    WindowListModel model;
+    model.reset(windows);
+    Bench::measure("full rescan, 10k windows, no change", [&] { Bench::doNotOptimize(model.reset(windows)); });
+
+    size_t counter = 0;
+    Bench::measure("full rescan, 10k windows, 1% renamed", [&] {
+        for (size_t i = 0; i < WindowCount / 100; i++) {
+            const size_t index = (counter++ * 7919) % WindowCount;
+            windows[index].title = "Renamed " + std::to_string(counter);
+        }
+        Bench::doNotOptimize(model.reset(windows));
+    });
+
+    Bench::measure("100 name change events, 10k windows", [&] {
+        for (size_t i = 0; i < 100; i++) {
+            const size_t index = (counter++ * 7919) % WindowCount;
+            source.windows()[index].title = "Event " + std::to_string(counter);
+            Bench::doNotOptimize(model.apply({EventType::NameChanged, source.windows()[index].handle}, source));
+        }
+    });
+
+    Bench::measure("snapshot, 10k windows", [&] { Bench::doNotOptimize(model.makeSnapshot(0)); });
+
+    // End-to-end latency between an event and the publication of the snapshot.
+    auto liveSource = std::make_shared<FakeWindowEventSource>(WindowCount);
+    WindowEnumerator enumerator(liveSource, std::chrono::seconds(60));
+    while (!enumerator.getSnapshot()) {
+        std::this_thread::yield();
+    }
+    Bench::measure("event to snapshot, 10k windows", [&] {
+        const uint64_t generation = enumerator.getSnapshot()->generation;
+        const size_t index = (counter++ * 7919) % WindowCount;
+        liveSource->rename(index, "Live " + std::to_string(counter));
+        while (enumerator.getSnapshot()->generation == generation) {
+            std::this_thread::yield();
+        }
+    });
+
+    Bench::measure("getSnapshot()", [&] { Bench::doNotOptimize(enumerator.getSnapshot()); });
+}
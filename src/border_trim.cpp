@@ -0,0 +1,113 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "border_trim.h"
+#include "pixel_kernels.h"
+
+namespace {
+
+    using BorderTrim::Rect;
+
+    Rect getUnion(const Rect& a, const Rect& b) {
+        const float left = std::min(a.x, b.x);
+        const float top = std::min(a.y, b.y);
+        return {left,
+                top,
+                std::max(a.x + a.width, b.x + b.width) - left,
+                std::max(a.y + a.height, b.y + b.height) - top};
+    }
+
+    bool contains(const Rect& outer, const Rect& inner) {
+        return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width &&
+               inner.y + inner.height <= outer.y + outer.height;
+    }
+
+    // Whether any edge moved by more than the deadband.
+    bool isDifferent(const Rect& a, const Rect& b, float deadband) {
+        return std::abs(a.x - b.x) > deadband || std::abs(a.y - b.y) > deadband ||
+               std::abs(a.x + a.width - b.x - b.width) > deadband ||
+               std::abs(a.y + a.height - b.y - b.height) > deadband;
+    }
+
+} // namespace
+
+namespace BorderTrim {
+
+    bool Trimmer::update(const uint8_t* pixels, size_t pitch, int32_t width, int32_t height) {
+        if (width <= 0 || height <= 0) {
+            return false;
+        }
+
+        // The alpha is the 4th byte in all the formats we capture.
+        uint32_t background;
+        memcpy(&background, pixels, sizeof(background));
+        uint32_t mask = 0xFFFFFFFF;
+        if (pixels[3] == 0) {
+            const uint8_t alphaOnly[4] = {0, 0, 0, 0xFF};
+            memcpy(&mask, alphaOnly, sizeof(mask));
+        }
+        const PixelKernels::Bounds content = PixelKernels::getKernels().findContentBounds(
+            pixels, pitch, width, height, background, mask, m_config.tolerance);
+
+        // A frame without content is shown whole.
+        Rect target;
+        if (content.width && content.height) {
+            const int32_t left = std::max(content.x - m_config.padding, 0);
+            const int32_t top = std::max(content.y - m_config.padding, 0);
+            const int32_t right = std::min(content.x + content.width + m_config.padding, width);
+            const int32_t bottom = std::min(content.y + content.height + m_config.padding, height);
+            target = {static_cast<float>(left) / width,
+                      static_cast<float>(top) / height,
+                      static_cast<float>(right - left) / width,
+                      static_cast<float>(bottom - top) / height};
+        }
+
+        if (!contains(m_bounds, target)) {
+            m_bounds = getUnion(m_bounds, target);
+            m_shrinkCount = 0;
+            return true;
+        }
+        if (!isDifferent(m_bounds, target, m_config.deadband)) {
+            m_shrinkCount = 0;
+            return false;
+        }
+
+        m_pending = m_shrinkCount ? getUnion(m_pending, target) : target;
+        if (++m_shrinkCount < m_config.shrinkDelay) {
+            return false;
+        }
+        m_bounds = m_pending;
+        m_shrinkCount = 0;
+        return true;
+    }
+
+    void Trimmer::reset() {
+        m_bounds = {};
+        m_shrinkCount = 0;
+    }
+
+} // namespace BorderTrim
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Trimming of the uniform or transparent borders of the overlays, so that we do not spend fill-rate on them.
+namespace BorderTrim {
+
+    // A region of the frame, as fractions of its size.
+    struct Rect {
+        float x = 0;
+        float y = 0;
+        float width = 1;
+        float height = 1;
+    };
+
+    struct Config {
+        // Channel difference from the background below which a pixel is still background.
+        uint8_t tolerance = 8;
+        // Thumbnail pixels kept around the content, for the content blurred by the downsampling.
+        int32_t padding = 1;
+        // Number of analyses in a row that must find tighter bounds before shrinking to them.
+        uint32_t shrinkDelay = 3;
+        // Changes of the edges smaller than this fraction of the size are ignored.
+        float deadband = 0.02f;
+    };
+
+    // Finds the content of downsampled copies of the frames, and decides which part of the frame to show. Bounds grow
+    // right away so that no content is ever hidden, and only shrink once the content stayed within tighter bounds for a
+    // while, so that they do not jitter with the content.
+    class Trimmer {
+      public:
+        Trimmer() = default;
+        explicit Trimmer(const Config& config) : m_config(config) {
+        }
+
+        // Analyze a thumbnail of 32-bit pixels. The background is the color of the top-left pixel, or any transparent
+        // pixel when it is transparent. Returns true if the bounds changed.
+        bool update(const uint8_t* pixels, size_t pitch, int32_t width, int32_t height);
+
+        // Show the whole frame again.
+        void reset();
+
+        const Rect& getBounds() const {
+            return m_bounds;
+        }
+
+      private:
+        const Config m_config;
+
+        Rect m_bounds;
+        // The union of the tighter bounds seen since the shrink delay started.
+        Rect m_pending;
+        uint32_t m_shrinkCount = 0;
+    };
+
+} // namespace BorderTrim
@@ -0,0 +1,109 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "capture_scheduler.h"
+
+namespace CaptureScheduler {
+
+    bool parseBudget(const char* text, Config& config) {
+        char* unit = nullptr;
+        const double value = std::strtod(text, &unit);
+        if (unit == text || !(value > 0)) {
+            return false;
+        }
+        if (!strcmp(unit, "Mpx")) {
+            config.unit = Unit::Pixels;
+            config.budget = value * 1e6;
+            return true;
+        }
+        if (!strcmp(unit, "fps")) {
+            config.unit = Unit::Frames;
+            config.budget = value;
+            return true;
+        }
+        return false;
+    }
+
+    float Scheduler::getWeight(const Request& request) const {
+        const float gaze = std::clamp(request.gaze, 0.f, 1.f);
+        const float size = std::clamp(request.apparentSize, 0.f, 1.f);
+        return 1 + m_config.gazeWeight * gaze + m_config.sizeWeight * size +
+               (request.pinned ? m_config.pinnedWeight : 0);
+    }
+
+    void Scheduler::schedule(const std::vector<Request>& requests, std::vector<Allocation>& allocations) {
+        allocations.resize(requests.size());
+
+        // Everyone gets the minimum rate first.
+        double remaining = m_config.budget;
+        m_entries.clear();
+        for (size_t i = 0; i < requests.size(); i++) {
+            const Request& request = requests[i];
+            const double cost =
+                m_config.unit == Unit::Pixels ? static_cast<double>(std::max<int64_t>(request.pixels, 1)) : 1.0;
+            const double demand = std::clamp<double>(request.demand, 0, m_config.maximumRate);
+            const double minimum = std::min<double>(m_config.minimumRate, m_config.maximumRate);
+
+            allocations[i].id = request.id;
+            allocations[i].rate = static_cast<float>(minimum);
+            remaining -= minimum * cost;
+            if (demand > minimum) {
+                m_entries.push_back({i, cost, demand - minimum, getWeight(request)});
+            }
+        }
+
+        // Then fill the rest of the budget. Each overlay gets a share of the budget proportional to its weight, or
+        // what it asks for if that is less, in which case the leftover is split among the others. Going through the
+        // overlays by increasing demand per unit of weight, the share only increases.
+        std::sort(m_entries.begin(), m_entries.end(), [&](const Entry& a, const Entry& b) {
+            const double aNeed = a.demand * a.cost / a.weight;
+            const double bNeed = b.demand * b.cost / b.weight;
+            return aNeed != bNeed ? aNeed < bNeed : requests[a.index].id < requests[b.index].id;
+        });
+        double totalWeight = 0;
+        for (const auto& entry : m_entries) {
+            totalWeight += entry.weight;
+        }
+        for (const auto& entry : m_entries) {
+            double extra = 0;
+            if (remaining > 0 && totalWeight > 0) {
+                const double share = remaining * entry.weight / totalWeight;
+                extra = std::min(entry.demand, share / entry.cost);
+            }
+            remaining -= extra * entry.cost;
+            totalWeight -= entry.weight;
+            allocations[entry.index].rate += static_cast<float>(extra);
+        }
+
+        for (auto& allocation : allocations) {
+            // No interval at the maximum rate, so that rounding does not cause to skip frames.
+            allocation.minimumInterval =
+                allocation.rate > 0 && allocation.rate < m_config.maximumRate ? 1 / allocation.rate : 0;
+        }
+    }
+
+} // namespace CaptureScheduler
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace CaptureScheduler {
+
+    enum class Unit {
+        Pixels, // The budget is in pixels per second.
+        Frames, // The budget is in frames per second.
+    };
+
+    struct Config {
+        Unit unit = Unit::Pixels;
+        // Budget shared by all the overlays. About a 4K monitor at 60 Hz by default.
+        double budget = 500e6;
+        // Every overlay gets at least this rate, even when over budget, in frames per second.
+        float minimumRate = 1;
+        // No overlay gets more than this rate, in frames per second.
+        float maximumRate = 90;
+        // Weight added by the gaze (0 to 1), the apparent size (0 to 1) and the pinning of an overlay.
+        float gazeWeight = 4;
+        float sizeWeight = 4;
+        float pinnedWeight = 8;
+    };
+
+    struct Request {
+        uint64_t id = 0;
+        int64_t pixels = 0;         // Per frame.
+        float demand = 0;           // Rate at which the source delivers frames, in frames per second.
+        float gaze = 0;             // 1 when looked or pointed at, 0 away from the center of the view.
+        float apparentSize = 0;     // Fraction of the field of view covered.
+        bool pinned = false;        // Prioritized by the user.
+    };
+
+    struct Allocation {
+        uint64_t id = 0;
+        float rate = 0;             // In frames per second.
+        float minimumInterval = 0;  // In seconds.
+    };
+
+    // Sets the budget from a value with its unit: "500Mpx" for 500 Mpixels per second, or "120fps" for 120 frames per
+    // second. Returns false and leaves the config as-is if the text is not a positive number with one of these units.
+    bool parseBudget(const char* text, Config& config);
+
+    // Splits a global capture budget across the overlays, in proportion to their priority and without giving any of
+    // them more than it asks for (weighted max-min fairness). Deterministic: the same requests always produce the same
+    // allocations.
+    class Scheduler {
+      public:
+        explicit Scheduler(const Config& config = {}) : m_config(config) {
+        }
+
+        // The allocations are in the same order as the requests.
+        void schedule(const std::vector<Request>& requests, std::vector<Allocation>& allocations);
+
+        float getWeight(const Request& request) const;
+
+        const Config& getConfig() const {
+            return m_config;
+        }
+
+      private:
+        const Config m_config;
+
+        struct Entry {
+            size_t index;
+            double cost;   // Per frame, in the unit of the budget.
+            double demand; // In frames per second.
+            double weight;
+        };
+        std::vector<Entry> m_entries;
+    };
+
+} // namespace CaptureScheduler
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gpu_memory.h"
+
+namespace Capture {
+
+    // Description of the surface of the most recent frame, cached by the source so that consumers never need to query
+    // the native texture.
+    struct SurfaceDesc {
+        int32_t width = 0;
+        int32_t height = 0;
+        int64_t format = 0; // Native format (DXGI_FORMAT on Windows).
+    };
+
+    // A source of captured frames (window, monitor, or synthetic).
+    struct ICaptureSource {
+        virtual ~ICaptureSource() = default;
+
+        // Poll for a new frame. Returns the sequence number of the most recent frame, 0 if no frame was delivered yet.
+        virtual uint64_t update() = 0;
+
+        // Native surface holding the most recent frame (ID3D11Texture2D on Windows). Sources that update a persistent
+        // texture in place keep returning the same surface.
+        virtual void* getSurface() const = 0;
+        virtual const SurfaceDesc& getDesc() const = 0;
+
+        // Size of the most recent frame, or of the captured item until the first frame. Cheap to call every frame. The
+        // surface may hold the frame at a lower resolution, see setMemoryLevel().
+        virtual std::pair<int32_t, int32_t> getSize() const = 0;
+
+        // Time between the capture of the most recent frame and its delivery by update(), in nanoseconds.
+        virtual uint64_t getLatency() const = 0;
+
+        // Stop producing frames until resumed. The most recent frame remains available.
+        virtual void setPaused(bool paused) = 0;
+
+        // The GPU memory held at a memory level, from the current size of the content.
+        virtual void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const = 0;
+        // Change how much memory the source may hold. At the released level, the source holds no surface and produces
+        // no frames, even when not paused.
+        virtual void setMemoryLevel(GpuMemory::Level level) = 0;
+    };
+
+    // Creates the capture sources for the windows and monitors to mirror.
+    struct ICaptureSourceFactory {
+        virtual ~ICaptureSourceFactory() = default;
+
+        // Throw on failure. May be called from any thread.
+        virtual std::shared_ptr<ICaptureSource> createForWindow(void* window) = 0;
+        virtual std::shared_ptr<ICaptureSource> createForMonitor(void* monitor) = 0;
+        virtual std::shared_ptr<ICaptureSource> createForStream(void* stream) = 0;
+    };
+
+    struct FrameStats {
+        uint64_t delivered = 0; // Frames produced by the source.
+        uint64_t rebound = 0;   // Frames where the overlay texture was re-bound.
+        uint64_t skipped = 0;   // Frames where the overlay texture was left untouched.
+    };
+
+    // Tracks which frame of a source is bound to an overlay texture, so that we only re-bind when the source actually
+    // delivered a new frame on a different surface.
+    class FrameBinder {
+      public:
+        // Returns true if the texture must be re-bound to the current surface of the source.
+        bool update(uint64_t sequence, const void* surface) {
+            // The source may have delivered several frames since we last polled it.
+            m_stats.delivered += sequence > m_lastSequence ? sequence - m_lastSequence : 0;
+
+            if (sequence == 0 || !surface ||
+                ((sequence == m_lastSequence || surface == m_boundSurface) && !m_invalidated)) {
+                m_lastSequence = sequence;
+                m_stats.skipped++;
+                return false;
+            }
+
+            m_stats.rebound++;
+            m_lastSequence = sequence;
+            m_boundSurface = surface;
+            m_invalidated = false;
+            return true;
+        }
+
+        // Force the next update() to re-bind, for example after the texture was recreated.
+        void invalidate() {
+            m_invalidated = true;
+        }
+
+        const FrameStats& getStats() const {
+            return m_stats;
+        }
+
+      private:
+        uint64_t m_lastSequence = 0;
+        const void* m_boundSurface = nullptr;
+        bool m_invalidated = false;
+        FrameStats m_stats;
+    };
+
+} // namespace Capture
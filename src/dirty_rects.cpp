@@ -0,0 +1,180 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+
+#include "dirty_rects.h"
+
+namespace {
+
+    using DirtyRects::Rect;
+
+    Rect unite(const Rect& a, const Rect& b) {
+        const int32_t left = std::min(a.x, b.x);
+        const int32_t top = std::min(a.y, b.y);
+        const int32_t right = std::max(a.x + a.width, b.x + b.width);
+        const int32_t bottom = std::max(a.y + a.height, b.y + b.height);
+        return {left, top, right - left, bottom - top};
+    }
+
+} // namespace
+
+namespace DirtyRects {
+
+    int64_t Plan::copiedArea(int32_t width, int32_t height) const {
+        if (fullCopy) {
+            return static_cast<int64_t>(width) * height;
+        }
+
+        int64_t area = 0;
+        for (const auto& rect : rects) {
+            area += rect.area();
+        }
+        return area;
+    }
+
+    const Plan& TileMerger::plan(int32_t width, int32_t height, const Rect* dirty, size_t count) {
+        m_plan.fullCopy = false;
+        m_plan.rects.clear();
+        if (width <= 0 || height <= 0 || !count) {
+            return m_plan;
+        }
+
+        markTiles(width, height, dirty, count);
+        extractRects(width, height);
+        if (m_plan.rects.size() > m_config.maxTileRects) {
+            m_plan.fullCopy = true;
+            m_plan.rects.clear();
+            return m_plan;
+        }
+
+        mergeRects();
+
+        const int64_t area = m_plan.copiedArea(width, height);
+        if (area > static_cast<int64_t>(m_config.fullCopyThreshold * width * height)) {
+            m_plan.fullCopy = true;
+            m_plan.rects.clear();
+        }
+
+        return m_plan;
+    }
+
+    void TileMerger::markTiles(int32_t width, int32_t height, const Rect* dirty, size_t count) {
+        const int32_t tileSize = m_config.tileSize;
+        m_columns = (width + tileSize - 1) / tileSize;
+        m_rows = (height + tileSize - 1) / tileSize;
+        m_tiles.assign(static_cast<size_t>(m_columns) * m_rows, 0);
+
+        for (size_t i = 0; i < count; i++) {
+            const int32_t left = std::max(dirty[i].x, 0);
+            const int32_t top = std::max(dirty[i].y, 0);
+            const int32_t right = std::min(dirty[i].x + dirty[i].width, width);
+            const int32_t bottom = std::min(dirty[i].y + dirty[i].height, height);
+            if (left >= right || top >= bottom) {
+                continue;
+            }
+
+            for (int32_t row = top / tileSize; row <= (bottom - 1) / tileSize; row++) {
+                uint8_t* tiles = &m_tiles[static_cast<size_t>(row) * m_columns];
+                std::fill(tiles + left / tileSize, tiles + (right - 1) / tileSize + 1, uint8_t(1));
+            }
+        }
+    }
+
+    void TileMerger::extractRects(int32_t width, int32_t height) {
+        const int32_t tileSize = m_config.tileSize;
+
+        // Find the horizontal runs of dirty tiles on each row, and extend the rectangles from the row above when the
+        // run is identical. The coordinates are in tiles until the very end.
+        m_open.clear();
+        for (int32_t row = 0; row < m_rows; row++) {
+            const uint8_t* tiles = &m_tiles[static_cast<size_t>(row) * m_columns];
+
+            size_t openCount = m_open.size();
+            size_t nextOpen = 0;
+            for (int32_t column = 0; column < m_columns;) {
+                if (!tiles[column]) {
+                    column++;
+                    continue;
+                }
+                const int32_t start = column;
+                while (column < m_columns && tiles[column]) {
+                    column++;
+                }
+
+                // Runs are discovered left to right, so we only need to look forward in the list of open rectangles.
+                while (nextOpen < openCount && m_open[nextOpen].x < start) {
+                    nextOpen++;
+                }
+                if (nextOpen < openCount && m_open[nextOpen].x == start && m_open[nextOpen].width == column - start &&
+                    m_open[nextOpen].y + m_open[nextOpen].height == row) {
+                    m_open[nextOpen].height++;
+                } else {
+                    m_open.push_back({start, row, column - start, 1});
+                }
+            }
+
+            // Close the rectangles that did not continue on this row, and keep the open ones sorted.
+            auto closed = std::stable_partition(
+                m_open.begin(), m_open.end(), [&](const Rect& rect) { return rect.y + rect.height == row + 1; });
+            m_plan.rects.insert(m_plan.rects.end(), closed, m_open.end());
+            m_open.erase(closed, m_open.end());
+            std::sort(m_open.begin(), m_open.end(), [](const Rect& a, const Rect& b) { return a.x < b.x; });
+        }
+        m_plan.rects.insert(m_plan.rects.end(), m_open.begin(), m_open.end());
+
+        // Convert to pixels, clipping the last row and column of tiles.
+        for (auto& rect : m_plan.rects) {
+            rect.x *= tileSize;
+            rect.y *= tileSize;
+            rect.width = std::min(rect.width * tileSize, width - rect.x);
+            rect.height = std::min(rect.height * tileSize, height - rect.y);
+        }
+    }
+
+    void TileMerger::mergeRects() {
+        auto& rects = m_plan.rects;
+
+        // Greedily merge the pair that wastes the least area, until we are within budget.
+        while (rects.size() > m_config.maxRects) {
+            size_t bestA = 0;
+            size_t bestB = 1;
+            int64_t bestWaste = INT64_MAX;
+            for (size_t a = 0; a < rects.size(); a++) {
+                for (size_t b = a + 1; b < rects.size(); b++) {
+                    const int64_t waste = unite(rects[a], rects[b]).area() - rects[a].area() - rects[b].area();
+                    if (waste < bestWaste) {
+                        bestWaste = waste;
+                        bestA = a;
+                        bestB = b;
+                    }
+                }
+            }
+
+            rects[bestA] = unite(rects[bestA], rects[bestB]);
+            rects[bestB] = rects.back();
+            rects.pop_back();
+        }
+    }
+
+} // namespace DirtyRects
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DirtyRects {
+
+    struct Rect {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+
+        int64_t area() const {
+            return static_cast<int64_t>(width) * height;
+        }
+    };
+
+    struct Config {
+        // Granularity of the updates, in pixels.
+        int32_t tileSize = 64;
+        // Maximum number of copies to issue for one frame.
+        size_t maxRects = 8;
+        // Give up and copy the whole surface when more than a quarter of the area is dirty.
+        float fullCopyThreshold = 0.25f;
+        // Give up and copy the whole surface when the dirty tiles are too scattered to be merged efficiently.
+        size_t maxTileRects = 64;
+    };
+
+    // The copies to perform to bring a persistent texture up-to-date.
+    struct Plan {
+        bool fullCopy = false;
+        std::vector<Rect> rects;
+
+        int64_t copiedArea(int32_t width, int32_t height) const;
+    };
+
+    // Merges the dirty regions reported for a frame into a small set of tile-aligned rectangles.
+    class TileMerger {
+      public:
+        explicit TileMerger(const Config& config = {}) : m_config(config) {
+        }
+
+        // The returned plan is valid until the next call.
+        const Plan& plan(int32_t width, int32_t height, const Rect* dirty, size_t count);
+
+        const Config& getConfig() const {
+            return m_config;
+        }
+
+      private:
+        void markTiles(int32_t width, int32_t height, const Rect* dirty, size_t count);
+        void extractRects(int32_t width, int32_t height);
+        void mergeRects();
+
+        const Config m_config;
+
+        int32_t m_columns = 0;
+        int32_t m_rows = 0;
+        std::vector<uint8_t> m_tiles;
+        std::vector<Rect> m_open;
+        Plan m_plan;
+    };
+
+} // namespace DirtyRects
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "dirty_rects.h"
+#include "mailbox.h"
+
+namespace Capture {
+
+    // Hands the newest captured frame over to the render thread, along with every area that changed since the render
+    // thread last took one: the frames that are skipped in between only reach it through their dirty regions.
+    //
+    // Frames are only taken from the pool while the render thread wants one. The frames it is not due for stay in the
+    // pool, which throttles the capture itself once the pool is full. Either the capture thread (when a frame arrives)
+    // or the render thread (when it becomes due) drains the pool, one at a time.
+    template <typename Frame>
+    class FrameHandoff {
+      public:
+        struct Value {
+            Frame frame{};
+            // Changed since the previous frame taken, when not a full copy.
+            std::vector<DirtyRects::Rect> dirtyRects;
+            bool fullCopy = false;
+        };
+
+        // Beyond this, copying everything is cheaper than tracking the changes.
+        static constexpr size_t MaxDirtyRects = 256;
+
+        // Producer. Returns false when the other thread is already draining the pool.
+        bool beginProduce() {
+            if (m_isProducing.exchange(true, std::memory_order_acquire)) {
+                return false;
+            }
+
+            // The render thread took the previous frame, so it saw all the changes until then. The value may also have
+            // been taken right after this check, which only costs a larger copy.
+            if (!m_mailbox.hasValue()) {
+                m_pending.dirtyRects.clear();
+                m_pending.fullCopy = false;
+            }
+            m_hasFrame = false;
+            return true;
+        }
+
+        // Producer. For each frame taken from the pool, oldest first. Without dirty regions, the whole frame changed.
+        void add(Frame frame, const DirtyRects::Rect* dirtyRects, size_t count, bool hasDirtyRegions) {
+            m_pending.frame = std::move(frame);
+            m_hasFrame = true;
+            if (m_pending.fullCopy) {
+                return;
+            }
+            if (!hasDirtyRegions || m_pending.dirtyRects.size() + count > MaxDirtyRects) {
+                m_pending.dirtyRects.clear();
+                m_pending.fullCopy = true;
+                return;
+            }
+            m_pending.dirtyRects.insert(m_pending.dirtyRects.end(), dirtyRects, dirtyRects + count);
+        }
+
+        // Producer. Publishes the newest frame added, with the changes of all the frames the render thread did not
+        // take, and leaves the next frames in the pool until the render thread asks again. Returns true if it replaced
+        // a frame that was not taken.
+        bool endProduce() {
+            bool replaced = false;
+            if (m_hasFrame) {
+                replaced = m_mailbox.publish(m_pending);
+                m_pending.frame = Frame{};
+                m_hasFrame = false;
+                m_isWanted.store(false, std::memory_order_relaxed);
+            }
+            m_isProducing.store(false, std::memory_order_release);
+            return replaced;
+        }
+
+        // Consumer. Whether the capture thread should take the frames from the pool as they arrive.
+        void setWanted(bool wanted) {
+            m_isWanted.store(wanted, std::memory_order_relaxed);
+        }
+
+        bool isWanted() const {
+            return m_isWanted.load(std::memory_order_relaxed);
+        }
+
+        // Consumer.
+        bool take(Value& value) {
+            return m_mailbox.take(value);
+        }
+
+      private:
+        Utils::Mailbox<Value> m_mailbox;
+        std::atomic<bool> m_isWanted{true};
+        std::atomic<bool> m_isProducing{false};
+
+        // Owned by the thread that is producing.
+        Value m_pending;
+        bool m_hasFrame = false;
+    };
+
+} // namespace Capture
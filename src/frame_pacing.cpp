@@ -0,0 +1,97 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+
+#include "frame_pacing.h"
+
+namespace FramePacing {
+
+    void Controller::addSample(const Sample& sample) {
+        if (m_hasPrevious && sample.frameNumber > m_previous.frameNumber &&
+            sample.displayTime > m_previous.displayTime) {
+            // Skipped frame numbers are frames that the application missed.
+            const uint64_t advanced = sample.frameNumber - m_previous.frameNumber;
+            m_windowMissed += advanced - 1;
+            m_stats.missedFrames += advanced - 1;
+
+            // The wait is the time left in the frame, compared to the display period.
+            m_windowWait += sample.waitEnd - sample.waitStart;
+            m_windowPeriod += (sample.displayTime - m_previous.displayTime) / advanced;
+            m_windowFrames++;
+            m_stats.frames++;
+
+            if (m_windowFrames >= m_config.windowFrames) {
+                evaluateWindow();
+            }
+        }
+
+        m_hasPrevious = true;
+        m_previous = sample;
+    }
+
+    void Controller::evaluateWindow() {
+        const float headroom = m_windowPeriod ? static_cast<float>(m_windowWait) / m_windowPeriod : 1.f;
+        m_stats.headroom = headroom;
+
+        uint32_t level = m_level.load(std::memory_order_relaxed);
+        if (m_windowMissed || headroom < m_config.lowHeadroom) {
+            level = std::min(level + 1, MaxLevel);
+            m_goodWindows = 0;
+        } else if (headroom > m_config.highHeadroom) {
+            // Restore more slowly than we shed, to avoid oscillating.
+            if (++m_goodWindows >= m_config.restoreWindows && level > 0) {
+                level--;
+                m_goodWindows = 0;
+            }
+        } else {
+            m_goodWindows = 0;
+        }
+        m_level.store(level, std::memory_order_relaxed);
+
+        m_windowFrames = 0;
+        m_windowWait = m_windowPeriod = m_windowMissed = 0;
+    }
+
+    Budget Controller::getBudget(uint32_t level) {
+        Budget budget;
+        budget.level = level;
+        switch (level) {
+        case 0:
+            break;
+        case 1:
+            budget.minimumCaptureInterval = 1 / 30.f;
+            break;
+        case 2:
+            budget.minimumCaptureInterval = 1 / 15.f;
+            budget.uiRefreshInterval = 0.5f;
+            break;
+        default:
+            budget.minimumCaptureInterval = 1 / 5.f;
+            budget.uiRefreshInterval = 1.f;
+            break;
+        }
+        return budget;
+    }
+
+} // namespace FramePacing
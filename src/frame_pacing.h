@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace FramePacing {
+
+    // Timing of one frame, as observed around the frame synchronization call of the XR runtime.
+    struct Sample {
+        uint64_t waitStart = 0;   // When the wait started, in nanoseconds.
+        uint64_t waitEnd = 0;     // When the wait returned, in nanoseconds.
+        uint64_t displayTime = 0; // Predicted display time of the frame, in nanoseconds.
+        uint64_t frameNumber = 0;
+    };
+
+    struct Config {
+        // Number of frames evaluated at once.
+        uint32_t windowFrames = 45;
+        // Shed load when the wait takes less than this fraction of the frame period (the application is close to
+        // missing frames), or when any frame was missed.
+        float lowHeadroom = 0.1f;
+        // Restore load when the wait takes more than this fraction of the frame period.
+        float highHeadroom = 0.3f;
+        // Number of consecutive windows with enough headroom before restoring one level.
+        uint32_t restoreWindows = 3;
+    };
+
+    // How much work the overlay may do at a given load level.
+    struct Budget {
+        uint32_t level = 0;
+        // Minimum interval between two captured frames of an overlay, in seconds.
+        float minimumCaptureInterval = 0;
+        // Minimum interval between two refreshes of the window list, in seconds.
+        float uiRefreshInterval = 0;
+    };
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t missedFrames = 0;
+        float headroom = 1; // Of the last evaluated window.
+    };
+
+    // Remembers the session whose priority was set, so that the hook of the frame synchronization only sets it once per
+    // session rather than on every frame, and retries on the next frame if it failed.
+    class PriorityTracker {
+      public:
+        bool isNeeded(const void* session) const {
+            return session != m_session;
+        }
+
+        void setResult(const void* session, bool succeeded) {
+            if (succeeded) {
+                m_session = session;
+            }
+        }
+
+      private:
+        const void* m_session = nullptr;
+    };
+
+    // Raises the load level when the application runs out of frame time, and lowers it back once the headroom
+    // returns. Samples are added from the thread calling the runtime, the budget may be read from any thread.
+    class Controller {
+      public:
+        static constexpr uint32_t MaxLevel = 3;
+
+        explicit Controller(const Config& config = {}) : m_config(config) {
+        }
+
+        void addSample(const Sample& sample);
+
+        uint32_t getLevel() const {
+            return m_level.load(std::memory_order_relaxed);
+        }
+
+        Budget getBudget() const {
+            return getBudget(getLevel());
+        }
+
+        static Budget getBudget(uint32_t level);
+
+        // Not thread-safe, only for the thread adding the samples.
+        const Stats& getStats() const {
+            return m_stats;
+        }
+
+      private:
+        void evaluateWindow();
+
+        const Config m_config;
+
+        std::atomic<uint32_t> m_level{0};
+        Stats m_stats;
+
+        bool m_hasPrevious = false;
+        Sample m_previous;
+        uint32_t m_windowFrames = 0;
+        uint64_t m_windowWait = 0;
+        uint64_t m_windowPeriod = 0;
+        uint64_t m_windowMissed = 0;
+        uint32_t m_goodWindows = 0;
+    };
+
+} // namespace FramePacing
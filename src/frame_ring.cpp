@@ -0,0 +1,381 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "frame_ring.h"
+#include "instrumentation.h"
+
+namespace {
+
+    using namespace FrameRing;
+
+    constexpr const char* DirectoryName = "SKOverlay.Directory";
+    constexpr const char* StreamPrefix = "SKOverlay.Stream.";
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void copyString(char* destination, size_t capacity, const std::string& source) {
+        const size_t length = std::min(source.size(), capacity - 1);
+        memcpy(destination, source.data(), length);
+        destination[length] = '\0';
+    }
+
+    std::string readString(const char* source, size_t capacity) {
+        size_t length = 0;
+        while (length < capacity && source[length]) {
+            length++;
+        }
+        return std::string(source, length);
+    }
+
+#ifdef _WIN32
+    std::string getMappingName(const std::string& name) {
+        return "Local\\" + name;
+    }
+#else
+    std::string getMappingName(const std::string& name) {
+        return "/" + name;
+    }
+#endif
+
+} // namespace
+
+namespace FrameRing {
+
+    std::unique_ptr<SharedMemory> SharedMemory::create(const std::string& name, size_t size, bool isOwner) {
+        std::unique_ptr<SharedMemory> memory(new SharedMemory());
+        memory->m_name = getMappingName(name);
+        memory->m_size = size;
+        memory->m_isOwner = isOwner;
+
+#ifdef _WIN32
+        const HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE,
+                                                  nullptr,
+                                                  PAGE_READWRITE,
+                                                  static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+                                                  static_cast<DWORD>(size),
+                                                  memory->m_name.c_str());
+        if (!mapping) {
+            throw std::runtime_error("CreateFileMapping() failed for " + name);
+        }
+        memory->m_handle = mapping;
+        memory->m_data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (!memory->m_data) {
+            throw std::runtime_error("MapViewOfFile() failed for " + name);
+        }
+#else
+        const int fd = shm_open(memory->m_name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open() failed for " + name);
+        }
+        struct stat status;
+        if (fstat(fd, &status) || (static_cast<size_t>(status.st_size) < size && ftruncate(fd, size))) {
+            close(fd);
+            throw std::runtime_error("ftruncate() failed for " + name);
+        }
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("mmap() failed for " + name);
+        }
+        memory->m_data = data;
+#endif
+
+        return memory;
+    }
+
+    std::unique_ptr<SharedMemory> SharedMemory::open(const std::string& name) {
+        std::unique_ptr<SharedMemory> memory(new SharedMemory());
+        memory->m_name = getMappingName(name);
+
+#ifdef _WIN32
+        const HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, memory->m_name.c_str());
+        if (!mapping) {
+            throw std::runtime_error("No shared memory named " + name);
+        }
+        memory->m_handle = mapping;
+        memory->m_data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (!memory->m_data) {
+            throw std::runtime_error("MapViewOfFile() failed for " + name);
+        }
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(memory->m_data, &info, sizeof(info));
+        memory->m_size = info.RegionSize;
+#else
+        const int fd = shm_open(memory->m_name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error("No shared memory named " + name);
+        }
+        struct stat status;
+        if (fstat(fd, &status) || status.st_size <= 0) {
+            close(fd);
+            throw std::runtime_error("Empty shared memory " + name);
+        }
+        memory->m_size = status.st_size;
+        void* data = mmap(nullptr, memory->m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("mmap() failed for " + name);
+        }
+        memory->m_data = data;
+#endif
+
+        return memory;
+    }
+
+    SharedMemory::~SharedMemory() {
+#ifdef _WIN32
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_handle) {
+            CloseHandle(m_handle);
+        }
+#else
+        if (m_data) {
+            munmap(m_data, m_size);
+        }
+        if (m_isOwner) {
+            shm_unlink(m_name.c_str());
+        }
+#endif
+    }
+
+    Directory::Directory() {
+        // The directory is shared by all the producers and the overlay, it is never removed. The memory is initially
+        // zero, which is an empty directory.
+        m_memory = SharedMemory::create(DirectoryName, sizeof(Layout), false);
+        m_layout = reinterpret_cast<Layout*>(m_memory->getData());
+    }
+
+    uint64_t Directory::add(const std::string& name, const std::string& title) {
+        auto claim = [&](uint32_t expected) -> int {
+            for (size_t i = 0; i < MaxStreams; i++) {
+                DirectoryEntry& entry = m_layout->entries[i];
+                if (expected == 2 && (entry.state.load(std::memory_order_acquire) != 2 ||
+                                      readString(entry.name, sizeof(entry.name)) != name)) {
+                    continue;
+                }
+                uint32_t state = expected;
+                if (entry.state.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        };
+
+        int index = claim(2);
+        if (index < 0) {
+            index = claim(0);
+        }
+        if (index < 0) {
+            throw std::runtime_error("Too many streams");
+        }
+
+        DirectoryEntry& entry = m_layout->entries[index];
+        copyString(entry.name, sizeof(entry.name), name);
+        copyString(entry.title, sizeof(entry.title), title);
+        uint32_t generation = m_layout->generation.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!generation) {
+            generation = m_layout->generation.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+        entry.generation.store(generation, std::memory_order_relaxed);
+        entry.state.store(2, std::memory_order_release);
+
+        return (static_cast<uint64_t>(generation) << 8) | index;
+    }
+
+    void Directory::remove(uint64_t id) {
+        DirectoryEntry& entry = m_layout->entries[(id & 0xff) % MaxStreams];
+        if (entry.generation.load(std::memory_order_relaxed) == (id >> 8)) {
+            uint32_t state = 2;
+            entry.state.compare_exchange_strong(state, 0, std::memory_order_release);
+        }
+    }
+
+    void Directory::list(std::vector<Stream>& streams) const {
+        streams.clear();
+        for (size_t i = 0; i < MaxStreams; i++) {
+            const DirectoryEntry& entry = m_layout->entries[i];
+            if (entry.state.load(std::memory_order_acquire) != 2) {
+                continue;
+            }
+
+            Stream stream;
+            const uint32_t generation = entry.generation.load(std::memory_order_relaxed);
+            stream.id = (static_cast<uint64_t>(generation) << 8) | i;
+            stream.name = readString(entry.name, sizeof(entry.name));
+            stream.title = readString(entry.title, sizeof(entry.title));
+
+            // Discard the entries that were replaced while we read them.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.state.load(std::memory_order_relaxed) == 2 &&
+                entry.generation.load(std::memory_order_relaxed) == generation) {
+                streams.push_back(std::move(stream));
+            }
+        }
+    }
+
+    Producer::Producer(const std::string& name,
+                       const std::string& title,
+                       uint32_t maxWidth,
+                       uint32_t maxHeight,
+                       uint32_t slotCount) {
+        if (name.empty() || name.size() > MaxNameLength ||
+            !std::all_of(name.begin(), name.end(), [](char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' ||
+                       c == '-' || c == '_';
+            })) {
+            throw std::invalid_argument("Invalid stream name: " + name);
+        }
+        if (!maxWidth || !maxHeight || slotCount < 2) {
+            throw std::invalid_argument("Invalid stream dimensions");
+        }
+
+        const uint32_t pitch = maxWidth * 4;
+        const size_t slotOffset = alignUp(sizeof(Header) + slotCount * sizeof(SlotHeader), 4096);
+        const size_t slotStride = alignUp(static_cast<size_t>(pitch) * maxHeight, 4096);
+        m_memory = SharedMemory::create(StreamPrefix + name, slotOffset + slotStride * slotCount);
+
+        // The memory may be left over from a producer that crashed, initialize everything.
+        m_header = new (m_memory->getData()) Header{};
+        m_header->version = Version;
+        m_header->slotCount = slotCount;
+        m_header->maxWidth = maxWidth;
+        m_header->maxHeight = maxHeight;
+        m_header->pitch = pitch;
+        m_header->slotOffset = slotOffset;
+        m_header->slotStride = slotStride;
+        m_slots = reinterpret_cast<SlotHeader*>(m_header + 1);
+        for (uint32_t i = 0; i < slotCount; i++) {
+            new (&m_slots[i]) SlotHeader{};
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic = Magic;
+
+        m_id = m_directory.add(name, title);
+    }
+
+    Producer::~Producer() {
+        m_directory.remove(m_id);
+    }
+
+    uint8_t* Producer::beginFrame() {
+        const uint64_t sequence = m_sequence + 1;
+        const uint64_t index = sequence % m_header->slotCount;
+        m_slots[index].sequence.store(2 * sequence - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_isWriting = true;
+
+        return reinterpret_cast<uint8_t*>(m_header) + m_header->slotOffset + index * m_header->slotStride;
+    }
+
+    void Producer::publish(uint32_t width, uint32_t height, PixelFormat format, const DirtyRects::Rect& dirty) {
+        if (!m_isWriting) {
+            return;
+        }
+        m_isWriting = false;
+
+        const uint64_t sequence = ++m_sequence;
+        SlotHeader& slot = m_slots[sequence % m_header->slotCount];
+        slot.timestamp = Instrumentation::now();
+        slot.width = std::min(width, m_header->maxWidth);
+        slot.height = std::min(height, m_header->maxHeight);
+        slot.format = format;
+        slot.dirty = dirty;
+        slot.sequence.store(2 * sequence, std::memory_order_release);
+        m_header->publishedSequence.store(sequence, std::memory_order_release);
+    }
+
+    Consumer::Consumer(const std::string& name) {
+        m_memory = SharedMemory::open(StreamPrefix + name);
+
+        m_header = reinterpret_cast<const Header*>(m_memory->getData());
+        if (m_memory->getSize() < sizeof(Header) || m_header->magic != Magic || m_header->version != Version ||
+            m_header->slotCount < 2 || m_header->pitch < m_header->maxWidth * 4 ||
+            m_header->slotOffset < sizeof(Header) + m_header->slotCount * sizeof(SlotHeader) ||
+            m_header->slotStride < static_cast<uint64_t>(m_header->pitch) * m_header->maxHeight ||
+            m_header->slotOffset + m_header->slotStride * m_header->slotCount > m_memory->getSize()) {
+            throw std::runtime_error("Incompatible stream " + name);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        m_slots = reinterpret_cast<const SlotHeader*>(m_header + 1);
+    }
+
+    bool Consumer::acquire(uint64_t after, Frame& frame) const {
+        const uint64_t sequence = m_header->publishedSequence.load(std::memory_order_acquire);
+        if (!sequence || sequence <= after) {
+            return false;
+        }
+
+        const uint64_t index = sequence % m_header->slotCount;
+        const SlotHeader& slot = m_slots[index];
+        if (slot.sequence.load(std::memory_order_acquire) != 2 * sequence) {
+            // Already being overwritten.
+            return false;
+        }
+
+        frame.sequence = sequence;
+        frame.pixels =
+            reinterpret_cast<const uint8_t*>(m_header) + m_header->slotOffset + index * m_header->slotStride;
+        frame.width = std::min(slot.width, m_header->maxWidth);
+        frame.height = std::min(slot.height, m_header->maxHeight);
+        frame.pitch = m_header->pitch;
+        frame.format = slot.format;
+        frame.timestamp = slot.timestamp;
+
+        // Never trust the producer with the bounds.
+        const DirtyRects::Rect dirty = slot.dirty;
+        const int32_t left = std::clamp(dirty.x, 0, static_cast<int32_t>(frame.width));
+        const int32_t top = std::clamp(dirty.y, 0, static_cast<int32_t>(frame.height));
+        const int32_t right = std::clamp(dirty.x + dirty.width, left, static_cast<int32_t>(frame.width));
+        const int32_t bottom = std::clamp(dirty.y + dirty.height, top, static_cast<int32_t>(frame.height));
+        frame.dirty = {left, top, right - left, bottom - top};
+
+        return validate(frame);
+    }
+
+    bool Consumer::validate(const Frame& frame) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const SlotHeader& slot = m_slots[frame.sequence % m_header->slotCount];
+        return slot.sequence.load(std::memory_order_relaxed) == 2 * frame.sequence;
+    }
+
+} // namespace FrameRing
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dirty_rects.h"
+
+// Shared-memory protocol for external processes to stream frames to the overlay.
+//
+// A stream is a named shared memory made of a header, followed by a ring of slots. The producer fills the slot after
+// the last published one, then publishes it. Each slot is a seqlock: the consumer reads the pixels in place and checks
+// afterwards that the producer did not start overwriting the slot meanwhile. The streams are listed in a shared
+// directory, so that the overlay can discover them.
+namespace FrameRing {
+
+    constexpr uint32_t Magic = 0x474e5253; // "SRNG"
+    constexpr uint32_t Version = 1;
+    constexpr size_t MaxNameLength = 63;
+    constexpr size_t MaxTitleLength = 127;
+    constexpr size_t MaxStreams = 32;
+
+    enum class PixelFormat : uint32_t {
+        R8G8B8A8 = 0,
+        B8G8R8A8 = 1,
+    };
+
+    // A mapping of named shared memory.
+    class SharedMemory {
+      public:
+        // Create the mapping, or open it if it already exists. The owner removes the name on destruction.
+        static std::unique_ptr<SharedMemory> create(const std::string& name, size_t size, bool isOwner = true);
+        // Open an existing mapping. Throws if it does not exist.
+        static std::unique_ptr<SharedMemory> open(const std::string& name);
+
+        ~SharedMemory();
+
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        void* getData() const {
+            return m_data;
+        }
+
+        size_t getSize() const {
+            return m_size;
+        }
+
+      private:
+        SharedMemory() = default;
+
+        std::string m_name;
+        void* m_data = nullptr;
+        size_t m_size = 0;
+        void* m_handle = nullptr;
+        bool m_isOwner = false;
+    };
+
+    // Layout of the shared memory. All the fields besides the sequence numbers are only valid while the sequence number
+    // of their slot is even, and must be read before checking it again.
+    struct alignas(64) SlotHeader {
+        // 2 * sequence once published, odd while being written.
+        std::atomic<uint64_t> sequence;
+        uint64_t timestamp; // When the frame was published, see Instrumentation::now().
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        // Region that changed since the previous frame.
+        DirtyRects::Rect dirty;
+    };
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t maxWidth;
+        uint32_t maxHeight;
+        uint32_t pitch;
+        uint64_t slotOffset; // Offset of the pixels of the first slot from the header.
+        uint64_t slotStride;
+        std::atomic<uint64_t> publishedSequence;
+        // Followed by the slot headers, then the pixels.
+    };
+
+    // Entry of the directory of the streams. Identified by its index and generation.
+    struct DirectoryEntry {
+        std::atomic<uint32_t> state; // 0: free, 1: being written, 2: registered.
+        std::atomic<uint32_t> generation;
+        char name[MaxNameLength + 1];
+        char title[MaxTitleLength + 1];
+    };
+
+    struct Stream {
+        uint64_t id = 0; // Never 0.
+        std::string name;
+        std::string title;
+    };
+
+    // The shared list of the streams.
+    class Directory {
+      public:
+        Directory();
+
+        // Returns the id of the stream. A stream already registered with the same name (for example by a producer that
+        // crashed) is replaced.
+        uint64_t add(const std::string& name, const std::string& title);
+        void remove(uint64_t id);
+
+        void list(std::vector<Stream>& streams) const;
+
+      private:
+        struct Layout {
+            std::atomic<uint32_t> generation;
+            DirectoryEntry entries[MaxStreams];
+        };
+
+        std::unique_ptr<SharedMemory> m_memory;
+        Layout* m_layout = nullptr;
+    };
+
+    // Writes frames into a stream. Not thread-safe.
+    class Producer {
+      public:
+        // The name is used for the shared memory, and must only use letters, digits, '.', '-' and '_'.
+        Producer(const std::string& name,
+                 const std::string& title,
+                 uint32_t maxWidth,
+                 uint32_t maxHeight,
+                 uint32_t slotCount = 3);
+        ~Producer();
+
+        // Pixels of the next frame, with a pitch of getPitch(). The slot may hold an older frame, the whole frame must
+        // be written.
+        uint8_t* beginFrame();
+
+        // Publish the frame started with beginFrame().
+        void publish(uint32_t width, uint32_t height, PixelFormat format, const DirtyRects::Rect& dirty);
+
+        uint32_t getPitch() const {
+            return m_header->pitch;
+        }
+
+      private:
+        std::unique_ptr<SharedMemory> m_memory;
+        Header* m_header = nullptr;
+        SlotHeader* m_slots = nullptr;
+        uint64_t m_sequence = 0;
+        bool m_isWriting = false;
+
+        Directory m_directory;
+        uint64_t m_id = 0;
+    };
+
+    // A frame read in place from the shared memory.
+    struct Frame {
+        uint64_t sequence = 0;
+        const uint8_t* pixels = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t pitch = 0;
+        PixelFormat format = PixelFormat::R8G8B8A8;
+        DirtyRects::Rect dirty;
+        uint64_t timestamp = 0;
+    };
+
+    // Reads the frames of a stream.
+    class Consumer {
+      public:
+        // Throws if the stream does not exist or is not compatible.
+        explicit Consumer(const std::string& name);
+
+        // Get the most recent frame, if newer than the given sequence number.
+        bool acquire(uint64_t after, Frame& frame) const;
+
+        // Whether the frame was left intact while it was being read. Must be called after reading the pixels.
+        bool validate(const Frame& frame) const;
+
+      private:
+        std::unique_ptr<SharedMemory> m_memory;
+        const Header* m_header = nullptr;
+        const SlotHeader* m_slots = nullptr;
+    };
+
+} // namespace FrameRing
@@ -0,0 +1,148 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <algorithm>
+#include <tuple>
+
+#include "gpu_memory.h"
+
+namespace GpuMemory {
+
+    const char* toString(Level level) {
+        switch (level) {
+        case Level::Full:
+            return "Full";
+        case Level::Reduced:
+            return "Reduced";
+        case Level::Released:
+            return "Released";
+        }
+        return "";
+    }
+
+    const char* toString(Kind kind) {
+        switch (kind) {
+        case Kind::Capture:
+            return "Capture";
+        case Kind::Texture:
+            return "Texture";
+        case Kind::Staging:
+            return "Staging";
+        case Kind::Atlas:
+            return "Atlas";
+        }
+        return "";
+    }
+
+    uint64_t getTotal(const std::vector<Allocation>& allocations) {
+        uint64_t total = 0;
+        for (const auto& allocation : allocations) {
+            total += allocation.getBytes();
+        }
+        return total;
+    }
+
+    void summarize(std::vector<Allocation>& allocations) {
+        const auto key = [](const Allocation& allocation) {
+            return std::make_tuple(allocation.kind, allocation.width, allocation.height, allocation.format);
+        };
+        std::sort(allocations.begin(), allocations.end(), [&](const Allocation& a, const Allocation& b) {
+            return key(a) < key(b);
+        });
+
+        size_t count = 0;
+        for (const auto& allocation : allocations) {
+            if (count && key(allocations[count - 1]) == key(allocation)) {
+                allocations[count - 1].count += allocation.count;
+            } else {
+                allocations[count++] = allocation;
+            }
+        }
+        allocations.resize(count);
+
+        std::sort(allocations.begin(), allocations.end(), [&](const Allocation& a, const Allocation& b) {
+            return a.getBytes() != b.getBytes() ? a.getBytes() > b.getBytes() : key(a) < key(b);
+        });
+    }
+
+    void Policy::decide(const std::vector<Request>& requests,
+                        uint64_t reservedBytes,
+                        std::vector<Decision>& decisions) {
+        decisions.resize(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            decisions[i] = {requests[i].id, Level::Full};
+        }
+        if (!m_config.cap) {
+            return;
+        }
+
+        m_order.resize(requests.size());
+        for (size_t i = 0; i < m_order.size(); i++) {
+            m_order[i] = i;
+        }
+        std::sort(m_order.begin(), m_order.end(), [&](size_t a, size_t b) {
+            return requests[a].importance != requests[b].importance ? requests[a].importance > requests[b].importance
+                                                                    : requests[a].id < requests[b].id;
+        });
+
+        // Going up a level needs the margin on top, going down or staying does not.
+        const double margin = static_cast<double>(m_config.cap) * m_config.restoreMargin;
+        const auto fits = [&](const Request& request, Level level, double cost, double remaining) {
+            return cost + (request.level > level ? margin : 0) <= remaining;
+        };
+
+        double remaining = static_cast<double>(m_config.cap) - reservedBytes;
+        for (const auto& request : requests) {
+            remaining -= request.bytes[static_cast<size_t>(Level::Released)];
+        }
+
+        // Everyone at the reduced level first, by decreasing importance, releasing the overlays that do not fit.
+        for (const size_t index : m_order) {
+            const Request& request = requests[index];
+            const double cost = static_cast<double>(request.bytes[static_cast<size_t>(Level::Reduced)]) -
+                                request.bytes[static_cast<size_t>(Level::Released)];
+            if (fits(request, Level::Reduced, cost, remaining)) {
+                decisions[index].level = Level::Reduced;
+                remaining -= cost;
+            } else {
+                decisions[index].level = Level::Released;
+            }
+        }
+
+        // Then the full level, by decreasing importance, for as long as there is memory left.
+        for (const size_t index : m_order) {
+            const Request& request = requests[index];
+            if (decisions[index].level != Level::Reduced) {
+                continue;
+            }
+            const double cost = static_cast<double>(request.bytes[static_cast<size_t>(Level::Full)]) -
+                                request.bytes[static_cast<size_t>(Level::Reduced)];
+            if (fits(request, Level::Full, cost, remaining)) {
+                decisions[index].level = Level::Full;
+                remaining -= cost;
+            }
+        }
+    }
+
+} // namespace GpuMemory
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Accounting of the GPU memory held by the overlays, and the policy that keeps it under a cap.
+namespace GpuMemory {
+
+    // How much memory an overlay may hold, from the most to the least.
+    enum class Level {
+        Full,     // Native resolution, all the capture buffers.
+        Reduced,  // Lower resolution or fewer capture buffers, depending on the source.
+        Released, // No capture, nothing held.
+    };
+
+    constexpr size_t LevelCount = 3;
+
+    enum class Kind {
+        Capture, // Buffers the frames are captured into.
+        Texture, // Texture the overlay is drawn from.
+        Staging, // Texture to read the frames back.
+        Atlas,   // Page shared by several overlays.
+    };
+
+    const char* toString(Level level);
+    const char* toString(Kind kind);
+
+    struct Allocation {
+        Kind kind = Kind::Texture;
+        int32_t width = 0;
+        int32_t height = 0;
+        int64_t format = 0; // Native format (DXGI_FORMAT on Windows).
+        uint32_t count = 1;
+
+        // All the formats we capture to use 4 bytes per pixel.
+        uint64_t getBytes() const {
+            return static_cast<uint64_t>(width) * height * 4 * count;
+        }
+    };
+
+    uint64_t getTotal(const std::vector<Allocation>& allocations);
+
+    // Merge the allocations of the same kind, size and format, largest total first.
+    void summarize(std::vector<Allocation>& allocations);
+
+    struct Config {
+        // In bytes, 0 for no limit.
+        uint64_t cap = 0;
+        // An overlay only goes back up a level if this fraction of the cap is left free afterwards, so that it does not
+        // flip between levels as the other overlays change size.
+        float restoreMargin = 0.1f;
+    };
+
+    struct Request {
+        uint64_t id = 0;
+        float importance = 0;
+        uint64_t bytes[LevelCount] = {}; // Held at each level.
+        Level level = Level::Full;       // Current level.
+    };
+
+    struct Decision {
+        uint64_t id = 0;
+        Level level = Level::Full;
+    };
+
+    // Fits the overlays under the cap. The least important overlays are reduced first, then released, and the most
+    // important ones get their full resolution back first. Deterministic: the same requests always produce the same
+    // decisions.
+    class Policy {
+      public:
+        explicit Policy(const Config& config = {}) : m_config(config) {
+        }
+
+        // The decisions are in the same order as the requests. The reserved memory is held outside of the overlays (eg:
+        // by the atlas pages), and taken from the cap first.
+        void decide(const std::vector<Request>& requests, uint64_t reservedBytes, std::vector<Decision>& decisions);
+
+        const Config& getConfig() const {
+            return m_config;
+        }
+
+      private:
+        const Config m_config;
+        std::vector<size_t> m_order;
+    };
+
+} // namespace GpuMemory
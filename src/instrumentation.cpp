@@ -0,0 +1,203 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "instrumentation.h"
+
+namespace {
+
+    uint32_t getThreadIndex() {
+        static std::atomic<uint32_t> nextIndex{1};
+        thread_local const uint32_t index = nextIndex++;
+        return index;
+    }
+
+    uint32_t getMostSignificantBit(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+} // namespace
+
+namespace Instrumentation {
+
+    uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    Recorder::Recorder(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        m_slots = std::make_unique<Slot[]>(size);
+        m_mask = size - 1;
+    }
+
+    void Recorder::record(const char* name, uint64_t key, uint64_t start, uint64_t duration) {
+        const uint64_t index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = m_slots[index & m_mask];
+
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.key.store(key, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.thread.store(getThreadIndex(), std::memory_order_relaxed);
+        slot.sequence.store(2 * (index + 1), std::memory_order_release);
+    }
+
+    Recorder& getRecorder() {
+        static Recorder recorder;
+        return recorder;
+    }
+
+    uint32_t Histogram::getBucket(uint64_t value) {
+        if (value < SubBuckets) {
+            return static_cast<uint32_t>(value);
+        }
+
+        const uint32_t shift = getMostSignificantBit(value) - SubBucketBits;
+        return (shift + 1) * SubBuckets + static_cast<uint32_t>((value >> shift) & (SubBuckets - 1));
+    }
+
+    uint64_t Histogram::getBucketMidpoint(uint32_t bucket) {
+        if (bucket < SubBuckets) {
+            return bucket;
+        }
+
+        const uint32_t shift = bucket / SubBuckets - 1;
+        const uint64_t lower = static_cast<uint64_t>(SubBuckets + bucket % SubBuckets) << shift;
+        return lower + ((1ull << shift) >> 1);
+    }
+
+    uint64_t Histogram::getPercentile(double percentile) const {
+        if (!m_count) {
+            return 0;
+        }
+
+        const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(percentile * m_count + 0.5));
+        uint64_t accumulated = 0;
+        for (uint32_t i = 0; i < m_buckets.size(); i++) {
+            accumulated += m_buckets[i];
+            if (accumulated >= target) {
+                return getBucketMidpoint(i);
+            }
+        }
+        return getBucketMidpoint(static_cast<uint32_t>(m_buckets.size() - 1));
+    }
+
+    bool Statistics::PhaseLess::operator()(const std::pair<const char*, uint64_t>& a,
+                                           const std::pair<const char*, uint64_t>& b) const {
+        const int order = a.first == b.first ? 0 : strcmp(a.first, b.first);
+        return order != 0 ? order < 0 : a.second < b.second;
+    }
+
+    Statistics::Statistics(Recorder& recorder, uint64_t period)
+        : m_recorder(recorder), m_period(period), m_periodStart(now()) {
+    }
+
+    void Statistics::update() {
+        m_lostEvents += m_recorder.drain([&](const Event& event) {
+            m_histograms[{event.name, event.key}].record(event.duration);
+
+            if (m_isTracing && m_traceEvents.size() < m_maxTraceEvents) {
+                m_traceEvents.push_back(event);
+            }
+        });
+
+        if (now() - m_periodStart >= m_period) {
+            rollPeriod();
+        }
+    }
+
+    void Statistics::rollPeriod() {
+        m_entries.clear();
+        for (auto it = m_histograms.begin(); it != m_histograms.end();) {
+            auto& histogram = it->second;
+            if (!histogram.getCount()) {
+                // Forget phases and overlays that are gone.
+                it = m_histograms.erase(it);
+                continue;
+            }
+
+            m_entries.push_back({it->first.first,
+                                 it->first.second,
+                                 histogram.getCount(),
+                                 histogram.getPercentile(0.5),
+                                 histogram.getPercentile(0.99)});
+            histogram.reset();
+            it++;
+        }
+
+        m_periodStart = now();
+    }
+
+    void Statistics::startTrace(size_t maxEvents) {
+        m_isTracing = true;
+        m_maxTraceEvents = maxEvents;
+        m_traceEvents.reserve(std::min<size_t>(maxEvents, 1 << 20));
+    }
+
+    bool Statistics::writeTrace(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+
+        fprintf(file, "{\"traceEvents\":[\n");
+        for (size_t i = 0; i < m_traceEvents.size(); i++) {
+            const Event& event = m_traceEvents[i];
+            // Names are literals from our own code and never need escaping.
+            fprintf(file,
+                    "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"overlay\":%llu}}\n",
+                    i ? "," : "",
+                    event.name,
+                    event.thread,
+                    event.start / 1000.0,
+                    event.duration / 1000.0,
+                    static_cast<unsigned long long>(event.key));
+        }
+        fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+        return fclose(file) == 0;
+    }
+
+} // namespace Instrumentation
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Instrumentation {
+
+    // Monotonic time in nanoseconds.
+    uint64_t now();
+
+    struct Event {
+        const char* name = nullptr; // Must be a string with static storage (literal).
+        uint64_t key = 0;           // 0 for global phases, otherwise identifies the overlay.
+        uint64_t start = 0;
+        uint64_t duration = 0;
+        uint32_t thread = 0;
+    };
+
+    // Lock-free multiple-producer, single-consumer ring buffer of events. When the consumer falls behind, the oldest
+    // events are overwritten and accounted for as lost.
+    class Recorder {
+      public:
+        // The capacity is rounded up to a power of two.
+        explicit Recorder(size_t capacity = 16384);
+
+        void record(const char* name, uint64_t key, uint64_t start, uint64_t duration);
+
+        // Consume all the events that are fully written. Returns the number of events that were lost.
+        template <typename Callback>
+        uint64_t drain(Callback&& callback) {
+            uint64_t lost = 0;
+            const uint64_t writeIndex = m_writeIndex.load(std::memory_order_acquire);
+            if (writeIndex - m_readIndex > m_mask + 1) {
+                lost += writeIndex - m_readIndex - (m_mask + 1);
+                m_readIndex = writeIndex - (m_mask + 1);
+            }
+
+            for (; m_readIndex < writeIndex; m_readIndex++) {
+                Slot& slot = m_slots[m_readIndex & m_mask];
+
+                // Each slot is a seqlock: odd while being written, then 2 * (index + 1).
+                const uint64_t expected = 2 * (m_readIndex + 1);
+                const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+                if (before < expected) {
+                    // Still being written, resume from here next time.
+                    break;
+                }
+
+                Event event;
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.key = slot.key.load(std::memory_order_relaxed);
+                event.start = slot.start.load(std::memory_order_relaxed);
+                event.duration = slot.duration.load(std::memory_order_relaxed);
+                event.thread = slot.thread.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (before != expected || slot.sequence.load(std::memory_order_relaxed) != before) {
+                    // Overwritten by a producer that lapped us.
+                    lost++;
+                    continue;
+                }
+
+                callback(event);
+            }
+
+            return lost;
+        }
+
+      private:
+        struct Slot {
+            std::atomic<uint64_t> sequence{0};
+            std::atomic<const char*> name{nullptr};
+            std::atomic<uint64_t> key{0};
+            std::atomic<uint64_t> start{0};
+            std::atomic<uint64_t> duration{0};
+            std::atomic<uint32_t> thread{0};
+        };
+
+        std::unique_ptr<Slot[]> m_slots;
+        uint64_t m_mask = 0;
+        std::atomic<uint64_t> m_writeIndex{0};
+        uint64_t m_readIndex = 0;
+    };
+
+    // The recorder used by the scoped timers.
+    Recorder& getRecorder();
+
+    // Record the duration of the enclosing scope.
+    class Scope {
+      public:
+        explicit Scope(const char* name, uint64_t key = 0) : m_name(name), m_key(key), m_start(now()) {
+        }
+
+        ~Scope() {
+            getRecorder().record(m_name, m_key, m_start, now() - m_start);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        const char* const m_name;
+        const uint64_t m_key;
+        const uint64_t m_start;
+    };
+
+    // Log-linear histogram of durations, accurate to ~6%.
+    class Histogram {
+      public:
+        void record(uint64_t value) {
+            m_buckets[getBucket(value)]++;
+            m_count++;
+        }
+
+        // Approximate value at the given percentile (0 to 1).
+        uint64_t getPercentile(double percentile) const;
+
+        uint64_t getCount() const {
+            return m_count;
+        }
+
+        void reset() {
+            m_buckets.fill(0);
+            m_count = 0;
+        }
+
+      private:
+        static constexpr uint32_t SubBucketBits = 4;
+        static constexpr uint32_t SubBuckets = 1 << SubBucketBits;
+
+        static uint32_t getBucket(uint64_t value);
+        static uint64_t getBucketMidpoint(uint32_t bucket);
+
+        std::array<uint32_t, (64 - SubBucketBits + 1) * SubBuckets> m_buckets{};
+        uint64_t m_count = 0;
+    };
+
+    // Aggregates the events from a recorder into per-phase and per-overlay percentiles over a rolling period, and
+    // optionally keeps the events for a Chrome trace.
+    class Statistics {
+      public:
+        struct Entry {
+            const char* name;
+            uint64_t key;
+            uint64_t count;
+            uint64_t p50;
+            uint64_t p99;
+        };
+
+        explicit Statistics(Recorder& recorder, uint64_t period = 2'000'000'000);
+
+        // Consume the pending events.
+        void update();
+
+        // Results for the last completed period, sorted by name then key.
+        const std::vector<Entry>& getEntries() const {
+            return m_entries;
+        }
+
+        uint64_t getLostEvents() const {
+            return m_lostEvents;
+        }
+
+        // Start keeping events, up to the given count, for writeTrace().
+        void startTrace(size_t maxEvents);
+
+        // Write the kept events in the Chrome trace event format (chrome://tracing, Perfetto).
+        bool writeTrace(const std::string& path) const;
+
+      private:
+        // By name then key. The names are compared by content: the same literal may have a different address in each
+        // translation unit.
+        struct PhaseLess {
+            bool operator()(const std::pair<const char*, uint64_t>& a,
+                            const std::pair<const char*, uint64_t>& b) const;
+        };
+
+        void rollPeriod();
+
+        Recorder& m_recorder;
+        const uint64_t m_period;
+        uint64_t m_periodStart;
+
+        std::map<std::pair<const char*, uint64_t>, Histogram, PhaseLess> m_histograms;
+        std::vector<Entry> m_entries;
+        uint64_t m_lostEvents = 0;
+
+        bool m_isTracing = false;
+        size_t m_maxTraceEvents = 0;
+        std::vector<Event> m_traceEvents;
+    };
+
+} // namespace Instrumentation
@@ -0,0 +1,385 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "layout.h"
+#include "title_matcher.h"
+
+namespace {
+
+    using namespace Layout;
+
+    struct StringRef {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t profileCount;
+        uint32_t entryCount;
+        uint32_t profileOffset;
+        uint32_t entryOffset;
+        uint32_t stringOffset;
+        uint32_t stringSize;
+    };
+
+    struct ProfileRecord {
+        StringRef name;
+        uint32_t firstEntry;
+        uint32_t entryCount;
+    };
+
+    struct EntryRecord {
+        uint32_t kind;
+        uint32_t flags;
+        float position[3];
+        float orientation[4];
+        float scale;
+        StringRef process;
+        StringRef titlePattern;
+        // Since version 2.
+        float crop[4];
+    };
+
+    size_t getEntryRecordSize(uint32_t version) {
+        return version < 2 ? offsetof(EntryRecord, crop) : sizeof(EntryRecord);
+    }
+
+    const EntryRecord& getEntryRecord(const uint8_t* data, const FileHeader& header, size_t index) {
+        return *reinterpret_cast<const EntryRecord*>(data + header.entryOffset +
+                                                     index * getEntryRecordSize(header.version));
+    }
+
+    bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                   return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+               });
+    }
+
+    class Writer {
+      public:
+        StringRef addString(const std::string& string) {
+            const StringRef ref{static_cast<uint32_t>(m_strings.size()), static_cast<uint32_t>(string.size())};
+            m_strings += string;
+            return ref;
+        }
+
+        const std::string& getStrings() const {
+            return m_strings;
+        }
+
+      private:
+        std::string m_strings;
+    };
+
+} // namespace
+
+namespace Layout {
+
+    std::unique_ptr<File> File::open(const std::string& path) {
+        std::unique_ptr<File> file(new File());
+
+#ifdef _WIN32
+        const HANDLE handle = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return nullptr;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(handle, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(FileHeader))) {
+            CloseHandle(handle);
+            throw std::runtime_error("Layout file is truncated: " + path);
+        }
+        const HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(handle);
+        if (!mapping) {
+            throw std::runtime_error("CreateFileMapping() failed for " + path);
+        }
+        file->m_handle = mapping;
+        file->m_size = static_cast<size_t>(size.QuadPart);
+        file->m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!file->m_data) {
+            throw std::runtime_error("MapViewOfFile() failed for " + path);
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat status;
+        if (fstat(fd, &status) || static_cast<size_t>(status.st_size) < sizeof(FileHeader)) {
+            close(fd);
+            throw std::runtime_error("Layout file is truncated: " + path);
+        }
+        void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("mmap() failed for " + path);
+        }
+        file->m_data = static_cast<const uint8_t*>(data);
+        file->m_size = status.st_size;
+#endif
+
+        file->validate();
+        return file;
+    }
+
+    File::~File() {
+#ifdef _WIN32
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_handle) {
+            CloseHandle(m_handle);
+        }
+#else
+        if (m_data) {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+#endif
+    }
+
+    void File::validate() const {
+        const auto header = reinterpret_cast<const FileHeader*>(m_data);
+        if (header->magic != Magic) {
+            throw std::runtime_error("Not a layout file");
+        }
+        if (header->version < 1 || header->version > Version) {
+            throw std::runtime_error("Unsupported layout file version " + std::to_string(header->version));
+        }
+
+        const auto inBounds = [&](uint64_t offset, uint64_t size) { return offset + size <= m_size; };
+        if (!inBounds(header->profileOffset, uint64_t{header->profileCount} * sizeof(ProfileRecord)) ||
+            !inBounds(header->entryOffset, uint64_t{header->entryCount} * getEntryRecordSize(header->version)) ||
+            !inBounds(header->stringOffset, header->stringSize) || header->profileOffset % alignof(ProfileRecord) ||
+            header->entryOffset % alignof(EntryRecord)) {
+            throw std::runtime_error("Layout file is truncated");
+        }
+
+        const auto stringInBounds = [&](const StringRef& ref) {
+            return uint64_t{ref.offset} + ref.length <= header->stringSize;
+        };
+        const auto profiles = reinterpret_cast<const ProfileRecord*>(m_data + header->profileOffset);
+        for (uint32_t i = 0; i < header->profileCount; i++) {
+            if (!stringInBounds(profiles[i].name) ||
+                uint64_t{profiles[i].firstEntry} + profiles[i].entryCount > header->entryCount) {
+                throw std::runtime_error("Layout file is corrupted");
+            }
+        }
+        for (uint32_t i = 0; i < header->entryCount; i++) {
+            const EntryRecord& record = getEntryRecord(m_data, *header, i);
+            if (!stringInBounds(record.process) || !stringInBounds(record.titlePattern) ||
+                record.kind > static_cast<uint32_t>(Kind::Stream)) {
+                throw std::runtime_error("Layout file is corrupted");
+            }
+        }
+    }
+
+    std::vector<std::string> File::getProfileNames() const {
+        const auto header = reinterpret_cast<const FileHeader*>(m_data);
+        const auto profiles = reinterpret_cast<const ProfileRecord*>(m_data + header->profileOffset);
+        const char* strings = reinterpret_cast<const char*>(m_data + header->stringOffset);
+
+        std::vector<std::string> names;
+        for (uint32_t i = 0; i < header->profileCount; i++) {
+            names.emplace_back(strings + profiles[i].name.offset, profiles[i].name.length);
+        }
+        return names;
+    }
+
+    bool File::getProfile(const std::string& name, Profile& profile) const {
+        const auto header = reinterpret_cast<const FileHeader*>(m_data);
+        const auto profiles = reinterpret_cast<const ProfileRecord*>(m_data + header->profileOffset);
+        const char* strings = reinterpret_cast<const char*>(m_data + header->stringOffset);
+        const auto getString = [&](const StringRef& ref) { return std::string(strings + ref.offset, ref.length); };
+
+        for (uint32_t i = 0; i < header->profileCount; i++) {
+            if (getString(profiles[i].name) != name) {
+                continue;
+            }
+
+            profile.name = name;
+            profile.entries.clear();
+            for (uint32_t j = 0; j < profiles[i].entryCount; j++) {
+                const EntryRecord& record = getEntryRecord(m_data, *header, profiles[i].firstEntry + j);
+                Entry entry;
+                entry.kind = static_cast<Kind>(record.kind);
+                entry.process = getString(record.process);
+                entry.titlePattern = getString(record.titlePattern);
+                std::copy(std::begin(record.position), std::end(record.position), entry.position);
+                std::copy(std::begin(record.orientation), std::end(record.orientation), entry.orientation);
+                entry.scale = record.scale;
+                entry.flags = record.flags;
+                if (header->version >= 2) {
+                    std::copy(std::begin(record.crop), std::end(record.crop), entry.crop);
+                }
+                profile.entries.push_back(std::move(entry));
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void save(const std::string& path, const std::vector<Profile>& profiles) {
+        Writer writer;
+        std::vector<ProfileRecord> profileRecords;
+        std::vector<EntryRecord> entryRecords;
+        for (const auto& profile : profiles) {
+            profileRecords.push_back({writer.addString(profile.name),
+                                      static_cast<uint32_t>(entryRecords.size()),
+                                      static_cast<uint32_t>(profile.entries.size())});
+            for (const auto& entry : profile.entries) {
+                EntryRecord record{};
+                record.kind = static_cast<uint32_t>(entry.kind);
+                record.flags = entry.flags;
+                std::copy(std::begin(entry.position), std::end(entry.position), record.position);
+                std::copy(std::begin(entry.orientation), std::end(entry.orientation), record.orientation);
+                record.scale = entry.scale;
+                record.process = writer.addString(entry.process);
+                record.titlePattern = writer.addString(entry.titlePattern);
+                std::copy(std::begin(entry.crop), std::end(entry.crop), record.crop);
+                entryRecords.push_back(record);
+            }
+        }
+
+        FileHeader header{};
+        header.magic = Magic;
+        header.version = Version;
+        header.profileCount = static_cast<uint32_t>(profileRecords.size());
+        header.entryCount = static_cast<uint32_t>(entryRecords.size());
+        header.profileOffset = sizeof(FileHeader);
+        header.entryOffset = header.profileOffset + header.profileCount * sizeof(ProfileRecord);
+        header.stringOffset = header.entryOffset + header.entryCount * sizeof(EntryRecord);
+        header.stringSize = static_cast<uint32_t>(writer.getStrings().size());
+
+        const std::string temporaryPath = path + ".tmp";
+        FILE* file = fopen(temporaryPath.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Failed to create " + temporaryPath);
+        }
+        bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+        success = success && fwrite(profileRecords.data(), sizeof(ProfileRecord), profileRecords.size(), file) ==
+                                 profileRecords.size();
+        success = success && fwrite(entryRecords.data(), sizeof(EntryRecord), entryRecords.size(), file) ==
+                                 entryRecords.size();
+        success = success &&
+                  fwrite(writer.getStrings().data(), 1, writer.getStrings().size(), file) == writer.getStrings().size();
+        success = !fclose(file) && success;
+        if (!success) {
+            remove(temporaryPath.c_str());
+            throw std::runtime_error("Failed to write " + temporaryPath);
+        }
+
+#ifdef _WIN32
+        const bool replaced = MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+        const bool replaced = !rename(temporaryPath.c_str(), path.c_str());
+#endif
+        if (!replaced) {
+            remove(temporaryPath.c_str());
+            throw std::runtime_error("Failed to replace " + path);
+        }
+    }
+
+    std::vector<Profile> loadAll(const std::string& path) {
+        std::vector<Profile> profiles;
+        const auto file = File::open(path);
+        if (file) {
+            for (const auto& name : file->getProfileNames()) {
+                Profile profile;
+                file->getProfile(name, profile);
+                profiles.push_back(std::move(profile));
+            }
+        }
+        return profiles;
+    }
+
+    std::string makeTitlePattern(const std::string& title) {
+        std::string pattern = "^";
+        for (const char c : title) {
+            if (strchr("\\^$.|?*+()[]{}", c)) {
+                pattern += '\\';
+            }
+            pattern += c;
+        }
+        pattern += '$';
+        return pattern;
+    }
+
+    std::vector<std::pair<size_t, size_t>> match(const Profile& profile, const std::vector<Identity>& candidates) {
+        std::vector<std::string> patterns;
+        for (const auto& entry : profile.entries) {
+            patterns.push_back(entry.titlePattern);
+        }
+        TitleMatcher::Matcher matcher;
+        matcher.add(patterns);
+
+        std::vector<TitleMatcher::MatchSet> matches;
+        matches.reserve(candidates.size());
+        for (const auto& candidate : candidates) {
+            matches.push_back(matcher.match(candidate.title));
+        }
+
+        std::vector<std::pair<size_t, size_t>> assignments;
+        std::vector<bool> assigned(candidates.size());
+        for (size_t i = 0; i < profile.entries.size(); i++) {
+            const Entry& entry = profile.entries[i];
+            if (entry.flags & SameCapture) {
+                // Share the candidate of the previous entry, if it was assigned.
+                if (i > 0 && !assignments.empty() && assignments.back().first == i - 1) {
+                    assignments.push_back({i, assignments.back().second});
+                }
+                continue;
+            }
+            for (size_t j = 0; j < candidates.size(); j++) {
+                if (!assigned[j] && matches[j][i] && candidates[j].kind == entry.kind &&
+                    (entry.kind != Kind::Window || equalsIgnoreCase(candidates[j].process, entry.process))) {
+                    assigned[j] = true;
+                    assignments.push_back({i, j});
+                    break;
+                }
+            }
+        }
+        return assignments;
+    }
+
+} // namespace Layout
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Layouts of the overlays, saved across sessions.
+//
+// The file is a compact binary, mapped in memory for reading: a header, the profile records, the entry records, then
+// the strings. All the offsets are relative to the start of the file, and the file is rejected if any of them is out
+// of bounds. Files of version 1 have no crop in their entry records, and are still read.
+namespace Layout {
+
+    constexpr uint32_t Magic = 0x594c4b53; // "SKLY"
+    constexpr uint32_t Version = 2;
+
+    enum class Kind : uint32_t {
+        Window = 0,
+        Monitor = 1,
+        Stream = 2,
+    };
+
+    enum Flags : uint32_t {
+        Decorate = 1 << 0,
+        Minimized = 1 << 1,
+        Pinned = 1 << 2,
+        // Another view of the item of the previous entry, sharing its capture.
+        SameCapture = 1 << 3,
+        // Only draw the content, without its uniform borders.
+        TrimBorders = 1 << 4,
+    };
+
+    // A saved overlay.
+    struct Entry {
+        Kind kind = Kind::Window;
+        // Image name of the owning process (eg: "notepad.exe"), for windows only. Compared case-insensitively.
+        std::string process;
+        // Case-insensitive ECMAScript expression, matched against the title of the window, monitor or stream.
+        std::string titlePattern;
+        float position[3] = {};
+        float orientation[4] = {0, 0, 0, 1};
+        float scale = 0.75f;
+        uint32_t flags = Decorate;
+        // Region of the item shown, in texture coordinates: x, y, width, height.
+        float crop[4] = {0, 0, 1, 1};
+    };
+
+    struct Profile {
+        std::string name;
+        std::vector<Entry> entries;
+    };
+
+    // What a window, monitor or stream is matched against.
+    struct Identity {
+        Kind kind = Kind::Window;
+        std::string process;
+        std::string title;
+    };
+
+    // A layout file, mapped in memory.
+    class File {
+      public:
+        // Returns nullptr if the file does not exist. Throws std::runtime_error if it is corrupted or of a newer
+        // version.
+        static std::unique_ptr<File> open(const std::string& path);
+
+        ~File();
+
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        std::vector<std::string> getProfileNames() const;
+
+        // Returns false if there is no profile with that name.
+        bool getProfile(const std::string& name, Profile& profile) const;
+
+      private:
+        File() = default;
+
+        void validate() const;
+
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        void* m_handle = nullptr;
+    };
+
+    // Replace the file with the given profiles. The file is written next to the original first, so that a failure
+    // never leaves a truncated layout. Throws std::runtime_error on failure.
+    void save(const std::string& path, const std::vector<Profile>& profiles);
+
+    // Read all the profiles of a file, to update one of them. Returns an empty list if the file does not exist.
+    std::vector<Profile> loadAll(const std::string& path);
+
+    // An expression that only matches the exact title.
+    std::string makeTitlePattern(const std::string& title);
+
+    // Assign the entries of the profile to the candidates, in the order of the entries. Each candidate is assigned at
+    // most once, besides to the SameCapture entries that follow its entry. Returns the pairs of entry index and
+    // candidate index. Throws std::regex_error on invalid patterns.
+    std::vector<std::pair<size_t, size_t>> match(const Profile& profile, const std::vector<Identity>& candidates);
+
+} // namespace Layout
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace Utils {
+
+    // Lock-free handoff of the latest value from one producer thread to one consumer thread (a triple buffer). The
+    // producer never waits for the consumer and the consumer never waits for the producer: a value that is not taken
+    // before the next one is published is replaced, and released on the producer thread.
+    template <typename T>
+    class Mailbox {
+      public:
+        // Producer only. Returns true if an untaken value was replaced.
+        bool publish(T value) {
+            m_slots[m_back] = std::move(value);
+            const uint32_t previous = m_middle.exchange(m_back | FreshBit, std::memory_order_acq_rel);
+            m_back = previous & IndexMask;
+
+            // Release the replaced value now, rather than when its slot is reused.
+            m_slots[m_back] = T{};
+            return previous & FreshBit;
+        }
+
+        // Consumer only. Moves out the latest value, if one was published since the previous call.
+        bool take(T& value) {
+            if (!(m_middle.load(std::memory_order_relaxed) & FreshBit)) {
+                return false;
+            }
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & IndexMask;
+            value = std::move(m_slots[m_front]);
+            m_slots[m_front] = T{};
+            return true;
+        }
+
+        // Whether a value is waiting to be taken. Only a hint to the producer.
+        bool hasValue() const {
+            return m_middle.load(std::memory_order_relaxed) & FreshBit;
+        }
+
+      private:
+        static constexpr uint32_t IndexMask = 3;
+        static constexpr uint32_t FreshBit = 4;
+
+        // Each slot is owned by exactly one of the producer (back), the exchange (middle) or the consumer (front).
+        T m_slots[3]{};
+        alignas(64) uint32_t m_back = 0;
+        alignas(64) std::atomic<uint32_t> m_middle{1};
+        alignas(64) uint32_t m_front = 2;
+    };
+
+} // namespace Utils
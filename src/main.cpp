@@ -31,10 +31,16 @@ using Microsoft::WRL::ComPtr;
 #include <d3d11.h>
 #include <Varjo.h>
 #include <detours.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <filesystem>
+#include <future>
 #include <memory>
-#include <regex>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <winrt/base.h>
@@ -47,16 +53,54 @@ using Microsoft::WRL::ComPtr;
 #include <stereokit_ui.h>
 using namespace sk;
 
+#include "capture_scheduler.h"
+#include "capture_source.h"
+#include "dirty_rects.h"
+#include "frame_handoff.h"
+#include "frame_pacing.h"
+#include "frame_ring.h"
+#include "gpu_memory.h"
+#include "instrumentation.h"
+#include "overlay.h"
+#include "pixel_kernels.h"
+#include "recording.h"
+#include "resize_debouncer.h"
+#include "texture_pool.h"
 #include "utils.h"
+#include "window_list.h"
 
 namespace {
 
-    // Hook the Varjo SDK (used by the OpenXR runtime) to keep the session as an overlay.
+    // Adjusts the load of the overlay to the frame timings of the session.
+    FramePacing::Controller g_framePacing;
+    FramePacing::PriorityTracker g_sessionPriority;
+    uint64_t g_lastWaitEnd = 0;
+
+    // Hook the Varjo SDK (used by the OpenXR runtime) to keep the session as an overlay, and to observe the frame
+    // timings.
     void (*original_varjo_WaitSync)(struct varjo_Session* session, struct varjo_FrameInfo* frameInfo) = nullptr;
     void hooked_varjo_WaitSync(struct varjo_Session* session, struct varjo_FrameInfo* frameInfo) {
-        varjo_SessionSetPriority(session, 1000);
+        // The priority is a property of the session, only set it once.
+        if (g_sessionPriority.isNeeded(session)) {
+            varjo_SessionSetPriority(session, 1000);
+            g_sessionPriority.setResult(session, varjo_GetError(session) == varjo_NoError);
+        }
+
+        const uint64_t waitStart = Instrumentation::now();
+        original_varjo_WaitSync(session, frameInfo);
+        const uint64_t waitEnd = Instrumentation::now();
+
+        auto& recorder = Instrumentation::getRecorder();
+        recorder.record("WaitSync", 0, waitStart, waitEnd - waitStart);
+        if (g_lastWaitEnd) {
+            recorder.record("frame interval", 0, g_lastWaitEnd, waitEnd - g_lastWaitEnd);
+        }
+        g_lastWaitEnd = waitEnd;
 
-        return original_varjo_WaitSync(session, frameInfo);
+        g_framePacing.addSample({waitStart,
+                                 waitEnd,
+                                 static_cast<uint64_t>(frameInfo->displayTime),
+                                 static_cast<uint64_t>(frameInfo->frameNumber)});
     }
 
     // Alternative to windows.graphics.directx.direct3d11.interop.h
@@ -72,10 +116,20 @@ namespace {
         virtual HRESULT __stdcall GetInterface(GUID const& id, void** object) = 0;
     };
 
+    using TexturePool = Capture::TexturePool<ComPtr<ID3D11Texture2D>>;
+
+    // The recordings to replay are listed with the streams, with this bit set in their handle.
+    constexpr uint64_t ReplayHandleBit = uint64_t{1} << 63;
+
     // Helper for WinRT window capture.
-    class CaptureWindow {
+    class CaptureWindow : public Capture::ICaptureSource {
       public:
-        CaptureWindow(ID3D11Device* device, HWND window) {
+        CaptureWindow(ID3D11Device* device,
+                      const winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice& interopDevice,
+                      std::shared_ptr<TexturePool> texturePool,
+                      uint32_t poolDepth,
+                      HWND window)
+            : m_texturePool(std::move(texturePool)), m_poolDepth(poolDepth) {
             auto interop_factory = winrt::get_activation_factory<winrt::Windows::Graphics::Capture::GraphicsCaptureItem,
                                                                  IGraphicsCaptureItemInterop>();
             winrt::check_hresult(interop_factory->CreateForWindow(
@@ -83,10 +137,15 @@ namespace {
                 winrt::guid_of<ABI::Windows::Graphics::Capture::IGraphicsCaptureItem>(),
                 winrt::put_abi(m_item)));
 
-            initialize(device);
+            initialize(device, interopDevice);
         }
 
-        CaptureWindow(ID3D11Device* device, HMONITOR monitor) {
+        CaptureWindow(ID3D11Device* device,
+                      const winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice& interopDevice,
+                      std::shared_ptr<TexturePool> texturePool,
+                      uint32_t poolDepth,
+                      HMONITOR monitor)
+            : m_texturePool(std::move(texturePool)), m_poolDepth(poolDepth) {
             auto interop_factory = winrt::get_activation_factory<winrt::Windows::Graphics::Capture::GraphicsCaptureItem,
                                                                  IGraphicsCaptureItemInterop>();
             winrt::check_hresult(interop_factory->CreateForMonitor(
@@ -94,362 +153,1817 @@ namespace {
                 winrt::guid_of<ABI::Windows::Graphics::Capture::IGraphicsCaptureItem>(),
                 winrt::put_abi(m_item)));
 
-            initialize(device);
+            initialize(device, interopDevice);
         }
 
         ~CaptureWindow() {
-            m_session.Close();
-            m_framePool.Close();
+            if (m_session) {
+                m_session.Close();
+            }
+            releaseFramePool();
+            releaseOverlayTexture();
         }
 
-        ID3D11Texture2D* getSurface() const {
-            auto frame = m_framePool.TryGetNextFrame();
-            if (frame != nullptr) {
+        uint64_t update() override {
+            FrameHandoff::Value arrived;
+            bool hasFrame = m_frameHandoff->take(arrived);
+            if (!hasFrame && m_framePool) {
+                // The frames that arrived while we were not due for one are still in the pool.
+                drainFramePool(*m_frameHandoff, m_framePool);
+                hasFrame = m_frameHandoff->take(arrived);
+            }
+
+            // Only take the next frame as soon as it arrives when we are waiting for one. Otherwise, it stays in the
+            // pool until we are due again, and the capture stops once the pool is full.
+            m_frameHandoff->setWanted(!hasFrame);
+
+            if (hasFrame) {
+                const auto& frame = arrived.frame.frame;
                 ComPtr<ID3D11Texture2D> surface;
                 auto access = frame.Surface().as<IDirect3DDXGIInterfaceAccess>();
                 winrt::check_hresult(access->GetInterface(winrt::guid_of<ID3D11Texture2D>(),
                                                           reinterpret_cast<void**>(surface.ReleaseAndGetAddressOf())));
 
-                m_lastCapturedFrame = frame;
-                m_lastCapturedSurface = surface;
+                // All the buffers of the frame pool share the same descriptor, only query it once. After the pool is
+                // recreated, frames from the previous buffers may still be delivered.
+                if (!m_isDescValid) {
+                    surface->GetDesc(&m_lastCapturedNativeDesc);
+                    m_isDescValid = static_cast<int32_t>(m_lastCapturedNativeDesc.Width) == m_poolSize.Width &&
+                                    static_cast<int32_t>(m_lastCapturedNativeDesc.Height) == m_poolSize.Height;
+                    m_lastCapturedDesc.width = m_lastCapturedNativeDesc.Width;
+                    m_lastCapturedDesc.height = m_lastCapturedNativeDesc.Height;
+                    m_lastCapturedDesc.format = m_lastCapturedNativeDesc.Format;
+                    m_size = {m_lastCapturedDesc.width, m_lastCapturedDesc.height};
+                }
+
+                const int64_t age = getSystemRelativeTime() - frame.SystemRelativeTime().count();
+                m_lastLatency = std::max<int64_t>(age, 0) * 100;
+
+                // When the system reports dirty regions, only copy those into our own texture. Otherwise, use the
+                // frame as-is.
+                if (frame.try_as<winrt::Windows::Graphics::Capture::IDirect3D11CaptureFrame2>()) {
+                    copyDirtyRegions(arrived, surface.Get());
+
+                    // The frame can go back to the pool immediately.
+                    m_lastCapturedFrame = nullptr;
+                    m_lastCapturedSurface = nullptr;
+                } else {
+                    m_lastCapturedFrame = frame;
+                    m_lastCapturedSurface = surface;
+                }
+                m_sequence++;
+                m_contentSize = frame.ContentSize();
+            }
+
+            // The frames are truncated or padded when the window is resized. Follow the size of the content once the
+            // resize settles, rather than reallocating the buffers on every frame of the resize. Check on every update
+            // rather than on the frames, since a window that stops changing after a resize may not present again.
+            if (m_framePool && m_resizeDebouncer.update(m_contentSize.Width,
+                                                        m_contentSize.Height,
+                                                        m_poolSize.Width,
+                                                        m_poolSize.Height,
+                                                        getSystemRelativeTime() / 1e7)) {
+                m_framePool.Recreate(
+                    m_interopDevice,
+                    static_cast<winrt::Windows::Graphics::DirectX::DirectXPixelFormat>(DXGI_FORMAT_R8G8B8A8_UNORM),
+                    getBufferCount(m_memoryLevel),
+                    m_contentSize);
+                m_poolSize = m_contentSize;
+                m_isDescValid = false;
             }
 
-            return m_lastCapturedSurface.Get();
+            return m_sequence;
+        }
+
+        void* getSurface() const override {
+            return m_lastCapturedSurface ? m_lastCapturedSurface.Get() : m_overlayTexture.Get();
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_lastCapturedDesc;
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return m_size;
+        }
+
+        uint64_t getLatency() const override {
+            return m_lastLatency;
+        }
+
+        void setPaused(bool paused) override {
+            m_paused = paused;
+            updateSession();
         }
 
-        std::pair<int32_t, int32_t> getSize() const {
-            return {m_item.Size().Width, m_item.Size().Height};
+        void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const override {
+            if (level == GpuMemory::Level::Released) {
+                return;
+            }
+            allocations.push_back({GpuMemory::Kind::Capture,
+                                   m_poolSize.Width,
+                                   m_poolSize.Height,
+                                   DXGI_FORMAT_R8G8B8A8_UNORM,
+                                   getBufferCount(level)});
+            if (m_hasOverlayTexture) {
+                allocations.push_back(
+                    {GpuMemory::Kind::Texture, m_poolSize.Width, m_poolSize.Height, DXGI_FORMAT_R8G8B8A8_UNORM});
+            }
+        }
+
+        // The capture API cannot scale the frames. Reduced only lowers the number of buffers, released closes the
+        // frame pool and keeps the item to start over.
+        void setMemoryLevel(GpuMemory::Level level) override {
+            if (level == m_memoryLevel) {
+                return;
+            }
+            const GpuMemory::Level previous = m_memoryLevel;
+            m_memoryLevel = level;
+
+            if (level == GpuMemory::Level::Released) {
+                updateSession();
+                releaseFramePool();
+                m_lastCapturedFrame = nullptr;
+                m_lastCapturedSurface = nullptr;
+                releaseOverlayTexture();
+                m_isDescValid = false;
+            } else if (previous == GpuMemory::Level::Released) {
+                createFramePool();
+                updateSession();
+            } else {
+                m_framePool.Recreate(
+                    m_interopDevice,
+                    static_cast<winrt::Windows::Graphics::DirectX::DirectXPixelFormat>(DXGI_FORMAT_R8G8B8A8_UNORM),
+                    getBufferCount(level),
+                    m_poolSize);
+                m_isDescValid = false;
+            }
         }
 
       private:
-        void initialize(ID3D11Device* device) {
-            ComPtr<IDXGIDevice> dxgiDevice;
-            winrt::check_hresult(device->QueryInterface(IID_PPV_ARGS(dxgiDevice.ReleaseAndGetAddressOf())));
-            ComPtr<IInspectable> object;
-            winrt::check_hresult(CreateDirect3D11DeviceFromDXGIDevice(dxgiDevice.Get(), object.GetAddressOf()));
-            winrt::check_hresult(
-                object->QueryInterface(winrt::guid_of<winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice>(),
-                                       winrt::put_abi(m_interopDevice)));
+        // The frame has no default constructor.
+        struct ArrivedFrame {
+            winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame frame{nullptr};
+        };
+        using FrameHandoff = Capture::FrameHandoff<ArrivedFrame>;
+
+        // The clock of the frame times, based on QueryPerformanceCounter(), in 100ns units.
+        static int64_t getSystemRelativeTime() {
+            LARGE_INTEGER now, frequency;
+            QueryPerformanceCounter(&now);
+            QueryPerformanceFrequency(&frequency);
+            return (now.QuadPart / frequency.QuadPart) * 10'000'000 +
+                   (now.QuadPart % frequency.QuadPart) * 10'000'000 / frequency.QuadPart;
+        }
+
+        // Closing the session stops the capture entirely. The frame pool and the last frame are kept, so that resuming
+        // only needs a new session.
+        void updateSession() {
+            const bool capture = !m_paused && m_memoryLevel != GpuMemory::Level::Released;
+            if (capture == static_cast<bool>(m_session)) {
+                return;
+            }
+
+            if (capture) {
+                startSession();
+            } else {
+                m_session.Close();
+                m_session = nullptr;
+            }
+        }
+
+        // We copy the frames out as soon as we get them, 2 buffers are enough to not stall the capture.
+        uint32_t getBufferCount(GpuMemory::Level level) const {
+            return level == GpuMemory::Level::Reduced ? std::min(m_poolDepth, 2u) : m_poolDepth;
+        }
+
+        void startSession() {
+            m_session = m_framePool.CreateCaptureSession(m_item);
+
+            // Ask for the dirty regions when the system supports it (Windows 11 24H2 and later).
+            if (const auto session = m_session.try_as<winrt::Windows::Graphics::Capture::IGraphicsCaptureSession6>()) {
+                session.DirtyRegionMode(
+                    winrt::Windows::Graphics::Capture::GraphicsCaptureDirtyRegionMode::ReportAndRender);
+            }
+
+            // Frames missed while the session was stopped are not accounted for in the dirty regions.
+            m_forceFullCopy = true;
+            m_session.StartCapture();
+        }
+
+        // The dirty regions include those of the frames that were skipped since the previous one.
+        void copyDirtyRegions(const FrameHandoff::Value& arrived, ID3D11Texture2D* surface) {
+            bool fullCopy = m_forceFullCopy || arrived.fullCopy;
+            m_forceFullCopy = false;
+
+            D3D11_TEXTURE2D_DESC overlayDesc{};
+            if (m_overlayTexture) {
+                m_overlayTexture->GetDesc(&overlayDesc);
+            }
+            m_hasOverlayTexture = true;
+            if (!m_overlayTexture || overlayDesc.Width != m_lastCapturedNativeDesc.Width ||
+                overlayDesc.Height != m_lastCapturedNativeDesc.Height ||
+                overlayDesc.Format != m_lastCapturedNativeDesc.Format) {
+                releaseOverlayTexture();
+
+                // Reuse a texture released by another overlay or before a resize when possible.
+                overlayDesc = m_lastCapturedNativeDesc;
+                m_overlayTexture = m_texturePool->acquire(getTextureKey(overlayDesc));
+                if (!m_overlayTexture) {
+                    overlayDesc.Usage = D3D11_USAGE_DEFAULT;
+                    overlayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+                    overlayDesc.CPUAccessFlags = 0;
+                    overlayDesc.MiscFlags = 0;
+                    winrt::check_hresult(
+                        m_device->CreateTexture2D(&overlayDesc, nullptr, m_overlayTexture.ReleaseAndGetAddressOf()));
+                }
+                fullCopy = true;
+            }
+
+            if (!fullCopy) {
+                const auto& plan = m_tileMerger.plan(
+                    overlayDesc.Width, overlayDesc.Height, arrived.dirtyRects.data(), arrived.dirtyRects.size());
+                fullCopy = plan.fullCopy;
+                if (!fullCopy) {
+                    for (const auto& rect : plan.rects) {
+                        D3D11_BOX box{static_cast<UINT>(rect.x),
+                                      static_cast<UINT>(rect.y),
+                                      0,
+                                      static_cast<UINT>(rect.x + rect.width),
+                                      static_cast<UINT>(rect.y + rect.height),
+                                      1};
+                        m_context->CopySubresourceRegion(
+                            m_overlayTexture.Get(), 0, box.left, box.top, 0, surface, 0, &box);
+                    }
+                }
+            }
+
+            if (fullCopy) {
+                m_context->CopyResource(m_overlayTexture.Get(), surface);
+            }
+        }
+
+        void releaseOverlayTexture() {
+            if (m_overlayTexture) {
+                D3D11_TEXTURE2D_DESC desc;
+                m_overlayTexture->GetDesc(&desc);
+                m_texturePool->release(getTextureKey(desc), std::move(m_overlayTexture));
+            }
+        }
+
+        static Capture::TextureKey getTextureKey(const D3D11_TEXTURE2D_DESC& desc) {
+            return {static_cast<int32_t>(desc.Width), static_cast<int32_t>(desc.Height), desc.Format};
+        }
+
+        void initialize(ID3D11Device* device,
+                        const winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice& interopDevice) {
+            m_device = device;
+            m_device->GetImmediateContext(m_context.ReleaseAndGetAddressOf());
+            m_interopDevice = interopDevice;
+
+            m_poolSize = m_item.Size();
+            m_contentSize = m_poolSize;
+            m_size = {m_poolSize.Width, m_poolSize.Height};
+            createFramePool();
+            startSession();
+        }
 
+        void createFramePool() {
             m_framePool = winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool::CreateFreeThreaded(
                 m_interopDevice,
                 static_cast<winrt::Windows::Graphics::DirectX::DirectXPixelFormat>(DXGI_FORMAT_R8G8B8A8_UNORM),
-                2,
-                m_item.Size());
-            m_session = m_framePool.CreateCaptureSession(m_item);
-            m_session.StartCapture();
+                getBufferCount(m_memoryLevel),
+                m_poolSize);
+
+            // The free-threaded pool delivers the frames on a system thread, as soon as they are captured. When the
+            // render thread is waiting for a frame, drain the pool there, so that it gets the newest frame without
+            // waiting for its next poll. The handler only owns the handoff, since it may still run while we are
+            // destroyed.
+            m_frameArrived = m_framePool.FrameArrived(
+                winrt::auto_revoke,
+                [frameHandoff = m_frameHandoff](
+                    const winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool& framePool,
+                    const winrt::Windows::Foundation::IInspectable&) {
+                    if (frameHandoff->isWanted()) {
+                        drainFramePool(*frameHandoff, framePool);
+                    }
+                });
+        }
+
+        // Publishes the newest frame of the pool, with the dirty regions of all the frames before it. The other frames
+        // go back to the pool right away.
+        static void drainFramePool(FrameHandoff& frameHandoff,
+                                   const winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool& framePool) {
+            if (!frameHandoff.beginProduce()) {
+                return;
+            }
+            std::vector<DirtyRects::Rect> dirtyRects;
+            while (auto frame = framePool.TryGetNextFrame()) {
+                dirtyRects.clear();
+                const auto frameWithDirtyRegions =
+                    frame.try_as<winrt::Windows::Graphics::Capture::IDirect3D11CaptureFrame2>();
+                if (frameWithDirtyRegions) {
+                    for (const auto& region : frameWithDirtyRegions.DirtyRegions()) {
+                        dirtyRects.push_back({region.X, region.Y, region.Width, region.Height});
+                    }
+                }
+                frameHandoff.add({std::move(frame)},
+                                 dirtyRects.data(),
+                                 dirtyRects.size(),
+                                 static_cast<bool>(frameWithDirtyRegions));
+            }
+            frameHandoff.endProduce();
         }
 
+        void releaseFramePool() {
+            if (!m_framePool) {
+                return;
+            }
+            m_frameArrived.revoke();
+            m_framePool.Close();
+            m_framePool = nullptr;
+
+            // A late handler may still publish to the previous handoff, use a new one.
+            FrameHandoff::Value arrived;
+            m_frameHandoff->take(arrived);
+            m_frameHandoff = std::make_shared<FrameHandoff>();
+        }
+
+        const std::shared_ptr<TexturePool> m_texturePool;
+        const uint32_t m_poolDepth;
+        ComPtr<ID3D11Device> m_device;
+        ComPtr<ID3D11DeviceContext> m_context;
         winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice m_interopDevice;
         winrt::Windows::Graphics::Capture::GraphicsCaptureItem m_item{nullptr};
         winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool m_framePool{nullptr};
+        std::shared_ptr<FrameHandoff> m_frameHandoff = std::make_shared<FrameHandoff>();
+        winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool::FrameArrived_revoker m_frameArrived;
         winrt::Windows::Graphics::Capture::GraphicsCaptureSession m_session{nullptr};
-        mutable winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame m_lastCapturedFrame{nullptr};
-        mutable ComPtr<ID3D11Texture2D> m_lastCapturedSurface;
+        winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame m_lastCapturedFrame{nullptr};
+        ComPtr<ID3D11Texture2D> m_lastCapturedSurface;
+        D3D11_TEXTURE2D_DESC m_lastCapturedNativeDesc{};
+        bool m_isDescValid = false;
+        Capture::SurfaceDesc m_lastCapturedDesc;
+        std::pair<int32_t, int32_t> m_size;
+        winrt::Windows::Graphics::SizeInt32 m_poolSize{};
+        // Of the most recent frame.
+        winrt::Windows::Graphics::SizeInt32 m_contentSize{};
+        Capture::ResizeDebouncer m_resizeDebouncer;
+
+        // Persistent texture updated from the dirty regions of each frame.
+        ComPtr<ID3D11Texture2D> m_overlayTexture;
+        bool m_hasOverlayTexture = false;
+        DirtyRects::TileMerger m_tileMerger;
+        bool m_forceFullCopy = true;
+        uint64_t m_sequence = 0;
+        uint64_t m_lastLatency = 0;
+        bool m_paused = false;
+        GpuMemory::Level m_memoryLevel = GpuMemory::Level::Full;
     };
 
-    struct SKOverlay {
-        struct Window {
-            HWND window = nullptr;
-            HMONITOR monitor = nullptr;
-            std::string title;
-            std::shared_ptr<CaptureWindow> captureWindow;
-            ComPtr<ID3D11Texture2D> sharedTexture;
-            tex_t texture = nullptr;
-            material_t material = nullptr;
-            pose_t pose = {};
-            float scale = 0.75f;
-            bool32_t decorate = true;
-            bool32_t minimized = false;
-            bool cleanup = false;
+#ifndef PW_RENDERFULLCONTENT
+#define PW_RENDERFULLCONTENT 0x00000002
+#endif
+
+    // Fallback capture through GDI, for the windows that the capture API refuses (some elevated or legacy windows).
+    // The window is grabbed and converted on a background thread, then uploaded to a texture.
+    class GdiCaptureWindow : public Capture::ICaptureSource {
+      public:
+        GdiCaptureWindow(ID3D11Device* device, std::shared_ptr<TexturePool> texturePool, HWND window)
+            : m_texturePool(std::move(texturePool)), m_window(window) {
+            m_device = device;
+            m_device->GetImmediateContext(m_context.ReleaseAndGetAddressOf());
+
+            m_dc = CreateCompatibleDC(nullptr);
+            if (!m_dc) {
+                throw std::runtime_error("CreateCompatibleDC() failed");
+            }
+
+            // Report the windows that cannot be captured at all to the caller.
+            if (!grab(false)) {
+                releaseGdiObjects();
+                throw std::runtime_error("PrintWindow() failed");
+            }
+
+            m_thread = std::thread([this] { threadMain(); });
+        }
+
+        ~GdiCaptureWindow() override {
+            {
+                std::unique_lock lock(m_mutex);
+                m_stop = true;
+            }
+            m_wakeUp.notify_all();
+            m_thread.join();
+
+            releaseGdiObjects();
+
+            if (m_texture) {
+                m_texturePool->release(m_textureKey, std::move(m_texture));
+            }
+        }
+
+        uint64_t update() override {
+            {
+                std::unique_lock lock(m_mutex);
+                if (m_ready.sequence <= m_front.sequence || m_memoryLevel == GpuMemory::Level::Released) {
+                    return m_front.sequence;
+                }
+                std::swap(m_ready, m_front);
+            }
+            m_size = {m_front.width * m_front.scale, m_front.height * m_front.scale};
+
+            // Upload outside of the lock, the grabbing thread only needs the other buffers.
+            const Capture::TextureKey key{m_front.width, m_front.height, DXGI_FORMAT_R8G8B8A8_UNORM};
+            if (!m_texture || !(m_textureKey == key)) {
+                if (m_texture) {
+                    m_texturePool->release(m_textureKey, std::move(m_texture));
+                }
+                m_textureKey = key;
+                m_texture = m_texturePool->acquire(key);
+                if (!m_texture) {
+                    D3D11_TEXTURE2D_DESC desc{};
+                    desc.Width = key.width;
+                    desc.Height = key.height;
+                    desc.MipLevels = 1;
+                    desc.ArraySize = 1;
+                    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+                    desc.SampleDesc.Count = 1;
+                    desc.Usage = D3D11_USAGE_DEFAULT;
+                    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+                    winrt::check_hresult(m_device->CreateTexture2D(&desc, nullptr, m_texture.ReleaseAndGetAddressOf()));
+                }
+                m_desc = {key.width, key.height, DXGI_FORMAT_R8G8B8A8_UNORM};
+            }
+            m_context->UpdateSubresource(m_texture.Get(), 0, nullptr, m_front.pixels.data(), m_front.width * 4, 0);
+            m_lastLatency = Instrumentation::now() - m_front.time;
+
+            return m_front.sequence;
+        }
+
+        void* getSurface() const override {
+            return m_texture.Get();
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_desc;
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return m_size;
+        }
+
+        uint64_t getLatency() const override {
+            return m_lastLatency;
+        }
+
+        void setPaused(bool paused) override {
+            {
+                std::unique_lock lock(m_mutex);
+                m_paused = paused;
+            }
+            m_wakeUp.notify_all();
+        }
+
+        void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const override {
+            if (level == GpuMemory::Level::Released || !m_size.first || !m_size.second) {
+                return;
+            }
+            const int32_t scale = getScale(m_size.first, level == GpuMemory::Level::Reduced);
+            allocations.push_back(
+                {GpuMemory::Kind::Texture, m_size.first / scale, m_size.second / scale, DXGI_FORMAT_R8G8B8A8_UNORM});
+        }
+
+        void setMemoryLevel(GpuMemory::Level level) override {
+            {
+                std::unique_lock lock(m_mutex);
+                m_memoryLevel = level;
+            }
+            if (level == GpuMemory::Level::Released && m_texture) {
+                m_texturePool->release(m_textureKey, std::move(m_texture));
+            }
+        }
+
+      private:
+        struct Buffer {
+            std::vector<uint8_t> pixels;
+            int32_t width = 0;
+            int32_t height = 0;
+            int32_t scale = 1; // Size of the window over the size of the buffer.
+            uint64_t sequence = 0;
+            uint64_t time = 0;
         };
 
-        struct AvailableWindow {
-            HWND window = nullptr;
-            HMONITOR monitor = nullptr;
-            std::string title;
-            bool32_t mirrored = false;
-            bool32_t wasMirrored = false;
+        // Grabbing through GDI is expensive, limit the rate.
+        static constexpr std::chrono::milliseconds Interval{66};
+        // Larger windows are halved before the upload.
+        static constexpr int32_t MaxWidth = 2560;
+
+        // Downscaling of a window, for the width limit then for the memory level.
+        static int32_t getScale(int32_t width, bool isReduced) {
+            return (width > MaxWidth ? 2 : 1) * (isReduced ? 2 : 1);
+        }
+
+        void threadMain() {
+            std::unique_lock lock(m_mutex);
+            while (!m_stop) {
+                m_wakeUp.wait_for(lock, Interval, [&] { return m_stop; });
+                if (m_stop || m_paused || m_memoryLevel == GpuMemory::Level::Released) {
+                    continue;
+                }
+
+                const bool isReduced = m_memoryLevel == GpuMemory::Level::Reduced;
+                lock.unlock();
+                grab(isReduced);
+                lock.lock();
+            }
+        }
+
+        bool grab(bool isReduced) {
+            RECT rect;
+            if (!GetClientRect(m_window, &rect) || rect.right <= 0 || rect.bottom <= 0) {
+                return false;
+            }
+            const int32_t width = rect.right;
+            const int32_t height = rect.bottom;
+
+            if (width != m_bitmapWidth || height != m_bitmapHeight) {
+                releaseBitmap();
+                BITMAPINFO info{};
+                info.bmiHeader.biSize = sizeof(info.bmiHeader);
+                info.bmiHeader.biWidth = width;
+                info.bmiHeader.biHeight = -height; // Top-down.
+                info.bmiHeader.biPlanes = 1;
+                info.bmiHeader.biBitCount = 32;
+                info.bmiHeader.biCompression = BI_RGB;
+                m_bitmap = CreateDIBSection(m_dc, &info, DIB_RGB_COLORS, reinterpret_cast<void**>(&m_bits), nullptr, 0);
+                if (!m_bitmap) {
+                    m_bitmapWidth = m_bitmapHeight = 0;
+                    return false;
+                }
+                m_defaultBitmap = SelectObject(m_dc, m_bitmap);
+                m_bitmapWidth = width;
+                m_bitmapHeight = height;
+            }
+
+            if (!PrintWindow(m_window, m_dc, PW_CLIENTONLY | PW_RENDERFULLCONTENT)) {
+                return false;
+            }
+            GdiFlush();
+
+            // GDI produces BGRA with an undefined alpha.
+            const auto& kernels = PixelKernels::getKernels();
+            m_back.scale = getScale(width, isReduced);
+            m_back.width = width / m_back.scale;
+            m_back.height = height / m_back.scale;
+            m_back.pixels.resize(static_cast<size_t>(m_back.width) * m_back.height * 4);
+            if (m_back.scale == 4) {
+                m_half.resize(static_cast<size_t>(width / 2) * (height / 2) * 4);
+                kernels.downscale2x(m_bits, width * 4, width, height, m_half.data(), (width / 2) * 4);
+                kernels.downscale2x(
+                    m_half.data(), (width / 2) * 4, width / 2, height / 2, m_back.pixels.data(), m_back.width * 4);
+                kernels.swizzle(m_back.pixels.data(), m_back.pixels.data(), m_back.pixels.size() / 4);
+            } else if (m_back.scale == 2) {
+                kernels.downscale2x(m_bits, width * 4, width, height, m_back.pixels.data(), m_back.width * 4);
+                kernels.swizzle(m_back.pixels.data(), m_back.pixels.data(), m_back.pixels.size() / 4);
+            } else {
+                kernels.swizzle(m_bits, m_back.pixels.data(), m_back.pixels.size() / 4);
+            }
+            kernels.fixAlpha(m_back.pixels.data(), m_back.pixels.size() / 4);
+            m_back.time = Instrumentation::now();
+
+            std::unique_lock lock(m_mutex);
+            m_back.sequence = ++m_sequence;
+            std::swap(m_back, m_ready);
+            return true;
+        }
+
+        void releaseBitmap() {
+            if (m_bitmap) {
+                // A bitmap cannot be deleted while selected.
+                SelectObject(m_dc, m_defaultBitmap);
+                DeleteObject(m_bitmap);
+                m_bitmap = nullptr;
+            }
+        }
+
+        void releaseGdiObjects() {
+            releaseBitmap();
+            DeleteDC(m_dc);
+        }
+
+        const std::shared_ptr<TexturePool> m_texturePool;
+        const HWND m_window;
+        ComPtr<ID3D11Device> m_device;
+        ComPtr<ID3D11DeviceContext> m_context;
+
+        // Only accessed by the grabbing thread (or the constructor).
+        HDC m_dc = nullptr;
+        HBITMAP m_bitmap = nullptr;
+        HGDIOBJ m_defaultBitmap = nullptr;
+        uint8_t* m_bits = nullptr;
+        int32_t m_bitmapWidth = 0;
+        int32_t m_bitmapHeight = 0;
+        // Half of the window, when halved twice.
+        std::vector<uint8_t> m_half;
+        Buffer m_back;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        Buffer m_ready;
+        uint64_t m_sequence = 0;
+        bool m_paused = false;
+        GpuMemory::Level m_memoryLevel = GpuMemory::Level::Full;
+        bool m_stop = false;
+
+        // Only accessed by the render thread.
+        Buffer m_front;
+        ComPtr<ID3D11Texture2D> m_texture;
+        Capture::TextureKey m_textureKey;
+        Capture::SurfaceDesc m_desc;
+        std::pair<int32_t, int32_t> m_size;
+        uint64_t m_lastLatency = 0;
+
+        std::thread m_thread;
+    };
+
+    // An overlay texture from the pool, or a new one.
+    ComPtr<ID3D11Texture2D> acquireTexture(ID3D11Device* device,
+                                           TexturePool& texturePool,
+                                           const Capture::TextureKey& key) {
+        ComPtr<ID3D11Texture2D> texture = texturePool.acquire(key);
+        if (!texture) {
+            D3D11_TEXTURE2D_DESC desc{};
+            desc.Width = key.width;
+            desc.Height = key.height;
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = static_cast<DXGI_FORMAT>(key.format);
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            winrt::check_hresult(device->CreateTexture2D(&desc, nullptr, texture.ReleaseAndGetAddressOf()));
+        }
+        return texture;
+    }
+
+    // Upload a region of a frame in system memory.
+    void uploadRect(ID3D11DeviceContext* context,
+                    ID3D11Texture2D* texture,
+                    const uint8_t* pixels,
+                    uint32_t pitch,
+                    const DirtyRects::Rect& rect) {
+        if (!rect.area()) {
+            return;
+        }
+        const D3D11_BOX box{static_cast<UINT>(rect.x),
+                            static_cast<UINT>(rect.y),
+                            0,
+                            static_cast<UINT>(rect.x + rect.width),
+                            static_cast<UINT>(rect.y + rect.height),
+                            1};
+        context->UpdateSubresource(
+            texture, 0, &box, pixels + rect.y * static_cast<size_t>(pitch) + rect.x * 4, pitch, 0);
+    }
+
+    // A texture from the pool updated from frames in system memory, at half their resolution when reduced.
+    class UploadTexture {
+      public:
+        UploadTexture(ID3D11Device* device, std::shared_ptr<TexturePool> texturePool)
+            : m_texturePool(std::move(texturePool)) {
+            m_device = device;
+            m_device->GetImmediateContext(m_context.ReleaseAndGetAddressOf());
+        }
+
+        ~UploadTexture() {
+            release();
+        }
+
+        // Upload the region of the frame that changed, or the whole frame when the texture had to change.
+        void upload(uint32_t width,
+                    uint32_t height,
+                    DXGI_FORMAT format,
+                    const uint8_t* pixels,
+                    uint32_t pitch,
+                    const DirtyRects::Rect& dirty,
+                    bool fullUpload,
+                    bool isReduced) {
+            const int32_t scale = isReduced && width >= 2 && height >= 2 ? 2 : 1;
+            const Capture::TextureKey key{
+                static_cast<int32_t>(width) / scale, static_cast<int32_t>(height) / scale, format};
+            if (!m_texture || !(m_textureKey == key)) {
+                release();
+                m_textureKey = key;
+                m_texture = acquireTexture(m_device.Get(), *m_texturePool, key);
+                m_desc = {key.width, key.height, format};
+                fullUpload = true;
+            }
+
+            const DirtyRects::Rect rect =
+                fullUpload ? DirtyRects::Rect{0, 0, static_cast<int32_t>(width), static_cast<int32_t>(height)} : dirty;
+            if (scale == 1) {
+                uploadRect(m_context.Get(), m_texture.Get(), pixels, pitch, rect);
+                return;
+            }
+
+            // Extend the region to whole blocks of 2x2 pixels.
+            const int32_t left = rect.x & ~1;
+            const int32_t top = rect.y & ~1;
+            const int32_t right = std::min((rect.x + rect.width + 1) & ~1, key.width * 2);
+            const int32_t bottom = std::min((rect.y + rect.height + 1) & ~1, key.height * 2);
+            if (right <= left || bottom <= top) {
+                return;
+            }
+            const DirtyRects::Rect downscaled{left / 2, top / 2, (right - left) / 2, (bottom - top) / 2};
+            m_downscaled.resize(static_cast<size_t>(downscaled.area()) * 4);
+            PixelKernels::getKernels().downscale2x(pixels + top * static_cast<size_t>(pitch) + left * 4,
+                                                   pitch,
+                                                   right - left,
+                                                   bottom - top,
+                                                   m_downscaled.data(),
+                                                   downscaled.width * 4);
+            const D3D11_BOX box{static_cast<UINT>(downscaled.x),
+                                static_cast<UINT>(downscaled.y),
+                                0,
+                                static_cast<UINT>(downscaled.x + downscaled.width),
+                                static_cast<UINT>(downscaled.y + downscaled.height),
+                                1};
+            m_context->UpdateSubresource(m_texture.Get(), 0, &box, m_downscaled.data(), downscaled.width * 4, 0);
+        }
+
+        void release() {
+            if (m_texture) {
+                m_texturePool->release(m_textureKey, std::move(m_texture));
+            }
+        }
+
+        ID3D11Texture2D* get() const {
+            return m_texture.Get();
+        }
+
+        const Capture::SurfaceDesc& getDesc() const {
+            return m_desc;
+        }
+
+      private:
+        const std::shared_ptr<TexturePool> m_texturePool;
+        ComPtr<ID3D11Device> m_device;
+        ComPtr<ID3D11DeviceContext> m_context;
+
+        ComPtr<ID3D11Texture2D> m_texture;
+        Capture::TextureKey m_textureKey;
+        Capture::SurfaceDesc m_desc;
+        std::vector<uint8_t> m_downscaled;
+    };
+
+    // The texture of a source uploading frames from system memory, at a memory level.
+    void getUploadAllocations(GpuMemory::Level level,
+                              const std::pair<int32_t, int32_t>& size,
+                              int64_t format,
+                              std::vector<GpuMemory::Allocation>& allocations) {
+        if (level == GpuMemory::Level::Released || !size.first || !size.second) {
+            return;
+        }
+        const int32_t scale = level == GpuMemory::Level::Reduced && size.first >= 2 && size.second >= 2 ? 2 : 1;
+        allocations.push_back({GpuMemory::Kind::Texture, size.first / scale, size.second / scale, format});
+    }
+
+    // Frames published by another process through shared memory (see frame_ring.h). The pixels are uploaded straight
+    // from the shared memory, and only the region that changed when no frame was missed.
+    class StreamCaptureSource : public Capture::ICaptureSource {
+      public:
+        StreamCaptureSource(ID3D11Device* device, std::shared_ptr<TexturePool> texturePool, const std::string& name)
+            : m_consumer(name), m_texture(device, std::move(texturePool)) {
+        }
+
+        uint64_t update() override {
+            FrameRing::Frame frame;
+            if (m_paused || m_memoryLevel == GpuMemory::Level::Released || !m_consumer.acquire(m_lastSequence, frame)) {
+                return m_sequence;
+            }
+
+            const DXGI_FORMAT format = frame.format == FrameRing::PixelFormat::B8G8R8A8 ? DXGI_FORMAT_B8G8R8A8_UNORM
+                                                                                         : DXGI_FORMAT_R8G8B8A8_UNORM;
+            if (!frame.width || !frame.height) {
+                return m_sequence;
+            }
+
+            // The dirty region is relative to the previous frame only.
+            const bool fullUpload = m_forceFullUpload || frame.sequence != m_lastSequence + 1;
+            m_texture.upload(frame.width,
+                             frame.height,
+                             format,
+                             frame.pixels,
+                             frame.pitch,
+                             frame.dirty,
+                             fullUpload,
+                             m_memoryLevel == GpuMemory::Level::Reduced);
+            m_size = {static_cast<int32_t>(frame.width), static_cast<int32_t>(frame.height)};
+
+            // The producer lapped us during the upload, the next frame must be uploaded entirely.
+            if (!m_consumer.validate(frame)) {
+                m_forceFullUpload = true;
+                return m_sequence;
+            }
+            m_forceFullUpload = false;
+            m_lastSequence = frame.sequence;
+            m_lastLatency = Instrumentation::now() - std::min(frame.timestamp, Instrumentation::now());
+
+            return ++m_sequence;
+        }
+
+        void* getSurface() const override {
+            return m_texture.get();
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_texture.getDesc();
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return m_size;
+        }
+
+        uint64_t getLatency() const override {
+            return m_lastLatency;
+        }
+
+        void setPaused(bool paused) override {
+            m_paused = paused;
+        }
+
+        void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const override {
+            getUploadAllocations(level, m_size, m_texture.getDesc().format, allocations);
+        }
+
+        void setMemoryLevel(GpuMemory::Level level) override {
+            m_memoryLevel = level;
+            if (level == GpuMemory::Level::Released) {
+                m_texture.release();
+                m_forceFullUpload = true;
+            }
+        }
+
+      private:
+        FrameRing::Consumer m_consumer;
+        UploadTexture m_texture;
+        std::pair<int32_t, int32_t> m_size;
+        GpuMemory::Level m_memoryLevel = GpuMemory::Level::Full;
+        uint64_t m_lastSequence = 0;
+        bool m_forceFullUpload = true;
+        bool m_paused = false;
+        uint64_t m_sequence = 0;
+        uint64_t m_lastLatency = 0;
+    };
+
+    // Plays a recording back, like a captured window.
+    class ReplayCaptureSource : public Capture::ICaptureSource {
+      public:
+        ReplayCaptureSource(ID3D11Device* device,
+                            std::shared_ptr<TexturePool> texturePool,
+                            const std::string& path,
+                            bool isRealTime)
+            : m_player(path, isRealTime), m_texture(device, std::move(texturePool)) {
+        }
+
+        uint64_t update() override {
+            const bool isReleased = m_memoryLevel == GpuMemory::Level::Released;
+            const Recording::Frame* frame = m_paused || isReleased ? nullptr : m_player.update(Instrumentation::now());
+            if (!frame || !frame->width || !frame->height) {
+                return m_sequence;
+            }
+
+            // The dirty region is relative to the previous frame only, which we did not see while paused.
+            const bool fullUpload = m_wasPaused;
+            m_wasPaused = false;
+            m_texture.upload(frame->width,
+                             frame->height,
+                             static_cast<DXGI_FORMAT>(frame->format),
+                             frame->pixels,
+                             frame->pitch,
+                             frame->dirty,
+                             fullUpload,
+                             m_memoryLevel == GpuMemory::Level::Reduced);
+            m_size = {static_cast<int32_t>(frame->width), static_cast<int32_t>(frame->height)};
+
+            return ++m_sequence;
+        }
+
+        void* getSurface() const override {
+            return m_texture.get();
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_texture.getDesc();
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return m_size;
+        }
+
+        uint64_t getLatency() const override {
+            return 0;
+        }
+
+        void setPaused(bool paused) override {
+            m_paused = paused;
+            m_wasPaused = m_wasPaused || paused;
+        }
+
+        void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const override {
+            getUploadAllocations(level, m_size, m_texture.getDesc().format, allocations);
+        }
+
+        void setMemoryLevel(GpuMemory::Level level) override {
+            m_memoryLevel = level;
+            if (level == GpuMemory::Level::Released) {
+                m_texture.release();
+                m_wasPaused = true;
+            }
+        }
+
+      private:
+        Recording::Player m_player;
+        UploadTexture m_texture;
+        std::pair<int32_t, int32_t> m_size;
+        GpuMemory::Level m_memoryLevel = GpuMemory::Level::Full;
+        bool m_paused = false;
+        bool m_wasPaused = false;
+        uint64_t m_sequence = 0;
+    };
+
+    // Records the frames of another source. The frames are read back one update late, so that we do not wait for the
+    // copy.
+    class RecordingCaptureSource : public Capture::ICaptureSource {
+      public:
+        RecordingCaptureSource(ID3D11Device* device,
+                               std::shared_ptr<Capture::ICaptureSource> source,
+                               const std::string& path)
+            : m_source(std::move(source)), m_recorder(path) {
+            m_device = device;
+            m_device->GetImmediateContext(m_context.ReleaseAndGetAddressOf());
+        }
+
+        ~RecordingCaptureSource() {
+            // Nothing is timed anymore, wait for the last frames.
+            writeFrames(true);
+        }
+
+        uint64_t update() override {
+            const uint64_t sequence = m_source->update();
+
+            // Write the frames that the GPU is done copying, without ever waiting for it.
+            writeFrames(false);
+
+            ID3D11Texture2D* surface = reinterpret_cast<ID3D11Texture2D*>(m_source->getSurface());
+            if (sequence != m_lastSequence && surface) {
+                m_lastSequence = sequence;
+
+                // Drop the frame rather than stall when the GPU is that far behind.
+                Staging& staging = m_staging[m_writeIndex];
+                if (staging.isPending) {
+                    return sequence;
+                }
+
+                D3D11_TEXTURE2D_DESC desc;
+                surface->GetDesc(&desc);
+                if (!staging.texture || desc.Width != staging.desc.Width || desc.Height != staging.desc.Height ||
+                    desc.Format != staging.desc.Format) {
+                    staging.desc = {};
+                    staging.desc.Width = desc.Width;
+                    staging.desc.Height = desc.Height;
+                    staging.desc.MipLevels = 1;
+                    staging.desc.ArraySize = 1;
+                    staging.desc.Format = desc.Format;
+                    staging.desc.SampleDesc.Count = 1;
+                    staging.desc.Usage = D3D11_USAGE_STAGING;
+                    staging.desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+                    winrt::check_hresult(
+                        m_device->CreateTexture2D(&staging.desc, nullptr, staging.texture.ReleaseAndGetAddressOf()));
+                }
+                m_context->CopyResource(staging.texture.Get(), surface);
+                staging.timestamp = Instrumentation::now();
+                staging.isPending = true;
+                m_writeIndex = (m_writeIndex + 1) % StagingCount;
+            }
+
+            return sequence;
+        }
+
+        void* getSurface() const override {
+            return m_source->getSurface();
+        }
+
+        const Capture::SurfaceDesc& getDesc() const override {
+            return m_source->getDesc();
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return m_source->getSize();
+        }
+
+        uint64_t getLatency() const override {
+            return m_source->getLatency();
+        }
+
+        void setPaused(bool paused) override {
+            m_source->setPaused(paused);
+        }
+
+        void getAllocations(GpuMemory::Level level, std::vector<GpuMemory::Allocation>& allocations) const override {
+            m_source->getAllocations(level, allocations);
+            if (level == GpuMemory::Level::Released) {
+                return;
+            }
+            for (const Staging& staging : m_staging) {
+                if (staging.texture) {
+                    allocations.push_back({GpuMemory::Kind::Staging,
+                                           static_cast<int32_t>(staging.desc.Width),
+                                           static_cast<int32_t>(staging.desc.Height),
+                                           staging.desc.Format});
+                }
+            }
+        }
+
+        void setMemoryLevel(GpuMemory::Level level) override {
+            m_source->setMemoryLevel(level);
+            if (level == GpuMemory::Level::Released) {
+                for (Staging& staging : m_staging) {
+                    staging = {};
+                }
+                m_readIndex = m_writeIndex = 0;
+            }
+        }
+
+      private:
+        // Frames copied but not written yet. Enough for the GPU to run a couple of frames behind.
+        static constexpr size_t StagingCount = 3;
+
+        struct Staging {
+            ComPtr<ID3D11Texture2D> texture;
+            D3D11_TEXTURE2D_DESC desc{};
+            uint64_t timestamp = 0;
+            bool isPending = false;
         };
 
-        SKOverlay() {
-            ComPtr<ID3D11DeviceContext> context;
-            render_get_device(reinterpret_cast<void**>(m_device.GetAddressOf()),
-                              reinterpret_cast<void**>(context.GetAddressOf()));
+        // Write the pending frames in order, up to the first one still being copied, unless we may wait.
+        void writeFrames(bool wait) {
+            while (m_staging[m_readIndex].isPending) {
+                Staging& staging = m_staging[m_readIndex];
+                D3D11_MAPPED_SUBRESOURCE mapped;
+                const HRESULT result = m_context->Map(
+                    staging.texture.Get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+                if (result == DXGI_ERROR_WAS_STILL_DRAWING) {
+                    return;
+                }
+                if (SUCCEEDED(result)) {
+                    m_recorder.addFrame(staging.timestamp,
+                                        staging.desc.Width,
+                                        staging.desc.Height,
+                                        mapped.RowPitch,
+                                        staging.desc.Format,
+                                        static_cast<const uint8_t*>(mapped.pData));
+                    m_context->Unmap(staging.texture.Get(), 0);
+                }
+                staging.isPending = false;
+                m_readIndex = (m_readIndex + 1) % StagingCount;
+            }
+        }
 
-            m_quadMesh = mesh_find(default_id_mesh_quad);
+        const std::shared_ptr<Capture::ICaptureSource> m_source;
+        Recording::Recorder m_recorder;
+        ComPtr<ID3D11Device> m_device;
+        ComPtr<ID3D11DeviceContext> m_context;
+
+        Staging m_staging[StagingCount];
+        size_t m_readIndex = 0;
+        size_t m_writeIndex = 0;
+        uint64_t m_lastSequence = 0;
+    };
+
+    // Window events from the Win32 accessibility hooks.
+    class Win32WindowEventSource : public WindowList::IWindowEventSource {
+      public:
+        ~Win32WindowEventSource() override {
+            stop();
+        }
+
+        void start(std::function<void(const WindowList::Event&)> sink) override {
+            m_sink = std::move(sink);
+
+            // WinEvent hooks are delivered through the message loop of the thread that installed them.
+            std::promise<void> ready;
+            m_thread = std::thread([this, &ready] {
+                // Make sure the message queue exists before stop() can post to it.
+                MSG msg;
+                PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+                ready.set_value();
+
+                s_instance = this;
+                HWINEVENTHOOK lifetimeHook = SetWinEventHook(EVENT_OBJECT_CREATE,
+                                                             EVENT_OBJECT_HIDE,
+                                                             nullptr,
+                                                             winEventProc,
+                                                             0,
+                                                             0,
+                                                             WINEVENT_OUTOFCONTEXT);
+                HWINEVENTHOOK nameHook = SetWinEventHook(EVENT_OBJECT_NAMECHANGE,
+                                                         EVENT_OBJECT_NAMECHANGE,
+                                                         nullptr,
+                                                         winEventProc,
+                                                         0,
+                                                         0,
+                                                         WINEVENT_OUTOFCONTEXT);
+
+                while (GetMessage(&msg, nullptr, 0, 0) > 0) {
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+
+                UnhookWinEvent(nameHook);
+                UnhookWinEvent(lifetimeHook);
+                s_instance = nullptr;
+            });
+            m_threadId = GetThreadId(m_thread.native_handle());
+            ready.get_future().wait();
+        }
+
+        void stop() override {
+            if (m_thread.joinable()) {
+                PostThreadMessage(m_threadId, WM_QUIT, 0, 0);
+                m_thread.join();
+            }
+        }
+
+        void enumerate(std::vector<WindowList::WindowInfo>& windows) override {
+            EnumWindows(
+                [](HWND hwnd, LPARAM lParam) {
+                    auto windows = reinterpret_cast<std::vector<WindowList::WindowInfo>*>(lParam);
+
+                    auto info = queryWindow(hwnd);
+                    if (info) {
+                        windows->push_back(std::move(info.value()));
+                    }
+
+                    return TRUE;
+                },
+                reinterpret_cast<LPARAM>(&windows));
+        }
 
-            initializeAvailableMonitors();
+        std::optional<WindowList::WindowInfo> query(WindowList::Handle handle) override {
+            return queryWindow(reinterpret_cast<HWND>(handle));
         }
 
-        void initializeAvailableMonitors() {
-            m_availableMonitors.clear();
+        bool isAlive(WindowList::Handle handle) override {
+            return IsWindow(reinterpret_cast<HWND>(handle));
+        }
 
+        void enumerateMonitors(std::vector<WindowList::WindowInfo>& monitors) override {
             EnumDisplayMonitors(
                 nullptr,
                 nullptr,
                 [](HMONITOR monitor, HDC hdc, LPRECT rect, LPARAM lParam) {
-                    SKOverlay* overlay = reinterpret_cast<SKOverlay*>(lParam);
+                    auto monitors = reinterpret_cast<std::vector<WindowList::WindowInfo>*>(lParam);
 
                     MONITORINFOEX monitorInfo{};
                     monitorInfo.cbSize = sizeof(monitorInfo);
                     if (GetMonitorInfo(monitor, &monitorInfo)) {
-                        AvailableWindow availableMonitor;
-                        availableMonitor.monitor = monitor;
-                        availableMonitor.title = "Monitor ";
-                        availableMonitor.title += std::string(monitorInfo.szDevice);
-                        overlay->m_availableMonitors.push_back(std::move(availableMonitor));
+                        monitors->push_back({monitor, "Monitor " + std::string(monitorInfo.szDevice)});
                     }
 
                     return TRUE;
                 },
-                reinterpret_cast<LPARAM>(this));
-        }
-
-        void refreshAvailableWindows(bool forceRefresh) {
-            static int countdown = 0;
-            if (forceRefresh || --countdown <= 0) {
-                m_availableWindows.clear();
-
-                EnumWindows(
-                    [](HWND hwnd, LPARAM lParam) {
-                        SKOverlay* overlay = reinterpret_cast<SKOverlay*>(lParam);
-
-                        if (hwnd == nullptr)
-                            return TRUE;
-                        if (hwnd == GetShellWindow())
-                            return TRUE;
-                        if (!IsWindowVisible(hwnd))
-                            return TRUE;
-                        if (GetAncestor(hwnd, GA_ROOT) != hwnd)
-                            return TRUE;
-
-                        LONG_PTR style = GetWindowLongPtr(hwnd, GWL_STYLE);
-                        if (style & WS_DISABLED)
-                            return TRUE;
-
-                        char text[256];
-                        GetWindowText(hwnd, text, sizeof(text));
-                        if (strcmp(text, "") == 0)
-                            return TRUE;
-
-                        AvailableWindow availableWindow;
-                        availableWindow.window = hwnd;
-                        availableWindow.title = text;
-                        for (const auto& window : overlay->m_windows) {
-                            if (window.window == hwnd) {
-                                availableWindow.mirrored = availableWindow.wasMirrored = true;
-                                break;
-                            }
-                        }
-                        // Open the windows that matched filters.
-                        for (const auto& filter : overlay->m_filters) {
-                            if (std::regex_search(availableWindow.title, filter)) {
-                                availableWindow.mirrored = true;
-                            }
-                        }
-                        overlay->m_availableWindows.push_back(std::move(availableWindow));
-
-                        return TRUE;
-                    },
-                    reinterpret_cast<LPARAM>(this));
-
-                countdown = 500;
-            }
-        }
-
-        void handleAvailableWindowsList(std::vector<AvailableWindow>& availableWindows) {
-            for (auto& availableWindow : availableWindows) {
-                // Draw the toggles.
-                ui_toggle(availableWindow.title.c_str(), availableWindow.mirrored);
-
-                // Detect toggling a window on/off.
-                if (availableWindow.mirrored != availableWindow.wasMirrored) {
-                    auto it = m_windows.begin();
-                    for (; it != m_windows.end(); it++) {
-                        if (it->window && it->window == availableWindow.window) {
-                            break;
-                        }
-                        if (it->monitor && it->monitor == availableWindow.monitor) {
-                            break;
-                        }
-                    }
+                reinterpret_cast<LPARAM>(&monitors));
+        }
 
-                    if (availableWindow.mirrored && it == m_windows.end()) {
-                        Window newWindow = {};
-                        newWindow.window = availableWindow.window;
-                        newWindow.monitor = availableWindow.monitor;
-                        newWindow.title = availableWindow.title;
-                        newWindow.pose =
-                            pose_t{{0, 0, -0.5f + 0.001f * (rand() % 20)}, quat_lookat(vec3_zero, {0, 0, 1})};
-                        m_windows.push_back(newWindow);
-                    } else if (!availableWindow.mirrored && it != m_windows.end()) {
-                        material_release(it->material);
-                        tex_release(it->texture);
-                        m_windows.erase(it);
-                    }
-                }
-                availableWindow.wasMirrored = availableWindow.mirrored;
+        void enumerateStreams(std::vector<WindowList::WindowInfo>& streams) override {
+            m_streamDirectory.list(m_streams);
+            for (const auto& stream : m_streams) {
+                streams.push_back({reinterpret_cast<WindowList::Handle>(stream.id), stream.title});
+            }
+            for (size_t i = 0; i < m_replays.size(); i++) {
+                streams.push_back({reinterpret_cast<WindowList::Handle>(ReplayHandleBit | i),
+                                   "Replay: " + std::filesystem::path(m_replays[i]).filename().string()});
+            }
+        }
+
+        void setReplays(const std::vector<std::string>& paths) {
+            m_replays = paths;
+        }
+
+      private:
+        static std::optional<WindowList::WindowInfo> queryWindow(HWND hwnd) {
+            if (hwnd == nullptr)
+                return {};
+            if (hwnd == GetShellWindow())
+                return {};
+            if (!IsWindowVisible(hwnd))
+                return {};
+            if (GetAncestor(hwnd, GA_ROOT) != hwnd)
+                return {};
+
+            LONG_PTR style = GetWindowLongPtr(hwnd, GWL_STYLE);
+            if (style & WS_DISABLED)
+                return {};
+
+            char text[256];
+            GetWindowText(hwnd, text, sizeof(text));
+            if (strcmp(text, "") == 0)
+                return {};
+
+            DWORD processId = 0;
+            GetWindowThreadProcessId(hwnd, &processId);
+            return WindowList::WindowInfo{hwnd, text, getProcessName(processId)};
+        }
+
+        static std::string getProcessName(DWORD processId) {
+            const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId);
+            if (!process) {
+                return {};
+            }
+            char path[MAX_PATH];
+            DWORD size = sizeof(path);
+            const bool success = QueryFullProcessImageNameA(process, 0, path, &size);
+            CloseHandle(process);
+            if (!success) {
+                return {};
             }
+            const std::string fullPath(path, size);
+            return fullPath.substr(fullPath.find_last_of('\\') + 1);
         }
 
-        void ensureWindowResources(Window& window) {
-            if (window.window && !IsWindow(window.window)) {
-                window.cleanup = true;
+        static void CALLBACK winEventProc(HWINEVENTHOOK hook,
+                                          DWORD event,
+                                          HWND hwnd,
+                                          LONG idObject,
+                                          LONG idChild,
+                                          DWORD idEventThread,
+                                          DWORD dwmsEventTime) {
+            // Only consider the windows themselves, not their content.
+            if (!s_instance || !hwnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF) {
                 return;
             }
 
-            if (!window.texture) {
-                try {
-                    if (window.window) {
-                        window.captureWindow = std::make_shared<CaptureWindow>(m_device.Get(), window.window);
-                    } else {
-                        window.captureWindow = std::make_shared<CaptureWindow>(m_device.Get(), window.monitor);
-                    }
-                } catch (...) {
-                    log_warn("Failed to open window capture");
-                }
-                window.material = material_copy_id(default_id_material_unlit);
-                window.texture = tex_create();
-                tex_set_address(window.texture, tex_address_clamp);
-                material_set_texture(window.material, "diffuse", window.texture);
+            WindowList::EventType type;
+            switch (event) {
+            case EVENT_OBJECT_CREATE:
+            case EVENT_OBJECT_SHOW:
+                type = WindowList::EventType::Created;
+                break;
+            case EVENT_OBJECT_DESTROY:
+            case EVENT_OBJECT_HIDE:
+                type = WindowList::EventType::Destroyed;
+                break;
+            case EVENT_OBJECT_NAMECHANGE:
+                type = WindowList::EventType::NameChanged;
+                break;
+            default:
+                return;
             }
-        }
 
-        void drawWindows() {
-            auto it = m_windows.begin();
-            while (it != m_windows.end()) {
-                auto& window = *it;
+            s_instance->m_sink({type, hwnd});
+        }
 
-                ensureWindowResources(window);
-                if (window.cleanup) {
-                    material_release(it->material);
-                    tex_release(it->texture);
-                    it = m_windows.erase(it);
-                    continue;
-                }
+        static inline Win32WindowEventSource* s_instance = nullptr;
 
-                // Draw the window.
-                ui_window_begin(window.title.c_str(),
-                                window.pose,
-                                vec2_zero,
-                                window.decorate ? ui_win_head : ui_win_empty,
-                                sk::ui_move_exact);
-
-                if (!window.minimized) {
-                    std::pair<int32_t, int32_t> size;
-                    if (window.captureWindow) {
-                        window.sharedTexture = window.captureWindow->getSurface();
-                        if (window.sharedTexture) {
-                            D3D11_TEXTURE2D_DESC desc{};
-                            window.sharedTexture->GetDesc(&desc);
-
-                            tex_set_surface(window.texture,
-                                            window.sharedTexture.Get(),
-                                            tex_type_image_nomips,
-                                            desc.Format,
-                                            0,
-                                            0,
-                                            1);
-                        }
-                        size = window.captureWindow->getSize();
-                    }
+        std::function<void(const WindowList::Event&)> m_sink;
+        std::thread m_thread;
+        DWORD m_threadId = 0;
 
-                    vec2 scaledSize =
-                        vec2{window.captureWindow ? (float)size.first : (float)tex_get_width(window.texture),
-                             window.captureWindow ? (float)size.second : (float)tex_get_height(window.texture)} *
-                        0.0004f * window.scale;
-                    ui_layout_reserve(scaledSize);
+        FrameRing::Directory m_streamDirectory;
+        std::vector<FrameRing::Stream> m_streams;
+        std::vector<std::string> m_replays;
+    };
 
-                    render_add_mesh(
-                        m_quadMesh,
-                        window.material,
-                        matrix_trs(vec3{0, -scaledSize.y / 2, 0}, quat_identity, vec3{scaledSize.x, scaledSize.y, 1}));
+    // Creates the WinRT capture of windows and monitors, and the consumers of the streams. All captures share the same
+    // interop device.
+    class Win32CaptureFactory : public Capture::ICaptureSourceFactory {
+      public:
+        explicit Win32CaptureFactory(ID3D11Device* device) : m_device(device) {
+            ComPtr<IDXGIDevice> dxgiDevice;
+            winrt::check_hresult(device->QueryInterface(IID_PPV_ARGS(dxgiDevice.ReleaseAndGetAddressOf())));
+            ComPtr<IInspectable> object;
+            winrt::check_hresult(CreateDirect3D11DeviceFromDXGIDevice(dxgiDevice.Get(), object.GetAddressOf()));
+            winrt::check_hresult(
+                object->QueryInterface(winrt::guid_of<winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice>(),
+                                       winrt::put_abi(m_interopDevice)));
+        }
 
-                    if (ui_button("+")) {
-                        window.scale *= 1.1f;
-                    }
-                    ui_sameline();
-                    if (ui_button("-")) {
-                        window.scale *= 0.9f;
-                    }
-                    ui_sameline();
+        std::shared_ptr<Capture::ICaptureSource> createForWindow(void* window) override {
+            return create([&]() -> std::shared_ptr<Capture::ICaptureSource> {
+                try {
+                    return std::make_shared<CaptureWindow>(m_device.Get(),
+                                                           m_interopDevice,
+                                                           m_texturePool,
+                                                           m_framePoolDepth,
+                                                           reinterpret_cast<HWND>(window));
+                } catch (const winrt::hresult_error&) {
+                    // Some elevated or legacy windows cannot be captured by the capture API.
+                    return std::make_shared<GdiCaptureWindow>(
+                        m_device.Get(), m_texturePool, reinterpret_cast<HWND>(window));
                 }
+            });
+        }
+
+        std::shared_ptr<Capture::ICaptureSource> createForMonitor(void* monitor) override {
+            return create([&] {
+                return std::make_shared<CaptureWindow>(m_device.Get(),
+                                                       m_interopDevice,
+                                                       m_texturePool,
+                                                       m_framePoolDepth,
+                                                       reinterpret_cast<HMONITOR>(monitor));
+            });
+        }
 
-                if (ui_button(window.decorate ? "Hide title" : "Show title")) {
-                    window.decorate = !window.decorate;
+        std::shared_ptr<Capture::ICaptureSource> createForStream(void* stream) override {
+            return create([&]() -> std::shared_ptr<Capture::ICaptureSource> {
+                const uint64_t id = reinterpret_cast<uint64_t>(stream);
+                if (id & ReplayHandleBit) {
+                    return std::make_shared<ReplayCaptureSource>(
+                        m_device.Get(), m_texturePool, m_replays.at(id & ~ReplayHandleBit), m_isReplayRealTime);
                 }
-                ui_sameline();
 
-                if (ui_button(window.minimized ? "Show" : "Minimize")) {
-                    window.minimized = !window.minimized;
+                std::vector<FrameRing::Stream> streams;
+                m_streamDirectory.list(streams);
+                for (const auto& entry : streams) {
+                    if (entry.id == id) {
+                        return std::make_shared<StreamCaptureSource>(m_device.Get(), m_texturePool, entry.name);
+                    }
                 }
+                throw std::runtime_error("The stream is no longer available");
+            });
+        }
 
-                ui_window_end();
+        // Number of buffers of the frame pools. With 3, the system can capture into a buffer while a frame waits to be
+        // taken and another one is shown.
+        void setFramePoolDepth(uint32_t depth) {
+            m_framePoolDepth = std::max(depth, 2u);
+        }
 
-                it++;
-            }
+        // Record the frames of every capture source created from now on, to a file per source.
+        void setRecordingDirectory(const std::string& directory) {
+            m_recordingDirectory = directory;
         }
 
-        void step(void) {
-            ui_window_begin("Window Selection", m_menuPose, vec2{0, 0}, sk::ui_win_normal, sk::ui_move_exact);
+        // Same order as given to Win32WindowEventSource::setReplays().
+        void setReplays(const std::vector<std::string>& paths, bool isRealTime) {
+            m_replays = paths;
+            m_isReplayRealTime = isRealTime;
+        }
 
-            bool wasMinimized = m_minimized;
-            if (ui_button(m_minimized ? "Open" : "Close")) {
-                m_minimized = !m_minimized;
+      private:
+        template <typename Function>
+        std::shared_ptr<Capture::ICaptureSource> create(Function&& function) {
+            // We are called from worker threads, which must join the multi-threaded apartment to use WinRT.
+            thread_local const HRESULT apartment = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+            (void)apartment;
+
+            // Report WinRT errors as standard exceptions to the caller.
+            std::shared_ptr<Capture::ICaptureSource> source;
+            try {
+                source = function();
+            } catch (const winrt::hresult_error& error) {
+                throw std::runtime_error(winrt::to_string(error.message()));
             }
-            ui_sameline();
-            if (ui_button(m_handsVisible ? "Hide hands" : "Show hands")) {
-                m_handsVisible = !m_handsVisible;
-                input_hand_visible(sk::handed_left, m_handsVisible);
-                input_hand_visible(sk::handed_right, m_handsVisible);
+
+            if (!m_recordingDirectory.empty()) {
+                const std::filesystem::path path = std::filesystem::path(m_recordingDirectory) /
+                                                   ("overlay-" + std::to_string(m_nextRecording++) + ".skrec");
+                source = std::make_shared<RecordingCaptureSource>(m_device.Get(), std::move(source), path.string());
             }
+            return source;
+        }
 
-            refreshAvailableWindows(!m_minimized && wasMinimized);
+        ComPtr<ID3D11Device> m_device;
+        winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice m_interopDevice;
+
+        // Overlay textures released by closed or resized overlays, shared by all the capture sources.
+        const std::shared_ptr<TexturePool> m_texturePool = std::make_shared<TexturePool>();
+
+        const FrameRing::Directory m_streamDirectory;
+
+        uint32_t m_framePoolDepth = 3;
+        std::string m_recordingDirectory;
+        std::atomic<uint32_t> m_nextRecording{0};
+        std::vector<std::string> m_replays;
+        bool m_isReplayRealTime = true;
+    };
+
+    class StereoKitTexture : public Overlay::ITexture {
+      public:
+        StereoKitTexture() {
+            m_material = material_copy_id(default_id_material_unlit);
+            m_texture = tex_create();
+            tex_set_address(m_texture, tex_address_clamp);
+            material_set_texture(m_material, "diffuse", m_texture);
+        }
 
-            if (!m_minimized) {
-                ui_hseparator();
-                handleAvailableWindowsList(m_availableMonitors);
-                ui_hseparator();
-                handleAvailableWindowsList(m_availableWindows);
+        ~StereoKitTexture() override {
+            material_release(m_material);
+            tex_release(m_texture);
+        }
+
+        void setSurface(void* surface, int64_t format) override {
+            tex_set_surface(m_texture, surface, tex_type_image_nomips, format, 0, 0, 1);
+        }
+
+        std::pair<int32_t, int32_t> getSize() const override {
+            return {tex_get_width(m_texture), tex_get_height(m_texture)};
+        }
+
+        material_t getMaterial() const {
+            return m_material;
+        }
+
+      private:
+        tex_t m_texture = nullptr;
+        material_t m_material = nullptr;
+    };
+
+    // The small overlays are copied into the page, and drawn as a single mesh with quads mapping their region.
+    class StereoKitAtlasPage : public Overlay::IAtlasPage {
+      public:
+        StereoKitAtlasPage(ID3D11Device* device, mesh_t quadMesh, int32_t width, int32_t height, int64_t format)
+            : m_width(width), m_height(height) {
+            device->GetImmediateContext(m_context.ReleaseAndGetAddressOf());
+
+            D3D11_TEXTURE2D_DESC desc{};
+            desc.Width = width;
+            desc.Height = height;
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = static_cast<DXGI_FORMAT>(format);
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            winrt::check_hresult(device->CreateTexture2D(&desc, nullptr, m_surface.ReleaseAndGetAddressOf()));
+
+            m_texture = tex_create();
+            tex_set_address(m_texture, tex_address_clamp);
+            tex_set_surface(m_texture, m_surface.Get(), tex_type_image_nomips, format, width, height, 1);
+            m_material = material_copy_id(default_id_material_unlit);
+            material_set_texture(m_material, "diffuse", m_texture);
+            m_mesh = mesh_create();
+
+            // Same geometry as the quads drawn by drawQuad().
+            vert_t* vertices = nullptr;
+            int32_t vertexCount = 0;
+            mesh_get_verts(quadMesh, vertices, vertexCount, memory_reference);
+            m_quadVertices.assign(vertices, vertices + vertexCount);
+            vind_t* indices = nullptr;
+            int32_t indexCount = 0;
+            mesh_get_inds(quadMesh, indices, indexCount, memory_reference);
+            m_quadIndices.assign(indices, indices + indexCount);
+        }
+
+        ~StereoKitAtlasPage() override {
+            mesh_release(m_mesh);
+            material_release(m_material);
+            tex_release(m_texture);
+        }
+
+        void copySurface(void* surface, const Atlas::Rect& rect) override {
+            const D3D11_BOX box{0, 0, 0, static_cast<UINT>(rect.width), static_cast<UINT>(rect.height), 1};
+            m_context->CopySubresourceRegion(
+                m_surface.Get(), 0, rect.x, rect.y, 0, reinterpret_cast<ID3D11Texture2D*>(surface), 0, &box);
+        }
+
+        void addQuad(const Atlas::Rect& rect, const Overlay::Vec3& position, const Overlay::Vec2& size) override {
+            // The mesh is drawn outside of the UI windows, bake their transform into the vertices.
+            const matrix world = *hierarchy_to_world();
+            const vind_t base = static_cast<vind_t>(m_vertices.size());
+            for (const vert_t& quadVertex : m_quadVertices) {
+                vert_t vertex = quadVertex;
+                vertex.pos = matrix_transform_pt(world,
+                                                 vec3{position.x + quadVertex.pos.x * size.x,
+                                                      position.y + quadVertex.pos.y * size.y,
+                                                      position.z + quadVertex.pos.z});
+                vertex.norm = matrix_transform_dir(world, quadVertex.norm);
+                vertex.uv = vec2{(rect.x + quadVertex.uv.x * rect.width) / m_width,
+                                 (rect.y + quadVertex.uv.y * rect.height) / m_height};
+                m_vertices.push_back(vertex);
             }
+            for (const vind_t index : m_quadIndices) {
+                m_indices.push_back(base + index);
+            }
+        }
 
-            ui_window_end();
+        void draw() override {
+            if (m_indices.empty()) {
+                return;
+            }
+            mesh_set_verts(m_mesh, m_vertices.data(), static_cast<int32_t>(m_vertices.size()), true);
+            mesh_set_inds(m_mesh, m_indices.data(), static_cast<int32_t>(m_indices.size()));
+            render_add_mesh(m_mesh, m_material, matrix_identity);
+            m_vertices.clear();
+            m_indices.clear();
+        }
 
-            drawWindows();
+      private:
+        const float m_width;
+        const float m_height;
+
+        ComPtr<ID3D11DeviceContext> m_context;
+        ComPtr<ID3D11Texture2D> m_surface;
+        tex_t m_texture = nullptr;
+        material_t m_material = nullptr;
+        mesh_t m_mesh = nullptr;
+
+        std::vector<vert_t> m_quadVertices;
+        std::vector<vind_t> m_quadIndices;
+        std::vector<vert_t> m_vertices;
+        std::vector<vind_t> m_indices;
+    };
+
+    // Downsamples the frames with the mipmaps of a copy, then reads a small level back through a staging texture. The
+    // staging texture is only mapped once the GPU is done with it.
+    class ThumbnailReader : public Overlay::IThumbnailReader {
+      public:
+        explicit ThumbnailReader(ID3D11Device* device) {
+            m_device = device;
+            m_device->GetImmediateContext(m_context.ReleaseAndGetAddressOf());
         }
 
-        void run() {
-            sk_run_data(
-                [](void* opaque) {
-                    SKOverlay* overlay = reinterpret_cast<SKOverlay*>(opaque);
-                    overlay->step();
-                },
-                this,
-                nullptr,
-                this);
+        void request(void* surface) override {
+            ID3D11Texture2D* texture = reinterpret_cast<ID3D11Texture2D*>(surface);
+            D3D11_TEXTURE2D_DESC desc;
+            texture->GetDesc(&desc);
+            if (!m_copy || desc.Width != m_copyDesc.Width || desc.Height != m_copyDesc.Height ||
+                desc.Format != m_copyDesc.Format) {
+                createTextures(desc);
+            }
+
+            const D3D11_BOX box{0, 0, 0, desc.Width, desc.Height, 1};
+            m_context->CopySubresourceRegion(m_copy.Get(), 0, 0, 0, 0, texture, 0, &box);
+            m_context->GenerateMips(m_copyView.Get());
+            m_context->CopySubresourceRegion(m_staging.Get(), 0, 0, 0, 0, m_copy.Get(), m_level, nullptr);
+            m_pending = true;
         }
 
-        void addFilter(const std::string& expression) {
-            if (expression.empty()) {
+        bool read(Overlay::Thumbnail& thumbnail) override {
+            if (!m_pending) {
+                return false;
+            }
+
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (FAILED(m_context->Map(m_staging.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped))) {
+                return false;
+            }
+            thumbnail.width = m_stagingDesc.Width;
+            thumbnail.height = m_stagingDesc.Height;
+            thumbnail.pixels.resize(static_cast<size_t>(thumbnail.width) * thumbnail.height * 4);
+            for (int32_t y = 0; y < thumbnail.height; y++) {
+                memcpy(&thumbnail.pixels[static_cast<size_t>(y) * thumbnail.width * 4],
+                       static_cast<const uint8_t*>(mapped.pData) + static_cast<size_t>(y) * mapped.RowPitch,
+                       static_cast<size_t>(thumbnail.width) * 4);
+            }
+            m_context->Unmap(m_staging.Get(), 0);
+            m_pending = false;
+            return true;
+        }
+
+        void getAllocations(std::vector<GpuMemory::Allocation>& allocations) const override {
+            if (!m_copy) {
                 return;
             }
-            m_filters.push_back(std::regex(expression, std::regex_constants::ECMAScript | std::regex_constants::icase));
+            for (UINT level = 0; level < m_copyDesc.MipLevels; level++) {
+                allocations.push_back({GpuMemory::Kind::Texture,
+                                       static_cast<int32_t>(std::max(m_copyDesc.Width >> level, 1u)),
+                                       static_cast<int32_t>(std::max(m_copyDesc.Height >> level, 1u)),
+                                       m_copyDesc.Format});
+            }
+            allocations.push_back({GpuMemory::Kind::Staging,
+                                   static_cast<int32_t>(m_stagingDesc.Width),
+                                   static_cast<int32_t>(m_stagingDesc.Height),
+                                   m_stagingDesc.Format});
         }
 
-        bool m_minimized = false;
-        pose_t m_menuPose = pose_t{{0.35f, 0, -0.35f}, quat_lookat({0.35f, 0, -0.35f}, {0, 0, 0})};
+      private:
+        // Largest dimension of the thumbnails.
+        static constexpr UINT MaxSize = 128;
+
+        void createTextures(const D3D11_TEXTURE2D_DESC& surfaceDesc) {
+            D3D11_TEXTURE2D_DESC desc{};
+            desc.Width = surfaceDesc.Width;
+            desc.Height = surfaceDesc.Height;
+            desc.MipLevels = 0; // The full chain.
+            desc.ArraySize = 1;
+            desc.Format = surfaceDesc.Format;
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+            desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+            winrt::check_hresult(m_device->CreateTexture2D(&desc, nullptr, m_copy.ReleaseAndGetAddressOf()));
+            winrt::check_hresult(
+                m_device->CreateShaderResourceView(m_copy.Get(), nullptr, m_copyView.ReleaseAndGetAddressOf()));
+            m_copy->GetDesc(&m_copyDesc);
+
+            // The first level that fits.
+            m_level = 0;
+            while ((std::max(m_copyDesc.Width, m_copyDesc.Height) >> m_level) > MaxSize &&
+                   m_level + 1 < m_copyDesc.MipLevels) {
+                m_level++;
+            }
+
+            m_stagingDesc = {};
+            m_stagingDesc.Width = std::max(m_copyDesc.Width >> m_level, 1u);
+            m_stagingDesc.Height = std::max(m_copyDesc.Height >> m_level, 1u);
+            m_stagingDesc.MipLevels = 1;
+            m_stagingDesc.ArraySize = 1;
+            m_stagingDesc.Format = m_copyDesc.Format;
+            m_stagingDesc.SampleDesc.Count = 1;
+            m_stagingDesc.Usage = D3D11_USAGE_STAGING;
+            m_stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            winrt::check_hresult(
+                m_device->CreateTexture2D(&m_stagingDesc, nullptr, m_staging.ReleaseAndGetAddressOf()));
+            m_pending = false;
+        }
 
-        mesh_t m_quadMesh;
         ComPtr<ID3D11Device> m_device;
+        ComPtr<ID3D11DeviceContext> m_context;
+
+        ComPtr<ID3D11Texture2D> m_copy;
+        ComPtr<ID3D11ShaderResourceView> m_copyView;
+        D3D11_TEXTURE2D_DESC m_copyDesc{};
+        UINT m_level = 0;
+        ComPtr<ID3D11Texture2D> m_staging;
+        D3D11_TEXTURE2D_DESC m_stagingDesc{};
+        bool m_pending = false;
+    };
 
-        bool m_handsVisible = true;
+    class StereoKitRenderer : public Overlay::IRenderer {
+      public:
+        StereoKitRenderer() {
+            m_quadMesh = mesh_find(default_id_mesh_quad);
+
+            vert_t* vertices = nullptr;
+            int32_t vertexCount = 0;
+            mesh_get_verts(m_quadMesh, vertices, vertexCount, memory_reference);
+            m_quadVertices.assign(vertices, vertices + vertexCount);
+            vind_t* indices = nullptr;
+            int32_t indexCount = 0;
+            mesh_get_inds(m_quadMesh, indices, indexCount, memory_reference);
+            m_quadIndices.assign(indices, indices + indexCount);
+
+            ComPtr<ID3D11DeviceContext> context;
+            render_get_device(reinterpret_cast<void**>(m_device.GetAddressOf()),
+                              reinterpret_cast<void**>(context.GetAddressOf()));
+        }
 
-        std::vector<Window> m_windows;
-        std::vector<AvailableWindow> m_availableMonitors;
-        std::vector<AvailableWindow> m_availableWindows;
+        ~StereoKitRenderer() override {
+            for (const mesh_t mesh : m_cropMeshes) {
+                mesh_release(mesh);
+            }
+            mesh_release(m_quadMesh);
+        }
+
+        Overlay::Pose getHeadPose() override {
+            return toOverlay(*input_head());
+        }
+
+        void getPointers(std::vector<Overlay::Ray>& pointers) override {
+            const int32_t count = input_pointer_count(input_source_hand);
+            for (int32_t i = 0; i < count; i++) {
+                const pointer_t pointer = input_pointer(i, input_source_hand);
+                if (pointer.tracked & button_state_active) {
+                    pointers.push_back({{pointer.ray.pos.x, pointer.ray.pos.y, pointer.ray.pos.z},
+                                        {pointer.ray.dir.x, pointer.ray.dir.y, pointer.ray.dir.z}});
+                }
+            }
+        }
 
-        std::vector<std::regex> m_filters;
+        double getTime() override {
+            return time_get();
+        }
+
+        void logWarning(const char* message) override {
+            log_warn(message);
+        }
+
+        std::unique_ptr<Overlay::ITexture> createTexture() override {
+            return std::make_unique<StereoKitTexture>();
+        }
+
+        void drawQuad(const Overlay::ITexture& texture,
+                      const Overlay::Vec3& position,
+                      const Overlay::Vec2& size,
+                      const Overlay::UvRect& uv) override {
+            const bool isCropped = uv.x != 0 || uv.y != 0 || uv.width != 1 || uv.height != 1;
+            render_add_mesh(
+                isCropped ? getCropMesh(uv) : m_quadMesh,
+                static_cast<const StereoKitTexture&>(texture).getMaterial(),
+                matrix_trs(vec3{position.x, position.y, position.z}, quat_identity, vec3{size.x, size.y, 1}));
+        }
+
+        std::unique_ptr<Overlay::IAtlasPage> createAtlasPage(int32_t width, int32_t height, int64_t format) override {
+            return std::make_unique<StereoKitAtlasPage>(m_device.Get(), m_quadMesh, width, height, format);
+        }
+
+        std::unique_ptr<Overlay::IThumbnailReader> createThumbnailReader() override {
+            return std::make_unique<ThumbnailReader>(m_device.Get());
+        }
+
+        void windowBegin(const char* title, Overlay::Pose& pose, Overlay::WindowStyle style) override {
+            ui_win_ type = ui_win_normal;
+            switch (style) {
+            case Overlay::WindowStyle::Normal:
+                type = ui_win_normal;
+                break;
+            case Overlay::WindowStyle::Head:
+                type = ui_win_head;
+                break;
+            case Overlay::WindowStyle::Empty:
+                type = ui_win_empty;
+                break;
+            }
+            ui_window_begin(title, toStereoKit(pose), vec2_zero, type, sk::ui_move_exact);
+        }
+
+        void windowEnd() override {
+            ui_window_end();
+        }
+
+        void layoutReserve(const Overlay::Vec2& size) override {
+            ui_layout_reserve(vec2{size.x, size.y});
+        }
+
+        bool button(const char* text) override {
+            return ui_button(text);
+        }
+
+        bool toggle(const char* text, bool& value) override {
+            bool32_t toggled = value;
+            const bool changed = ui_toggle(text, toggled);
+            value = toggled;
+            return changed;
+        }
+
+        bool hslider(const char* text, float& value, float min, float max) override {
+            ui_label(text);
+            ui_sameline();
+            return ui_hslider(text, value, min, max, 0, 0.15f);
+        }
+
+        void label(const char* text) override {
+            ui_label(text);
+        }
+
+        void sameLine() override {
+            ui_sameline();
+        }
+
+        void separator() override {
+            ui_hseparator();
+        }
+
+        void setHandsVisible(bool visible) override {
+            input_hand_visible(sk::handed_left, visible);
+            input_hand_visible(sk::handed_right, visible);
+        }
+
+      private:
+        static_assert(sizeof(Overlay::Pose) == sizeof(pose_t), "Pose layout mismatch");
+
+        static Overlay::Pose toOverlay(const pose_t& pose) {
+            return reinterpret_cast<const Overlay::Pose&>(pose);
+        }
+
+        static pose_t& toStereoKit(Overlay::Pose& pose) {
+            return reinterpret_cast<pose_t&>(pose);
+        }
+
+        // A quad mapping a region of the texture. The meshes are only drawn at the end of the frame, so each crop drawn
+        // during a frame needs its own mesh. The time only changes between frames.
+        mesh_t getCropMesh(const Overlay::UvRect& uv) {
+            const double now = time_get();
+            if (now != m_cropMeshTime) {
+                m_cropMeshTime = now;
+                m_usedCropMeshes = 0;
+            }
+            if (m_usedCropMeshes == m_cropMeshes.size()) {
+                const mesh_t mesh = mesh_create();
+                mesh_set_inds(mesh, m_quadIndices.data(), static_cast<int32_t>(m_quadIndices.size()));
+                m_cropMeshes.push_back(mesh);
+            }
+            const mesh_t mesh = m_cropMeshes[m_usedCropMeshes++];
+
+            m_cropVertices = m_quadVertices;
+            for (vert_t& vertex : m_cropVertices) {
+                vertex.uv = vec2{uv.x + vertex.uv.x * uv.width, uv.y + vertex.uv.y * uv.height};
+            }
+            mesh_set_verts(mesh, m_cropVertices.data(), static_cast<int32_t>(m_cropVertices.size()), true);
+            return mesh;
+        }
+
+        mesh_t m_quadMesh;
+        ComPtr<ID3D11Device> m_device;
+
+        std::vector<vert_t> m_quadVertices;
+        std::vector<vind_t> m_quadIndices;
+        std::vector<vert_t> m_cropVertices;
+        std::vector<mesh_t> m_cropMeshes;
+        size_t m_usedCropMeshes = 0;
+        double m_cropMeshTime = -1;
     };
 
 } // namespace
@@ -474,11 +1988,87 @@ int main(int argc, char** argv) {
     // Disable skybox to ensure a transparent background.
     render_enable_skytex(false);
 
-    SKOverlay overlay;
+    ComPtr<ID3D11Device> device;
+    ComPtr<ID3D11DeviceContext> context;
+    render_get_device(reinterpret_cast<void**>(device.GetAddressOf()),
+                      reinterpret_cast<void**>(context.GetAddressOf()));
+
+    const auto windowSource = std::make_shared<Win32WindowEventSource>();
+    const auto captureFactory = std::make_shared<Win32CaptureFactory>(device.Get());
+    // The overlay holds StereoKit assets, it must be destroyed before StereoKit shuts down.
+    auto overlay =
+        std::make_unique<Overlay::SKOverlay>(windowSource, captureFactory, std::make_shared<StereoKitRenderer>());
+    std::string layoutPath = "SKOverlayLayout.bin";
+    std::string layoutProfile = "default";
+    std::vector<std::string> replays;
+    bool isReplayRealTime = true;
     for (int i = 1; i < argc; i++) {
-        overlay.addFilter(argv[i]);
+        if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            overlay->startTrace(argv[++i]);
+            continue;
+        }
+        if (!strcmp(argv[i], "--layout") && i + 1 < argc) {
+            layoutPath = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+            layoutProfile = argv[++i];
+            continue;
+        }
+        if (!strcmp(argv[i], "--atlas")) {
+            overlay->setAtlasEnabled(true);
+            continue;
+        }
+        if (!strcmp(argv[i], "--capture-buffers") && i + 1 < argc) {
+            captureFactory->setFramePoolDepth(static_cast<uint32_t>(atoi(argv[++i])));
+            continue;
+        }
+        if (!strcmp(argv[i], "--capture-budget") && i + 1 < argc) {
+            CaptureScheduler::Config config;
+            if (CaptureScheduler::parseBudget(argv[++i], config)) {
+                overlay->setCaptureBudget(config);
+            } else {
+                log_warnf("Invalid capture budget %s, expected for example 500Mpx or 120fps", argv[i]);
+            }
+            continue;
+        }
+        if (!strcmp(argv[i], "--memory-cap") && i + 1 < argc) {
+            overlay->setMemoryBudget({static_cast<uint64_t>(atoll(argv[++i])) << 20});
+            continue;
+        }
+        if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            std::filesystem::create_directories(argv[++i]);
+            captureFactory->setRecordingDirectory(argv[i]);
+            continue;
+        }
+        if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            replays.push_back(argv[++i]);
+            continue;
+        }
+        if (!strcmp(argv[i], "--replay-fast")) {
+            isReplayRealTime = false;
+            continue;
+        }
+        overlay->addFilter(argv[i]);
     }
-    overlay.run();
+    windowSource->setReplays(replays);
+    captureFactory->setReplays(replays, isReplayRealTime);
+    overlay->restoreLayout(layoutPath, layoutProfile);
+    sk_run_data(
+        [](void* opaque) {
+            Overlay::SKOverlay* overlay = reinterpret_cast<Overlay::SKOverlay*>(opaque);
+            overlay->setBudget(g_framePacing.getBudget());
+            overlay->step();
+        },
+        overlay.get(),
+        [](void* opaque) {
+            // Called right before sk_shutdown().
+            auto& overlay = *reinterpret_cast<std::unique_ptr<Overlay::SKOverlay>*>(opaque);
+            overlay->saveLayout();
+            overlay->writeTrace();
+            overlay.reset();
+        },
+        &overlay);
 
     return 0;
 }
@@ -0,0 +1,1117 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Largely inspired from sample code at
+// https://github.com/StereoKit/StereoKit/blob/master/Examples/StereoKitCTest/demo_windows.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "overlay.h"
+
+namespace {
+
+    // Overlays up to that size are drawn from the atlas, when enabled.
+    constexpr int32_t MaxAtlasSurfaceSize = 512;
+    constexpr int32_t AtlasPageSize = 2048;
+    constexpr size_t MaxAtlasPages = 4;
+
+    // Frames of the overlay between two searches for the borders to trim.
+    constexpr uint64_t TrimInterval = 15;
+
+    // Keep the crop within the capture, and large enough to grab.
+    Overlay::UvRect clampCrop(const Overlay::UvRect& crop) {
+        constexpr float MinimumSize = 0.05f;
+        Overlay::UvRect clamped;
+        clamped.width = std::clamp(crop.width, MinimumSize, 1.f);
+        clamped.height = std::clamp(crop.height, MinimumSize, 1.f);
+        clamped.x = std::clamp(crop.x, 0.f, 1 - clamped.width);
+        clamped.y = std::clamp(crop.y, 0.f, 1 - clamped.height);
+        return clamped;
+    }
+
+    // The part of the crop within the content bounds, empty if there is none.
+    Overlay::UvRect getTrimmedCrop(const Overlay::UvRect& crop, const BorderTrim::Rect& bounds) {
+        const float left = std::max(crop.x, bounds.x);
+        const float top = std::max(crop.y, bounds.y);
+        const float right = std::min(crop.x + crop.width, bounds.x + bounds.width);
+        const float bottom = std::min(crop.y + crop.height, bounds.y + bounds.height);
+        return {left, top, std::max(right - left, 0.f), std::max(bottom - top, 0.f)};
+    }
+
+} // namespace
+
+namespace Overlay {
+
+    Vec3 rotate(const Quat& q, const Vec3& v) {
+        // v' = v + 2w(q x v) + 2q x (q x v)
+        const Vec3 t{2 * (q.y * v.z - q.z * v.y), 2 * (q.z * v.x - q.x * v.z), 2 * (q.x * v.y - q.y * v.x)};
+        return {v.x + q.w * t.x + (q.y * t.z - q.z * t.y),
+                v.y + q.w * t.y + (q.z * t.x - q.x * t.z),
+                v.z + q.w * t.z + (q.x * t.y - q.y * t.x)};
+    }
+
+    Quat lookAt(const Vec3& from, const Vec3& at) {
+        const float yaw = std::atan2(-(at.x - from.x), -(at.z - from.z));
+        return {0, std::sin(yaw / 2), 0, std::cos(yaw / 2)};
+    }
+
+    SKOverlay::SKOverlay(std::shared_ptr<WindowList::IWindowEventSource> windowSource,
+                         std::shared_ptr<Capture::ICaptureSourceFactory> captureFactory,
+                         std::shared_ptr<IRenderer> renderer)
+        : m_windowSource(std::move(windowSource)), m_captureFactory(std::move(captureFactory)),
+          m_renderer(std::move(renderer)) {
+        initializeAvailableMonitors();
+
+        m_windowEnumerator = std::make_unique<WindowList::WindowEnumerator>(m_windowSource, std::chrono::seconds(5));
+    }
+
+    void SKOverlay::initializeAvailableMonitors() {
+        m_availableMonitors.clear();
+
+        std::vector<WindowList::WindowInfo> monitors;
+        m_windowSource->enumerateMonitors(monitors);
+        for (auto& info : monitors) {
+            AvailableWindow availableMonitor;
+            availableMonitor.monitor = info.handle;
+            availableMonitor.title = std::move(info.title);
+            m_availableMonitors.push_back(std::move(availableMonitor));
+        }
+    }
+
+    void SKOverlay::refreshAvailableWindows() {
+        // Pick up the latest list from the enumerator, if it changed.
+        auto snapshot = m_windowEnumerator->getSnapshot();
+        if (!snapshot || snapshot == m_windowSnapshot) {
+            return;
+        }
+
+        Instrumentation::Scope scope("refreshAvailableWindows");
+
+        m_availableWindows.clear();
+        m_availableWindows.reserve(snapshot->windows.size());
+
+        for (const auto& info : snapshot->windows) {
+            AvailableWindow availableWindow;
+            availableWindow.window = info.handle;
+            availableWindow.title = info.title;
+            availableWindow.process = info.process;
+            availableWindow.mirrored = availableWindow.wasMirrored = m_sessions.find({info.handle, nullptr}) != nullptr;
+            // Open the windows that matched filters. Only new or renamed windows are matched, so that the user can
+            // still close a matching window.
+            if (!m_filters.empty()) {
+                const auto [matches, isNew] =
+                    m_titleMatches.match(m_filters, availableWindow.window, availableWindow.title);
+                if (isNew && std::find(matches->begin(), matches->end(), true) != matches->end()) {
+                    availableWindow.mirrored = true;
+                }
+            }
+            m_availableWindows.push_back(std::move(availableWindow));
+        }
+        m_titleMatches.sweep();
+
+        m_windowSnapshot = std::move(snapshot);
+    }
+
+    void SKOverlay::refreshAvailableStreams(double now) {
+        // Streams are not tracked by events, poll them.
+        if (now < m_nextStreamRefresh) {
+            return;
+        }
+        m_nextStreamRefresh = now + 1;
+
+        std::vector<WindowList::WindowInfo> streams;
+        m_windowSource->enumerateStreams(streams);
+
+        m_availableStreams.clear();
+        for (auto& info : streams) {
+            AvailableWindow availableStream;
+            availableStream.stream = info.handle;
+            availableStream.title = std::move(info.title);
+            availableStream.mirrored = availableStream.wasMirrored =
+                m_sessions.find({nullptr, nullptr, info.handle}) != nullptr;
+            m_availableStreams.push_back(std::move(availableStream));
+        }
+
+        // Close the overlays of the streams that are gone.
+        m_sessions.forEach([&](uint64_t, Session& session) {
+            if (session.stream && std::none_of(m_availableStreams.begin(),
+                                               m_availableStreams.end(),
+                                               [&](const AvailableWindow& availableStream) {
+                                                   return availableStream.stream == session.stream;
+                                               })) {
+                session.cleanup = true;
+            }
+        });
+    }
+
+    void SKOverlay::handleAvailableWindowsList(std::vector<AvailableWindow>& availableWindows) {
+        for (auto& availableWindow : availableWindows) {
+            // Draw the toggles.
+            m_renderer->toggle(availableWindow.title.c_str(), availableWindow.mirrored);
+
+            // Detect toggling a window on/off.
+            if (availableWindow.mirrored != availableWindow.wasMirrored) {
+                if (availableWindow.mirrored) {
+                    Window newWindow = {};
+                    newWindow.window = availableWindow.window;
+                    newWindow.monitor = availableWindow.monitor;
+                    newWindow.stream = availableWindow.stream;
+                    newWindow.title = availableWindow.title;
+                    newWindow.process = availableWindow.process;
+                    newWindow.pose = Pose{{0, 0, -0.5f + 0.001f * (rand() % 20)}, lookAt({0, 0, 0}, {0, 0, 1})};
+                    openWindow(std::move(newWindow));
+                } else if (Session* session = m_sessions.find(
+                               {availableWindow.window, availableWindow.monitor, availableWindow.stream})) {
+                    // Close all the views of the window.
+                    session->cleanup = true;
+                }
+            }
+            availableWindow.wasMirrored = availableWindow.mirrored;
+        }
+    }
+
+    uint64_t SKOverlay::openWindow(Window&& newWindow) {
+        const WindowKey key{newWindow.window, newWindow.monitor, newWindow.stream, newWindow.view};
+        if (m_windows.find(key)) {
+            return 0;
+        }
+
+        const auto [sessionId, isNewSession] =
+            m_sessions.insert({newWindow.window, newWindow.monitor, newWindow.stream}, Session{});
+        Session& session = *m_sessions.get(sessionId);
+        if (isNewSession) {
+            session.id = sessionId;
+            session.window = newWindow.window;
+            session.monitor = newWindow.monitor;
+            session.stream = newWindow.stream;
+            session.title = newWindow.title;
+        }
+        session.viewCount++;
+
+        newWindow.session = sessionId;
+        newWindow.crop = clampCrop(newWindow.crop);
+        const uint64_t id = m_windows.insert(key, std::move(newWindow)).first;
+        m_windows.get(id)->id = id;
+        return id;
+    }
+
+    void SKOverlay::closeWindow(uint64_t id) {
+        const Window* window = m_windows.get(id);
+        Session* session = m_sessions.get(window->session);
+        if (--session->viewCount == 0) {
+            releaseAtlasRegion(*session);
+            m_sessions.erase(session->id);
+        }
+        m_windows.erase(id);
+    }
+
+    void SKOverlay::ensureSessionResources(Session& session, double now) {
+        if (session.window && !m_windowSource->isAlive(session.window)) {
+            session.cleanup = true;
+        }
+        if (session.cleanup) {
+            return;
+        }
+
+        if (!session.texture) {
+            session.texture = m_renderer->createTexture();
+        }
+
+        if (session.captureSource) {
+            return;
+        }
+
+        if (session.pendingCaptureSource.valid()) {
+            // Pick up the capture source once the worker is done with it.
+            if (session.pendingCaptureSource.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                return;
+            }
+
+            try {
+                session.captureSource = session.pendingCaptureSource.get();
+                session.captureAttempts = 0;
+            } catch (const std::exception& exception) {
+                // Retry with exponential backoff, up to 30 seconds.
+                session.captureAttempts++;
+                const double delay = std::min(0.5 * (1u << std::min(session.captureAttempts - 1, 6u)), 30.0);
+                session.nextCaptureAttempt = now + delay;
+
+                char text[512];
+                snprintf(text,
+                         sizeof(text),
+                         "Failed to open window capture for '%s' (attempt %u, retrying in %.1fs): %s",
+                         session.title.c_str(),
+                         session.captureAttempts,
+                         delay,
+                         exception.what());
+                m_renderer->logWarning(text);
+            }
+        } else if (now >= session.nextCaptureAttempt) {
+            const auto factory = m_captureFactory;
+            const WindowList::Handle handle = session.window;
+            const WindowList::Handle monitor = session.monitor;
+            const WindowList::Handle stream = session.stream;
+            session.pendingCaptureSource = m_captureWorkers.submit([factory, handle, monitor, stream] {
+                if (stream) {
+                    return factory->createForStream(stream);
+                }
+                return handle ? factory->createForWindow(handle) : factory->createForMonitor(monitor);
+            });
+        }
+    }
+
+    void SKOverlay::updateSession(Session& session, const Visibility::Policy& policy, double now) {
+        // Frames left in the pool are not copied into again, which throttles the capture. The first view that asks for
+        // a frame updates the capture for all the others.
+        const bool isReleased = session.memoryLevel == GpuMemory::Level::Released;
+        if (policy.capture && !isReleased && session.updateFrame != m_frameNumber &&
+            now - session.lastCaptureTime >= policy.minimumInterval) {
+            session.updateFrame = m_frameNumber;
+            session.lastCaptureTime = now;
+
+            const uint64_t delivered = session.frameBinder.getStats().delivered;
+            {
+                Instrumentation::Scope scope("getSurface", session.id);
+
+                // Only re-bind the texture when the source delivered a new frame.
+                const uint64_t sequence = session.captureSource->update();
+                if (session.frameBinder.update(sequence, session.captureSource->getSurface())) {
+                    session.texture->setSurface(session.captureSource->getSurface(),
+                                                session.captureSource->getDesc().format);
+                }
+            }
+            if (session.frameBinder.getStats().delivered != delivered) {
+                session.newFrame = m_frameNumber;
+                const uint64_t latency = session.captureSource->getLatency();
+                Instrumentation::getRecorder().record(
+                    "capture latency", session.id, Instrumentation::now() - latency, latency);
+
+                if (!m_timeToFirstPixel) {
+                    m_timeToFirstPixel = Instrumentation::now() - m_startTime;
+                    Instrumentation::getRecorder().record("time to first pixel", 0, m_startTime, m_timeToFirstPixel);
+                }
+            }
+        }
+
+        updateAtlasRegion(session);
+        if (session.atlasPage >= 0) {
+            AtlasPage& page = m_atlasPages[session.atlasPage];
+            if (session.atlasFrame != session.newFrame || session.atlasGeneration != page.generation) {
+                page.page->copySurface(session.captureSource->getSurface(), page.packer.get(session.atlasRegion));
+                session.atlasFrame = session.newFrame;
+                session.atlasGeneration = page.generation;
+            }
+        }
+    }
+
+    void SKOverlay::updateAtlasRegion(Session& session) {
+        const Capture::SurfaceDesc& desc = session.captureSource->getDesc();
+        const bool isEligible = m_atlasEnabled && session.captureSource->getSurface() && desc.width > 0 &&
+                                desc.height > 0 && desc.width <= MaxAtlasSurfaceSize &&
+                                desc.height <= MaxAtlasSurfaceSize;
+        if (session.atlasPage >= 0) {
+            const AtlasPage& page = m_atlasPages[session.atlasPage];
+            const Atlas::Rect& rect = page.packer.get(session.atlasRegion);
+            if (isEligible && page.format == desc.format && rect.width == desc.width && rect.height == desc.height) {
+                return;
+            }
+            releaseAtlasRegion(session);
+        }
+        if (!isEligible ||
+            (session.atlasRejected.width == desc.width && session.atlasRejected.height == desc.height &&
+             session.atlasRejected.format == desc.format && session.atlasRejectedReleases == m_atlasReleases)) {
+            return;
+        }
+
+        // First fit among the pages of the same format, compacting a page before giving up on it.
+        for (size_t i = 0; i < m_atlasPages.size(); i++) {
+            AtlasPage& page = m_atlasPages[i];
+            if (page.format != desc.format) {
+                continue;
+            }
+            auto region = page.packer.allocate(desc.width, desc.height);
+            if (!region && page.packer.repack()) {
+                page.generation++;
+                region = page.packer.allocate(desc.width, desc.height);
+            }
+            if (region) {
+                session.atlasPage = static_cast<int32_t>(i);
+                session.atlasRegion = region.value();
+                return;
+            }
+        }
+
+        if (m_atlasPages.size() < MaxAtlasPages) {
+            AtlasPage page{desc.format,
+                           Atlas::RectPacker(AtlasPageSize, AtlasPageSize),
+                           m_renderer->createAtlasPage(AtlasPageSize, AtlasPageSize, desc.format)};
+            session.atlasPage = static_cast<int32_t>(m_atlasPages.size());
+            session.atlasRegion = page.packer.allocate(desc.width, desc.height).value();
+            m_atlasPages.push_back(std::move(page));
+            return;
+        }
+
+        // Keep drawing the overlay from its own texture.
+        session.atlasRejected = desc;
+        session.atlasRejectedReleases = m_atlasReleases;
+    }
+
+    void SKOverlay::releaseAtlasRegion(Session& session) {
+        if (session.atlasPage < 0) {
+            return;
+        }
+        m_atlasPages[session.atlasPage].packer.free(session.atlasRegion);
+        session.atlasPage = -1;
+        session.atlasRegion = 0;
+        session.atlasGeneration = 0;
+        m_atlasReleases++;
+    }
+
+    Visibility::Bounds SKOverlay::getBounds(const Window& window) const {
+        const Vec3 offset = rotate(window.pose.orientation, {0, -window.extent.y / 2, 0});
+
+        Visibility::Bounds bounds;
+        bounds.center = {window.pose.position.x + offset.x,
+                         window.pose.position.y + offset.y,
+                         window.pose.position.z + offset.z};
+        bounds.radius = std::sqrt(window.extent.x * window.extent.x + window.extent.y * window.extent.y) / 2;
+        return bounds;
+    }
+
+    void SKOverlay::scheduleCaptures(const Visibility::Head& head, double now) {
+        // Re-balancing the budget every frame would only add jitter.
+        const double elapsed = now - m_lastSchedule;
+        if (elapsed < 0.25) {
+            return;
+        }
+        m_lastSchedule = now;
+
+        Instrumentation::Scope scope("scheduleCaptures");
+
+        m_pointers.clear();
+        m_renderer->getPointers(m_pointers);
+        const float maximumRate = m_scheduler->getConfig().maximumRate;
+
+        // A session is as important as all its views together.
+        m_sessions.forEach([&](uint64_t, Session& session) {
+            session.gaze = session.apparentSize = 0;
+            session.pinned = session.isVisible = false;
+        });
+        m_windows.forEach([&](uint64_t, Window& window) {
+            if (!Visibility::getPolicy(window.visibility.current, m_visibilityConfig).capture) {
+                return;
+            }
+
+            const Visibility::Bounds bounds = getBounds(window);
+            const Visibility::Attention attention = Visibility::getAttention(head, bounds, m_visibilityConfig);
+            const bool pointedAt = std::any_of(m_pointers.begin(), m_pointers.end(), [&](const Ray& pointer) {
+                return Visibility::isPointedAt(pointer, bounds);
+            });
+            Session& session = *m_sessions.get(window.session);
+            session.gaze = std::max(session.gaze, pointedAt ? 1 : attention.gaze);
+            session.apparentSize += attention.apparentSize;
+            session.pinned = session.pinned || window.pinned;
+            session.isVisible = true;
+        });
+
+        m_captureRequests.clear();
+        m_sessions.forEach([&](const uint64_t id, Session& session) {
+            const uint64_t delivered = session.frameBinder.getStats().delivered;
+            const uint64_t newFrames = delivered - session.scheduledDelivered;
+            session.scheduledDelivered = delivered;
+            if (!session.captureSource || !session.isVisible) {
+                session.captureRate = session.captureInterval = 0;
+                session.importance = 0;
+                return;
+            }
+
+            CaptureScheduler::Request request;
+            request.id = id;
+            const auto size = session.captureSource->getSize();
+            request.pixels = static_cast<int64_t>(size.first) * size.second;
+
+            // Sources only deliver frames when their content changes. Ask for a bit more than what was delivered, or
+            // for as much as possible when the source was held back.
+            const float deliveredRate = static_cast<float>(newFrames / elapsed);
+            request.demand = deliveredRate >= 0.9f * session.captureRate ? maximumRate : deliveredRate * 1.25f + 1;
+
+            request.gaze = session.gaze;
+            request.apparentSize = session.apparentSize;
+            request.pinned = session.pinned;
+            session.importance = m_scheduler->getWeight(request);
+            m_captureRequests.push_back(request);
+        });
+
+        m_scheduler->schedule(m_captureRequests, m_captureAllocations);
+        for (const auto& allocation : m_captureAllocations) {
+            Session* session = m_sessions.get(allocation.id);
+            session->captureRate = allocation.rate;
+            session->captureInterval = allocation.minimumInterval;
+        }
+
+        // The overlays that are not captured (minimized, out of view) are the first to give back their memory.
+        balanceMemory();
+    }
+
+    void SKOverlay::balanceMemory() {
+        Instrumentation::Scope scope("balanceMemory");
+
+        m_memoryRequests.clear();
+        m_memorySummary.clear();
+        m_sessions.forEach([&](const uint64_t id, Session& session) {
+            if (!session.captureSource) {
+                session.memoryBytes = 0;
+                return;
+            }
+
+            GpuMemory::Request request;
+            request.id = id;
+            request.importance = session.importance;
+            request.level = session.memoryLevel;
+            for (size_t level = 0; level < GpuMemory::LevelCount; level++) {
+                m_memoryAllocations.clear();
+                session.captureSource->getAllocations(static_cast<GpuMemory::Level>(level), m_memoryAllocations);
+                if (session.thumbnailReader && static_cast<GpuMemory::Level>(level) != GpuMemory::Level::Released) {
+                    session.thumbnailReader->getAllocations(m_memoryAllocations);
+                }
+                request.bytes[level] = GpuMemory::getTotal(m_memoryAllocations);
+                if (static_cast<GpuMemory::Level>(level) == session.memoryLevel) {
+                    m_memorySummary.insert(
+                        m_memorySummary.end(), m_memoryAllocations.begin(), m_memoryAllocations.end());
+                    session.memoryBytes = request.bytes[level];
+                }
+            }
+            m_memoryRequests.push_back(request);
+        });
+
+        uint64_t reservedBytes = 0;
+        for (const auto& page : m_atlasPages) {
+            m_memorySummary.push_back({GpuMemory::Kind::Atlas, AtlasPageSize, AtlasPageSize, page.format});
+            reservedBytes += m_memorySummary.back().getBytes();
+        }
+        GpuMemory::summarize(m_memorySummary);
+        m_memoryUsage = GpuMemory::getTotal(m_memorySummary);
+
+        m_memoryPolicy->decide(m_memoryRequests, reservedBytes, m_memoryDecisions);
+        for (const auto& decision : m_memoryDecisions) {
+            Session* session = m_sessions.get(decision.id);
+            if (session->memoryLevel != decision.level) {
+                setMemoryLevel(*session, decision.level);
+            }
+        }
+    }
+
+    void SKOverlay::setMemoryLevel(Session& session, GpuMemory::Level level) {
+        session.captureSource->setMemoryLevel(level);
+        session.memoryLevel = level;
+
+        // Drop our references to the surface too, and re-bind once the source delivers frames again.
+        if (level == GpuMemory::Level::Released) {
+            releaseAtlasRegion(session);
+            session.texture = m_renderer->createTexture();
+            session.thumbnailReader.reset();
+        }
+        session.frameBinder.invalidate();
+    }
+
+    void SKOverlay::updateTrim(Session& session) {
+        if (!session.isTrimWanted) {
+            session.thumbnailReader.reset();
+            session.trimmer.reset();
+            return;
+        }
+        if (!session.captureSource || session.memoryLevel == GpuMemory::Level::Released ||
+            m_frameNumber < session.nextTrimFrame) {
+            return;
+        }
+        session.nextTrimFrame = m_frameNumber + TrimInterval;
+
+        if (!session.thumbnailReader) {
+            session.thumbnailReader = m_renderer->createThumbnailReader();
+            session.trimFrame = 0;
+        }
+
+        // The copy requested during the previous search is long done by now, so reading it does not stall.
+        if (session.thumbnailReader->read(m_thumbnail)) {
+            Instrumentation::Scope scope("trimBorders", session.id);
+            session.trimmer.update(
+                m_thumbnail.pixels.data(), m_thumbnail.width * 4, m_thumbnail.width, m_thumbnail.height);
+        }
+
+        // Only search the frames that changed.
+        if (session.trimFrame != session.newFrame && session.captureSource->getSurface()) {
+            session.thumbnailReader->request(session.captureSource->getSurface());
+            session.trimFrame = session.newFrame;
+        }
+    }
+
+    void SKOverlay::drawCropControls(Window& window) {
+        UvRect& crop = window.crop;
+        bool changed = m_renderer->hslider("Left", crop.x, 0, 1);
+        changed = m_renderer->hslider("Top", crop.y, 0, 1) || changed;
+        changed = m_renderer->hslider("Width", crop.width, 0, 1) || changed;
+        changed = m_renderer->hslider("Height", crop.height, 0, 1) || changed;
+        if (changed) {
+            crop = clampCrop(crop);
+        }
+        if (m_renderer->button("Reset crop")) {
+            crop = {};
+        }
+    }
+
+    void SKOverlay::drawWindows() {
+        const Pose headPose = m_renderer->getHeadPose();
+        const double now = m_renderer->getTime();
+
+        Visibility::Head head;
+        head.position = headPose.position;
+        head.forward = rotate(headPose.orientation, {0, 0, -1});
+
+        scheduleCaptures(head, now);
+
+        m_frameNumber++;
+        m_sessions.forEach([&](uint64_t, Session& session) { ensureSessionResources(session, now); });
+
+        m_windows.forEach([&](const uint64_t id, Window& window) {
+            Session& session = *m_sessions.get(window.session);
+            if (window.cleanup || session.cleanup) {
+                closeWindow(id);
+                return;
+            }
+
+            // Decide how much work this window deserves based on where the user is looking and its share of the
+            // capture budget.
+            const Visibility::Class visibility = Visibility::track(
+                window.visibility, head, getBounds(window), window.minimized, now, m_visibilityConfig);
+            auto policy = Visibility::getPolicy(visibility, m_visibilityConfig);
+            policy.minimumInterval =
+                std::max({policy.minimumInterval, m_budget.minimumCaptureInterval, session.captureInterval});
+            const bool isReleased = session.memoryLevel == GpuMemory::Level::Released;
+            session.isWanted = session.isWanted || policy.capture;
+            session.isTrimWanted = session.isTrimWanted || window.autoTrim;
+
+            // Draw the window.
+            m_renderer->windowBegin(
+                window.title.c_str(), window.pose, window.decorate ? WindowStyle::Head : WindowStyle::Empty);
+
+            if (!window.minimized) {
+                std::pair<int32_t, int32_t> size;
+                if (session.captureSource) {
+                    updateSession(session, policy, now);
+                    size = session.captureSource->getSize();
+                    if (isReleased) {
+                        m_renderer->label("Capture released to save GPU memory");
+                    }
+                } else {
+                    // Placeholder until the capture session is ready.
+                    m_renderer->label(session.captureAttempts ? "Capture failed, retrying..." : "Starting capture...");
+                    size = session.texture->getSize();
+                }
+
+                const UvRect& crop = window.crop;
+                const Vec2 scaledSize{size.first * crop.width * 0.0004f * window.scale,
+                                      size.second * crop.height * 0.0004f * window.scale};
+                m_renderer->layoutReserve(scaledSize);
+                window.extent = scaledSize;
+
+                // Only draw the content, in place within the room of the whole crop so that the window does not move.
+                const UvRect shown = window.autoTrim ? getTrimmedCrop(crop, session.trimmer.getBounds()) : crop;
+                if (policy.render && !isReleased && shown.width > 0 && shown.height > 0) {
+                    const Vec2 shownSize{scaledSize.x * shown.width / crop.width,
+                                         scaledSize.y * shown.height / crop.height};
+                    // The texture coordinates go from left to right, the UI coordinates from right to left.
+                    const Vec3 position{
+                        (0.5f - (shown.x + shown.width / 2 - crop.x) / crop.width) * scaledSize.x,
+                        -(shown.y + shown.height / 2 - crop.y) / crop.height * scaledSize.y,
+                        0};
+                    if (session.atlasPage >= 0) {
+                        const AtlasPage& page = m_atlasPages[session.atlasPage];
+                        const Atlas::Rect& region = page.packer.get(session.atlasRegion);
+                        const Atlas::Rect rect{region.x + static_cast<int32_t>(std::lround(shown.x * region.width)),
+                                               region.y + static_cast<int32_t>(std::lround(shown.y * region.height)),
+                                               static_cast<int32_t>(std::lround(shown.width * region.width)),
+                                               static_cast<int32_t>(std::lround(shown.height * region.height))};
+                        page.page->addQuad(rect, position, shownSize);
+                    } else {
+                        m_renderer->drawQuad(*session.texture, position, shownSize, shown);
+                    }
+                }
+
+                if (m_renderer->button("+")) {
+                    window.scale *= 1.1f;
+                }
+                m_renderer->sameLine();
+                if (m_renderer->button("-")) {
+                    window.scale *= 0.9f;
+                }
+                m_renderer->sameLine();
+            }
+
+            if (m_renderer->button(window.decorate ? "Hide title" : "Show title")) {
+                window.decorate = !window.decorate;
+            }
+            m_renderer->sameLine();
+
+            if (m_renderer->button(window.minimized ? "Show" : "Minimize")) {
+                window.minimized = !window.minimized;
+            }
+            m_renderer->sameLine();
+
+            // Pinned windows get a larger share of the capture budget.
+            if (m_renderer->button(window.pinned ? "Unpin" : "Pin")) {
+                window.pinned = !window.pinned;
+            }
+            m_renderer->sameLine();
+
+            // Uniform or transparent borders cost fill-rate for nothing.
+            if (m_renderer->button(window.autoTrim ? "Show borders" : "Trim borders")) {
+                window.autoTrim = !window.autoTrim;
+            }
+
+            // More regions of the same capture, at no extra capture cost.
+            if (m_renderer->button(window.editCrop ? "Done" : "Crop")) {
+                window.editCrop = !window.editCrop;
+            }
+            m_renderer->sameLine();
+            if (m_renderer->button("New view")) {
+                m_newViews.push_back(id);
+            }
+            if (session.viewCount > 1) {
+                m_renderer->sameLine();
+                if (m_renderer->button("Close view")) {
+                    window.cleanup = true;
+                }
+            }
+            if (window.editCrop && !window.minimized) {
+                drawCropControls(window);
+            }
+
+            if (m_showStats) {
+                const auto& stats = session.frameBinder.getStats();
+                char text[128];
+                snprintf(text,
+                         sizeof(text),
+                         "Frames delivered: %llu re-bound: %llu skipped: %llu",
+                         (unsigned long long)stats.delivered,
+                         (unsigned long long)stats.rebound,
+                         (unsigned long long)stats.skipped);
+                m_renderer->label(text);
+                snprintf(text, sizeof(text), "Capture rate: %.1f fps", session.captureRate);
+                m_renderer->label(text);
+                snprintf(text,
+                         sizeof(text),
+                         "GPU memory: %.1f MB (%s)",
+                         session.memoryBytes / 1048576.0,
+                         GpuMemory::toString(session.memoryLevel));
+                m_renderer->label(text);
+                if (session.viewCount > 1) {
+                    snprintf(text, sizeof(text), "Capture shared by %u views", session.viewCount);
+                    m_renderer->label(text);
+                }
+                if (window.autoTrim) {
+                    const UvRect shown = getTrimmedCrop(window.crop, session.trimmer.getBounds());
+                    snprintf(text,
+                             sizeof(text),
+                             "Borders trimmed: %.0f%% of the area drawn",
+                             100 * shown.width * shown.height / (window.crop.width * window.crop.height));
+                    m_renderer->label(text);
+                }
+                m_renderer->label(Visibility::toString(window.visibility.current));
+            }
+
+            m_renderer->windowEnd();
+        });
+
+        // Only capture while at least one of the views needs it.
+        m_sessions.forEach([&](uint64_t, Session& session) {
+            if (session.captureSource) {
+                session.captureSource->setPaused(!session.isWanted ||
+                                                 session.memoryLevel == GpuMemory::Level::Released);
+            }
+            session.isWanted = false;
+            updateTrim(session);
+            session.isTrimWanted = false;
+        });
+
+        for (const uint64_t id : m_newViews) {
+            const Window* window = m_windows.get(id);
+            if (!window) {
+                continue;
+            }
+
+            // Next to the original, ready to be cropped.
+            Window newWindow = {};
+            newWindow.window = window->window;
+            newWindow.monitor = window->monitor;
+            newWindow.stream = window->stream;
+            newWindow.view = m_nextView++;
+            newWindow.title = window->title;
+            newWindow.process = window->process;
+            newWindow.crop = window->crop;
+            const Vec3 offset = rotate(window->pose.orientation, {window->extent.x + 0.02f, 0, 0});
+            newWindow.pose = {{window->pose.position.x + offset.x,
+                               window->pose.position.y + offset.y,
+                               window->pose.position.z + offset.z},
+                              window->pose.orientation};
+            newWindow.scale = window->scale;
+            newWindow.decorate = window->decorate;
+            newWindow.autoTrim = window->autoTrim;
+            newWindow.editCrop = true;
+            openWindow(std::move(newWindow));
+        }
+        m_newViews.clear();
+
+        for (auto& page : m_atlasPages) {
+            page.page->draw();
+        }
+    }
+
+    void SKOverlay::drawStatistics() {
+        m_renderer->windowBegin("Statistics", m_statisticsPose, WindowStyle::Normal);
+
+        char text[256];
+        snprintf(text, sizeof(text), "Load shedding level: %u", m_budget.level);
+        m_renderer->label(text);
+        for (size_t i = 0; i < m_atlasPages.size(); i++) {
+            snprintf(text,
+                     sizeof(text),
+                     "Atlas page %zu: %zu overlays, %.0f%% occupied",
+                     i,
+                     m_atlasPages[i].packer.getCount(),
+                     100 * m_atlasPages[i].packer.getOccupancy());
+            m_renderer->label(text);
+        }
+        const uint64_t memoryCap = m_memoryPolicy->getConfig().cap;
+        if (memoryCap) {
+            snprintf(text,
+                     sizeof(text),
+                     "GPU memory: %.0f MB of %.0f MB",
+                     m_memoryUsage / 1048576.0,
+                     memoryCap / 1048576.0);
+        } else {
+            snprintf(text, sizeof(text), "GPU memory: %.0f MB", m_memoryUsage / 1048576.0);
+        }
+        m_renderer->label(text);
+        for (const auto& allocation : m_memorySummary) {
+            snprintf(text,
+                     sizeof(text),
+                     "  %s %dx%d (format %lld) x%u: %.1f MB",
+                     GpuMemory::toString(allocation.kind),
+                     allocation.width,
+                     allocation.height,
+                     (long long)allocation.format,
+                     allocation.count,
+                     allocation.getBytes() / 1048576.0);
+            m_renderer->label(text);
+        }
+        if (m_timeToFirstPixel) {
+            snprintf(text, sizeof(text), "Time to first pixel: %.1f ms", m_timeToFirstPixel / 1e6);
+            m_renderer->label(text);
+        }
+
+        for (const auto& entry : m_statistics.getEntries()) {
+            const Session* session = entry.key ? m_sessions.get(entry.key) : nullptr;
+            const char* title = session ? session->title.c_str() : "";
+
+            snprintf(text,
+                     sizeof(text),
+                     "%s%s%.48s: p50 %.2f ms, p99 %.2f ms (%llu)",
+                     entry.name,
+                     entry.key ? " - " : "",
+                     title,
+                     entry.p50 / 1e6,
+                     entry.p99 / 1e6,
+                     (unsigned long long)entry.count);
+            m_renderer->label(text);
+        }
+
+        m_renderer->windowEnd();
+    }
+
+    void SKOverlay::step() {
+        Instrumentation::Scope scope("step");
+
+        m_renderer->windowBegin("Window Selection", m_menuPose, WindowStyle::Normal);
+
+        bool wasMinimized = m_minimized;
+        if (m_renderer->button(m_minimized ? "Open" : "Close")) {
+            m_minimized = !m_minimized;
+        }
+        m_renderer->sameLine();
+        if (m_renderer->button(m_handsVisible ? "Hide hands" : "Show hands")) {
+            m_handsVisible = !m_handsVisible;
+            m_renderer->setHandsVisible(m_handsVisible);
+        }
+        m_renderer->sameLine();
+        if (m_renderer->button(m_showStats ? "Hide stats" : "Show stats")) {
+            m_showStats = !m_showStats;
+        }
+        if (!m_layoutPath.empty()) {
+            m_renderer->sameLine();
+            if (m_renderer->button("Save layout")) {
+                saveLayout();
+            }
+        }
+
+        // Under load, pick up the changes to the window list less often.
+        const double now = m_renderer->getTime();
+        const bool refreshUi = now >= m_nextUiRefresh;
+        if (refreshUi) {
+            m_nextUiRefresh = now + m_budget.uiRefreshInterval;
+        }
+
+        if (!m_minimized && wasMinimized) {
+            m_windowEnumerator->requestRescan();
+        }
+        if (refreshUi) {
+            refreshAvailableWindows();
+        }
+        refreshAvailableStreams(now);
+
+        if (!m_minimized) {
+            m_renderer->separator();
+            handleAvailableWindowsList(m_availableMonitors);
+            if (!m_availableStreams.empty()) {
+                m_renderer->separator();
+                handleAvailableWindowsList(m_availableStreams);
+            }
+            m_renderer->separator();
+            handleAvailableWindowsList(m_availableWindows);
+        }
+
+        m_renderer->windowEnd();
+
+        drawWindows();
+
+        m_statistics.update();
+        if (m_showStats) {
+            drawStatistics();
+        }
+    }
+
+    void SKOverlay::restoreLayout(const std::string& path, const std::string& profileName) {
+        Instrumentation::Scope scope("restoreLayout");
+
+        m_layoutPath = path;
+        m_layoutProfile = profileName;
+        m_unmatchedEntries.clear();
+
+        Layout::Profile profile;
+        std::vector<WindowList::WindowInfo> windows;
+        std::vector<WindowList::WindowInfo> streams;
+        std::vector<std::pair<size_t, size_t>> assignments;
+        try {
+            const auto file = Layout::File::open(path);
+            if (!file || !file->getProfile(profileName, profile)) {
+                return;
+            }
+
+            // Do not wait for the enumerator, the list would only come after the first frames.
+            m_windowSource->enumerate(windows);
+            m_windowSource->enumerateStreams(streams);
+
+            std::vector<Layout::Identity> candidates;
+            for (const auto& info : windows) {
+                candidates.push_back({Layout::Kind::Window, info.process, info.title});
+            }
+            for (const auto& monitor : m_availableMonitors) {
+                candidates.push_back({Layout::Kind::Monitor, {}, monitor.title});
+            }
+            for (const auto& info : streams) {
+                candidates.push_back({Layout::Kind::Stream, {}, info.title});
+            }
+            assignments = Layout::match(profile, candidates);
+        } catch (const std::exception& exception) {
+            char text[512];
+            snprintf(text, sizeof(text), "Failed to restore layout from '%s': %s", path.c_str(), exception.what());
+            m_renderer->logWarning(text);
+            return;
+        }
+
+        std::vector<bool> isMatched(profile.entries.size());
+        for (const auto& assignment : assignments) {
+            isMatched[assignment.first] = true;
+        }
+        for (size_t i = 0; i < profile.entries.size(); i++) {
+            if (!isMatched[i]) {
+                m_unmatchedEntries.push_back(profile.entries[i]);
+            }
+        }
+
+        const double now = m_renderer->getTime();
+        for (const auto& [entryIndex, candidateIndex] : assignments) {
+            const Layout::Entry& entry = profile.entries[entryIndex];
+
+            Window newWindow = {};
+            if (candidateIndex < windows.size()) {
+                newWindow.window = windows[candidateIndex].handle;
+                newWindow.title = windows[candidateIndex].title;
+                newWindow.process = windows[candidateIndex].process;
+            } else if (candidateIndex < windows.size() + m_availableMonitors.size()) {
+                AvailableWindow& monitor = m_availableMonitors[candidateIndex - windows.size()];
+                monitor.mirrored = monitor.wasMirrored = true;
+                newWindow.monitor = monitor.monitor;
+                newWindow.title = monitor.title;
+            } else {
+                const auto& info = streams[candidateIndex - windows.size() - m_availableMonitors.size()];
+                newWindow.stream = info.handle;
+                newWindow.title = info.title;
+            }
+            newWindow.pose.position = {entry.position[0], entry.position[1], entry.position[2]};
+            newWindow.pose.orientation = {
+                entry.orientation[0], entry.orientation[1], entry.orientation[2], entry.orientation[3]};
+            newWindow.scale = entry.scale;
+            newWindow.decorate = entry.flags & Layout::Decorate;
+            newWindow.minimized = entry.flags & Layout::Minimized;
+            newWindow.pinned = entry.flags & Layout::Pinned;
+            newWindow.autoTrim = entry.flags & Layout::TrimBorders;
+            newWindow.crop = {entry.crop[0], entry.crop[1], entry.crop[2], entry.crop[3]};
+            if (entry.flags & Layout::SameCapture) {
+                newWindow.view = m_nextView++;
+            }
+
+            if (const uint64_t id = openWindow(std::move(newWindow))) {
+                // Start the capture now, so that the sessions get created in parallel before the first frame.
+                ensureSessionResources(*m_sessions.get(m_windows.get(id)->session), now);
+            }
+        }
+    }
+
+    void SKOverlay::saveLayout() {
+        if (m_layoutPath.empty()) {
+            return;
+        }
+
+        // The views of the same capture follow each other.
+        std::vector<const Window*> windows;
+        m_windows.forEach([&](uint64_t, Window& window) { windows.push_back(&window); });
+        std::sort(windows.begin(), windows.end(), [](const Window* a, const Window* b) {
+            return std::make_pair(a->session, a->view) < std::make_pair(b->session, b->view);
+        });
+
+        Layout::Profile profile;
+        profile.name = m_layoutProfile;
+        for (size_t i = 0; i < windows.size(); i++) {
+            const Window& window = *windows[i];
+            Layout::Entry entry;
+            entry.kind = window.stream    ? Layout::Kind::Stream
+                         : window.monitor ? Layout::Kind::Monitor
+                                          : Layout::Kind::Window;
+            entry.process = window.process;
+            entry.titlePattern = Layout::makeTitlePattern(window.title);
+            entry.position[0] = window.pose.position.x;
+            entry.position[1] = window.pose.position.y;
+            entry.position[2] = window.pose.position.z;
+            entry.orientation[0] = window.pose.orientation.x;
+            entry.orientation[1] = window.pose.orientation.y;
+            entry.orientation[2] = window.pose.orientation.z;
+            entry.orientation[3] = window.pose.orientation.w;
+            entry.scale = window.scale;
+            const bool isSameCapture = i > 0 && windows[i - 1]->session == window.session;
+            entry.flags = (window.decorate ? uint32_t{Layout::Decorate} : 0) |
+                          (window.minimized ? uint32_t{Layout::Minimized} : 0) |
+                          (window.pinned ? uint32_t{Layout::Pinned} : 0) |
+                          (window.autoTrim ? uint32_t{Layout::TrimBorders} : 0) |
+                          (isSameCapture ? uint32_t{Layout::SameCapture} : 0);
+            entry.crop[0] = window.crop.x;
+            entry.crop[1] = window.crop.y;
+            entry.crop[2] = window.crop.width;
+            entry.crop[3] = window.crop.height;
+            profile.entries.push_back(std::move(entry));
+        }
+
+        // Keep the overlays of the windows that were missing when restoring, unless they were opened since. The
+        // SameCapture entries follow their unmatched entry, so the groups stay together.
+        if (!m_unmatchedEntries.empty()) {
+            std::vector<Layout::Identity> candidates;
+            for (const Window* window : windows) {
+                const Layout::Kind kind = window->stream    ? Layout::Kind::Stream
+                                          : window->monitor ? Layout::Kind::Monitor
+                                                            : Layout::Kind::Window;
+                candidates.push_back({kind, window->process, window->title});
+            }
+            Layout::Profile unmatched;
+            unmatched.entries = std::move(m_unmatchedEntries);
+            std::vector<bool> isOpen(unmatched.entries.size());
+            try {
+                for (const auto& assignment : Layout::match(unmatched, candidates)) {
+                    isOpen[assignment.first] = true;
+                }
+            } catch (const std::exception&) {
+                // The patterns were already compiled when restoring.
+            }
+            m_unmatchedEntries.clear();
+            for (size_t i = 0; i < unmatched.entries.size(); i++) {
+                if (!isOpen[i]) {
+                    m_unmatchedEntries.push_back(unmatched.entries[i]);
+                }
+            }
+            profile.entries.insert(profile.entries.end(), m_unmatchedEntries.begin(), m_unmatchedEntries.end());
+        }
+
+        std::vector<Layout::Profile> profiles;
+        try {
+            profiles = Layout::loadAll(m_layoutPath);
+        } catch (const std::exception&) {
+            // Replace a corrupted file.
+        }
+        try {
+            const auto it = std::find_if(profiles.begin(), profiles.end(), [&](const Layout::Profile& existing) {
+                return existing.name == profile.name;
+            });
+            if (it != profiles.end()) {
+                *it = std::move(profile);
+            } else {
+                profiles.push_back(std::move(profile));
+            }
+            Layout::save(m_layoutPath, profiles);
+        } catch (const std::exception& exception) {
+            char text[512];
+            snprintf(text, sizeof(text), "Failed to save layout to '%s': %s", m_layoutPath.c_str(), exception.what());
+            m_renderer->logWarning(text);
+        }
+    }
+
+    void SKOverlay::startTrace(const std::string& path) {
+        m_tracePath = path;
+        m_statistics.startTrace(1 << 22);
+    }
+
+    void SKOverlay::writeTrace() {
+        if (!m_tracePath.empty() && !m_statistics.writeTrace(m_tracePath)) {
+            m_renderer->logWarning("Failed to write trace file");
+        }
+    }
+
+    void SKOverlay::addFilter(const std::string& expression) {
+        if (expression.empty()) {
+            return;
+        }
+        m_filters.add(expression);
+        m_titleMatches.clear();
+    }
+
+} // namespace Overlay
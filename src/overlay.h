@@ -0,0 +1,395 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "border_trim.h"
+#include "capture_scheduler.h"
+#include "capture_source.h"
+#include "frame_pacing.h"
+#include "gpu_memory.h"
+#include "instrumentation.h"
+#include "layout.h"
+#include "rect_packer.h"
+#include "slot_map.h"
+#include "title_matcher.h"
+#include "visibility.h"
+#include "window_list.h"
+#include "worker_pool.h"
+
+namespace Overlay {
+
+    using Visibility::Vec3;
+
+    struct Vec2 {
+        float x = 0;
+        float y = 0;
+    };
+
+    // Same layout as the StereoKit types.
+    struct Quat {
+        float x = 0;
+        float y = 0;
+        float z = 0;
+        float w = 1;
+    };
+
+    struct Pose {
+        Vec3 position;
+        Quat orientation;
+    };
+
+    using Visibility::Ray;
+
+    // A region of a texture, in texture coordinates.
+    struct UvRect {
+        float x = 0;
+        float y = 0;
+        float width = 1;
+        float height = 1;
+    };
+
+    Vec3 rotate(const Quat& orientation, const Vec3& vector);
+
+    // Orientation facing from a point towards another (yaw only, forward is -Z).
+    Quat lookAt(const Vec3& from, const Vec3& at);
+
+    enum class WindowStyle {
+        Normal,
+        Head,
+        Empty,
+    };
+
+    // A texture and the material to draw it.
+    struct ITexture {
+        virtual ~ITexture() = default;
+
+        virtual void setSurface(void* surface, int64_t format) = 0;
+        virtual std::pair<int32_t, int32_t> getSize() const = 0;
+    };
+
+    // A texture shared by several small overlays, drawn in a single batch.
+    struct IAtlasPage {
+        virtual ~IAtlasPage() = default;
+
+        // Copy a surface into a region of the page.
+        virtual void copySurface(void* surface, const Atlas::Rect& rect) = 0;
+        // Queue a quad showing a region of the page, relative to the current UI window.
+        virtual void addQuad(const Atlas::Rect& rect, const Vec3& position, const Vec2& size) = 0;
+        // Draw the quads queued since the previous call.
+        virtual void draw() = 0;
+    };
+
+    // A downsampled copy of a frame, read back from the GPU. 32-bit pixels, with a pitch of 4 * width.
+    struct Thumbnail {
+        std::vector<uint8_t> pixels;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    // Reads small copies of the frames back from the GPU, without ever waiting for the GPU.
+    struct IThumbnailReader {
+        virtual ~IThumbnailReader() = default;
+
+        // Start the copy of a surface. Replaces the previous copy, if it was not read yet.
+        virtual void request(void* surface) = 0;
+        // Get the last requested copy. Returns false until the GPU is done with it, and once it was read.
+        virtual bool read(Thumbnail& thumbnail) = 0;
+        virtual void getAllocations(std::vector<GpuMemory::Allocation>& allocations) const = 0;
+    };
+
+    // The scene, rendering and UI services of the XR framework.
+    struct IRenderer {
+        virtual ~IRenderer() = default;
+
+        virtual Pose getHeadPose() = 0;
+        // The rays of the tracked pointers (eg: hands).
+        virtual void getPointers(std::vector<Ray>& pointers) = 0;
+        virtual double getTime() = 0;
+        virtual void logWarning(const char* message) = 0;
+
+        virtual std::unique_ptr<ITexture> createTexture() = 0;
+        // Draw a region of a texture on a quad, relative to the current UI window.
+        virtual void drawQuad(const ITexture& texture, const Vec3& position, const Vec2& size, const UvRect& uv) = 0;
+        virtual std::unique_ptr<IAtlasPage> createAtlasPage(int32_t width, int32_t height, int64_t format) = 0;
+        virtual std::unique_ptr<IThumbnailReader> createThumbnailReader() = 0;
+
+        virtual void windowBegin(const char* title, Pose& pose, WindowStyle style) = 0;
+        virtual void windowEnd() = 0;
+        virtual void layoutReserve(const Vec2& size) = 0;
+        virtual bool button(const char* text) = 0;
+        virtual bool toggle(const char* text, bool& value) = 0;
+        // Returns true if the value changed.
+        virtual bool hslider(const char* text, float& value, float min, float max) = 0;
+        virtual void label(const char* text) = 0;
+        virtual void sameLine() = 0;
+        virtual void separator() = 0;
+        virtual void setHandsVisible(bool visible) = 0;
+    };
+
+    // The overlay state machine: the window selection menu, the mirrored windows and their lifetime.
+    class SKOverlay {
+      public:
+        SKOverlay(std::shared_ptr<WindowList::IWindowEventSource> windowSource,
+                  std::shared_ptr<Capture::ICaptureSourceFactory> captureFactory,
+                  std::shared_ptr<IRenderer> renderer);
+
+        // Process one frame.
+        void step();
+
+        void addFilter(const std::string& expression);
+
+        // Limit the work done by the overlay, when the application runs out of frame time.
+        void setBudget(const FramePacing::Budget& budget) {
+            m_budget = budget;
+        }
+
+        // Draw the small overlays from shared textures, in a few batches.
+        void setAtlasEnabled(bool enabled) {
+            m_atlasEnabled = enabled;
+        }
+
+        // Limit the rate of the captures across all the overlays.
+        void setCaptureBudget(const CaptureScheduler::Config& config) {
+            m_scheduler = std::make_unique<CaptureScheduler::Scheduler>(config);
+        }
+
+        // Keep the GPU memory of the overlays under a cap, by lowering the resolution of the least important ones or
+        // releasing their capture.
+        void setMemoryBudget(const GpuMemory::Config& config) {
+            m_memoryPolicy = std::make_unique<GpuMemory::Policy>(config);
+        }
+
+        // Re-open the overlays of a profile of the layout file, and start their capture right away. Missing files are
+        // ignored, other errors are logged.
+        void restoreLayout(const std::string& path, const std::string& profile);
+        // Save the current overlays to the profile given to restoreLayout(), leaving the other profiles untouched. The
+        // entries of the profile that matched no window when restoring are kept, unless such an overlay was opened
+        // since.
+        void saveLayout();
+
+        void startTrace(const std::string& path);
+        void writeTrace();
+
+        size_t getOverlayCount() const {
+            return m_windows.size();
+        }
+
+        // GPU memory held by the overlays and the atlas pages, in bytes, as of the last check.
+        uint64_t getMemoryUsage() const {
+            return m_memoryUsage;
+        }
+
+        // In nanoseconds, or 0 until a first frame is shown.
+        uint64_t getTimeToFirstPixel() const {
+            return m_timeToFirstPixel;
+        }
+
+      private:
+        // The capture of a window, monitor or stream, shared by all the overlays showing a region of it. Open as long
+        // as any of them is.
+        struct Session {
+            uint64_t id = 0;
+            WindowList::Handle window = nullptr;
+            WindowList::Handle monitor = nullptr;
+            WindowList::Handle stream = nullptr;
+            std::string title;
+            uint32_t viewCount = 0;
+            std::shared_ptr<Capture::ICaptureSource> captureSource;
+            std::future<std::shared_ptr<Capture::ICaptureSource>> pendingCaptureSource;
+            uint32_t captureAttempts = 0;
+            double nextCaptureAttempt = 0;
+            Capture::FrameBinder frameBinder;
+            std::unique_ptr<ITexture> texture;
+            double lastCaptureTime = 0;
+            // The frames of the overlay in which the capture was last updated (by the first view that asked for it) and
+            // last delivered a new frame.
+            uint64_t updateFrame = 0;
+            uint64_t newFrame = 0;
+            // Whether any view asked for the capture during the current frame.
+            bool isWanted = false;
+            // Set by the scheduler, from the views.
+            float captureInterval = 0;
+            float captureRate = 0;
+            uint64_t scheduledDelivered = 0;
+            float gaze = 0;
+            float apparentSize = 0;
+            bool pinned = false;
+            bool isVisible = false;
+            float importance = 0;
+            GpuMemory::Level memoryLevel = GpuMemory::Level::Full;
+            uint64_t memoryBytes = 0;
+            // Region of an atlas page, when drawn from the atlas.
+            int32_t atlasPage = -1;
+            Atlas::RectPacker::Id atlasRegion = 0;
+            uint64_t atlasGeneration = 0;
+            // The newFrame last copied into the atlas.
+            uint64_t atlasFrame = 0;
+            // The last surface that did not fit, not retried until it changes or another region is released.
+            Capture::SurfaceDesc atlasRejected;
+            uint64_t atlasRejectedReleases = 0;
+            // Finds the borders to trim, for the views that asked for it.
+            std::unique_ptr<IThumbnailReader> thumbnailReader;
+            BorderTrim::Trimmer trimmer;
+            uint64_t nextTrimFrame = 0;
+            // The newFrame last requested from the thumbnail reader.
+            uint64_t trimFrame = 0;
+            bool isTrimWanted = false;
+            bool cleanup = false;
+        };
+
+        // An overlay, showing a region of the capture of its session.
+        struct Window {
+            uint64_t id = 0;
+            uint64_t session = 0;
+            WindowList::Handle window = nullptr;
+            WindowList::Handle monitor = nullptr;
+            WindowList::Handle stream = nullptr;
+            uint32_t view = 0;
+            std::string title;
+            std::string process;
+            UvRect crop;
+            Pose pose;
+            Vec2 extent;
+            float scale = 0.75f;
+            Visibility::State visibility;
+            bool pinned = false;
+            bool decorate = true;
+            bool minimized = false;
+            bool editCrop = false;
+            bool autoTrim = false;
+            bool cleanup = false;
+        };
+
+        // One of the window, the monitor or the stream, and the view of it (0 for sessions and the first overlay).
+        struct WindowKey {
+            WindowList::Handle window = nullptr;
+            WindowList::Handle monitor = nullptr;
+            WindowList::Handle stream = nullptr;
+            uint32_t view = 0;
+
+            bool operator==(const WindowKey& other) const {
+                return window == other.window && monitor == other.monitor && stream == other.stream &&
+                       view == other.view;
+            }
+        };
+
+        struct WindowKeyHash {
+            size_t operator()(const WindowKey& key) const {
+                const std::hash<WindowList::Handle> hash;
+                return hash(key.window) ^ (hash(key.monitor) << 1) ^ (hash(key.stream) << 2) ^
+                       (std::hash<uint32_t>()(key.view) << 3);
+            }
+        };
+
+        struct AvailableWindow {
+            WindowList::Handle window = nullptr;
+            WindowList::Handle monitor = nullptr;
+            WindowList::Handle stream = nullptr;
+            std::string title;
+            std::string process;
+            bool mirrored = false;
+            bool wasMirrored = false;
+        };
+
+        void initializeAvailableMonitors();
+        void refreshAvailableWindows();
+        void refreshAvailableStreams(double now);
+        void handleAvailableWindowsList(std::vector<AvailableWindow>& availableWindows);
+        // Returns the id of the overlay, or 0 if that view is already open.
+        uint64_t openWindow(Window&& newWindow);
+        void closeWindow(uint64_t id);
+        void ensureSessionResources(Session& session, double now);
+        void updateSession(Session& session, const Visibility::Policy& policy, double now);
+        void updateAtlasRegion(Session& session);
+        void releaseAtlasRegion(Session& session);
+        Visibility::Bounds getBounds(const Window& window) const;
+        void scheduleCaptures(const Visibility::Head& head, double now);
+        void balanceMemory();
+        void setMemoryLevel(Session& session, GpuMemory::Level level);
+        void updateTrim(Session& session);
+        void drawCropControls(Window& window);
+        void drawWindows();
+        void drawStatistics();
+
+        const std::shared_ptr<WindowList::IWindowEventSource> m_windowSource;
+        const std::shared_ptr<Capture::ICaptureSourceFactory> m_captureFactory;
+        const std::shared_ptr<IRenderer> m_renderer;
+
+        bool m_minimized = false;
+        Pose m_menuPose{{0.35f, 0, -0.35f}, lookAt({0.35f, 0, -0.35f}, {0, 0, 0})};
+
+        bool m_handsVisible = true;
+        bool m_showStats = false;
+
+        Visibility::Config m_visibilityConfig;
+        FramePacing::Budget m_budget;
+        double m_nextUiRefresh = 0;
+
+        std::unique_ptr<CaptureScheduler::Scheduler> m_scheduler = std::make_unique<CaptureScheduler::Scheduler>();
+        double m_lastSchedule = 0;
+        std::vector<CaptureScheduler::Request> m_captureRequests;
+        std::vector<CaptureScheduler::Allocation> m_captureAllocations;
+        std::vector<Ray> m_pointers;
+
+        std::unique_ptr<GpuMemory::Policy> m_memoryPolicy = std::make_unique<GpuMemory::Policy>();
+        std::vector<GpuMemory::Request> m_memoryRequests;
+        std::vector<GpuMemory::Decision> m_memoryDecisions;
+        std::vector<GpuMemory::Allocation> m_memoryAllocations;
+        // By kind, size and format, as of the last check.
+        std::vector<GpuMemory::Allocation> m_memorySummary;
+        uint64_t m_memoryUsage = 0;
+
+        struct AtlasPage {
+            int64_t format = 0;
+            Atlas::RectPacker packer;
+            std::unique_ptr<IAtlasPage> page;
+            // Incremented when the regions move, so that the overlays copy their surface again.
+            uint64_t generation = 1;
+        };
+
+        bool m_atlasEnabled = false;
+        std::vector<AtlasPage> m_atlasPages;
+        uint64_t m_atlasReleases = 0;
+
+        Pose m_statisticsPose{{0.6f, 0, -0.1f}, lookAt({0.6f, 0, -0.1f}, {0, 0, 0})};
+        Instrumentation::Statistics m_statistics{Instrumentation::getRecorder()};
+        std::string m_tracePath;
+
+        // From the creation of the overlay until a first frame is shown.
+        const uint64_t m_startTime = Instrumentation::now();
+        uint64_t m_timeToFirstPixel = 0;
+
+        std::string m_layoutPath;
+        std::string m_layoutProfile;
+        // The entries of the restored profile that matched no window, eg: of an application that is not running.
+        std::vector<Layout::Entry> m_unmatchedEntries;
+
+        // The window and session ids are the ids of their slot.
+        Utils::SlotMap<WindowKey, Window, WindowKeyHash> m_windows;
+        Utils::SlotMap<WindowKey, Session, WindowKeyHash> m_sessions;
+        uint32_t m_nextView = 1;
+        // Views are only added once done iterating over the overlays.
+        std::vector<uint64_t> m_newViews;
+        uint64_t m_frameNumber = 0;
+        Thumbnail m_thumbnail;
+        std::vector<AvailableWindow> m_availableMonitors;
+        std::vector<AvailableWindow> m_availableStreams;
+        double m_nextStreamRefresh = 0;
+        std::vector<AvailableWindow> m_availableWindows;
+
+        std::unique_ptr<WindowList::WindowEnumerator> m_windowEnumerator;
+        std::shared_ptr<const WindowList::Snapshot> m_windowSnapshot;
+
+        TitleMatcher::Matcher m_filters;
+        TitleMatcher::MatchCache<WindowList::Handle> m_titleMatches;
+
+        // Creating a capture session takes several milliseconds, keep it off the render thread.
+        Utils::WorkerPool m_captureWorkers{2};
+    };
+
+} // namespace Overlay
@@ -0,0 +1,519 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "pixel_kernels.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PIXEL_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+    using namespace PixelKernels;
+
+    // Round(value / 255) for value in [0, 255 * 255].
+    inline uint32_t divide255(uint32_t value) {
+        value += 128;
+        return (value + (value >> 8)) >> 8;
+    }
+
+    void swizzleScalar(const uint8_t* source, uint8_t* destination, size_t pixels) {
+        for (size_t i = 0; i < pixels; i++) {
+            const uint8_t b = source[4 * i + 0];
+            const uint8_t r = source[4 * i + 2];
+            destination[4 * i + 0] = r;
+            destination[4 * i + 1] = source[4 * i + 1];
+            destination[4 * i + 2] = b;
+            destination[4 * i + 3] = source[4 * i + 3];
+        }
+    }
+
+    void fixAlphaScalar(uint8_t* pixels, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            pixels[4 * i + 3] = 255;
+        }
+    }
+
+    void premultiplyScalar(uint8_t* pixels, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const uint32_t alpha = pixels[4 * i + 3];
+            for (size_t c = 0; c < 3; c++) {
+                pixels[4 * i + c] = static_cast<uint8_t>(divide255(pixels[4 * i + c] * alpha));
+            }
+        }
+    }
+
+    void downscale2xRowScalar(const uint8_t* row0,
+                              const uint8_t* row1,
+                              uint8_t* destination,
+                              int32_t from,
+                              int32_t to) {
+        for (int32_t x = from; x < to; x++) {
+            for (int32_t c = 0; c < 4; c++) {
+                const uint32_t sum =
+                    row0[8 * x + c] + row0[8 * x + 4 + c] + row1[8 * x + c] + row1[8 * x + 4 + c];
+                destination[4 * x + c] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+
+    void downscale2xScalar(const uint8_t* source,
+                           size_t sourcePitch,
+                           int32_t sourceWidth,
+                           int32_t sourceHeight,
+                           uint8_t* destination,
+                           size_t destinationPitch) {
+        for (int32_t y = 0; y < sourceHeight / 2; y++) {
+            const uint8_t* row0 = source + 2 * y * sourcePitch;
+            downscale2xRowScalar(row0, row0 + sourcePitch, destination + y * destinationPitch, 0, sourceWidth / 2);
+        }
+    }
+
+    inline bool isContent(uint32_t pixel, uint32_t background, uint32_t mask, uint8_t tolerance) {
+        for (int32_t shift = 0; shift < 32; shift += 8) {
+            const int32_t difference =
+                static_cast<int32_t>((pixel >> shift) & 0xFF) - static_cast<int32_t>((background >> shift) & 0xFF);
+            if (((mask >> shift) & 0xFF) && std::abs(difference) > tolerance) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Finds the content of a row from either end. Each instruction set provides its own scanner.
+    struct ContentScannerScalar {
+        uint32_t background;
+        uint32_t mask;
+        uint8_t tolerance;
+
+        bool isContentAt(const uint8_t* row, int32_t x) const {
+            uint32_t pixel;
+            memcpy(&pixel, row + 4 * x, sizeof(pixel));
+            return isContent(pixel, background, mask, tolerance);
+        }
+
+        // The first pixel of content in [from, to), or to if there is none.
+        int32_t findFirst(const uint8_t* row, int32_t from, int32_t to) const {
+            for (int32_t x = from; x < to; x++) {
+                if (isContentAt(row, x)) {
+                    return x;
+                }
+            }
+            return to;
+        }
+
+        // The last pixel of content in [from, to), or from - 1 if there is none.
+        int32_t findLast(const uint8_t* row, int32_t from, int32_t to) const {
+            for (int32_t x = to - 1; x >= from; x--) {
+                if (isContentAt(row, x)) {
+                    return x;
+                }
+            }
+            return from - 1;
+        }
+    };
+
+    template <typename Scanner>
+    Bounds findContentBoundsRows(const uint8_t* pixels,
+                                 size_t pitch,
+                                 int32_t width,
+                                 int32_t height,
+                                 const Scanner& scanner) {
+        int32_t left = width;
+        int32_t right = 0;
+        int32_t top = height;
+        int32_t bottom = 0;
+        for (int32_t y = 0; y < height; y++) {
+            const uint8_t* row = pixels + y * pitch;
+            const int32_t first = scanner.findFirst(row, 0, width);
+            if (first == width) {
+                continue;
+            }
+            // Only the content past the right edge found so far can move it.
+            const int32_t last = scanner.findLast(row, std::max(first, right), width);
+            left = std::min(left, first);
+            right = std::max(right, last + 1);
+            top = std::min(top, y);
+            bottom = y + 1;
+        }
+        if (!bottom) {
+            return {};
+        }
+        return {left, top, right - left, bottom - top};
+    }
+
+    Bounds findContentBoundsScalar(const uint8_t* pixels,
+                                   size_t pitch,
+                                   int32_t width,
+                                   int32_t height,
+                                   uint32_t background,
+                                   uint32_t mask,
+                                   uint8_t tolerance) {
+        return findContentBoundsRows(pixels, pitch, width, height, ContentScannerScalar{background, mask, tolerance});
+    }
+
+    inline int32_t getLowestBit(uint32_t bits) {
+        int32_t index = 0;
+        while (!((bits >> index) & 1)) {
+            index++;
+        }
+        return index;
+    }
+
+    inline int32_t getHighestBit(uint32_t bits) {
+        int32_t index = 31;
+        while (!((bits >> index) & 1)) {
+            index--;
+        }
+        return index;
+    }
+
+#ifdef PIXEL_KERNELS_X86
+    // SSE2 has no byte shuffle, swap the red and blue channels with shifts.
+    void swizzleSSE2(const uint8_t* source, uint8_t* destination, size_t pixels) {
+        const __m128i greenAlpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+        const __m128i low = _mm_set1_epi32(0xFF);
+        size_t i = 0;
+        for (; i + 4 <= pixels; i += 4) {
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * i));
+            const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+            const __m128i b = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 4 * i),
+                             _mm_or_si128(_mm_and_si128(p, greenAlpha), _mm_or_si128(r, b)));
+        }
+        swizzleScalar(source + 4 * i, destination + 4 * i, pixels - i);
+    }
+
+    void fixAlphaSSE2(uint8_t* pixels, size_t count) {
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i* p = reinterpret_cast<__m128i*>(pixels + 4 * i);
+            _mm_storeu_si128(p, _mm_or_si128(_mm_loadu_si128(p), alpha));
+        }
+        fixAlphaScalar(pixels + 4 * i, count - i);
+    }
+
+    // Premultiply 2 pixels widened to 16 bits, leaving the alpha untouched.
+    inline __m128i premultiply16(__m128i p, __m128i alphaMask) {
+        const __m128i alpha =
+            _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(p, alpha), _mm_set1_epi16(128));
+        t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        return _mm_or_si128(_mm_andnot_si128(alphaMask, t), _mm_and_si128(alphaMask, p));
+    }
+
+    void premultiplySSE2(uint8_t* pixels, size_t count) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i* p = reinterpret_cast<__m128i*>(pixels + 4 * i);
+            const __m128i v = _mm_loadu_si128(p);
+            const __m128i lo = premultiply16(_mm_unpacklo_epi8(v, zero), alphaMask);
+            const __m128i hi = premultiply16(_mm_unpackhi_epi8(v, zero), alphaMask);
+            _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+        }
+        premultiplyScalar(pixels + 4 * i, count - i);
+    }
+
+    void downscale2xSSE2(const uint8_t* source,
+                         size_t sourcePitch,
+                         int32_t sourceWidth,
+                         int32_t sourceHeight,
+                         uint8_t* destination,
+                         size_t destinationPitch) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+        const int32_t width = sourceWidth / 2;
+        for (int32_t y = 0; y < sourceHeight / 2; y++) {
+            const uint8_t* row0 = source + 2 * y * sourcePitch;
+            const uint8_t* row1 = row0 + sourcePitch;
+            uint8_t* output = destination + y * destinationPitch;
+
+            // 4 source pixels from each row make 2 destination pixels.
+            int32_t x = 0;
+            for (; x + 2 <= width; x += 2) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+                const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                const __m128i sum = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)),
+                                                       _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+                const __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(output + 4 * x), _mm_packus_epi16(average, average));
+            }
+            downscale2xRowScalar(row0, row1, output, x, width);
+        }
+    }
+
+    // 4 pixels at a time: one bit per pixel that differs from the background by more than the tolerance.
+    struct ContentScannerSSE2 {
+        ContentScannerScalar scalar;
+
+        uint32_t getContentBits(const uint8_t* pixels) const {
+            const __m128i background = _mm_set1_epi32(static_cast<int>(scalar.background));
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+            const __m128i difference = _mm_or_si128(_mm_subs_epu8(v, background), _mm_subs_epu8(background, v));
+            const __m128i excess = _mm_and_si128(_mm_subs_epu8(difference, _mm_set1_epi8(scalar.tolerance)),
+                                                 _mm_set1_epi32(static_cast<int>(scalar.mask)));
+            const __m128i isBackground = _mm_cmpeq_epi32(excess, _mm_setzero_si128());
+            return ~_mm_movemask_ps(_mm_castsi128_ps(isBackground)) & 0xF;
+        }
+
+        int32_t findFirst(const uint8_t* row, int32_t from, int32_t to) const {
+            int32_t x = from;
+            for (; x + 4 <= to; x += 4) {
+                if (const uint32_t bits = getContentBits(row + 4 * x)) {
+                    return x + getLowestBit(bits);
+                }
+            }
+            return scalar.findFirst(row, x, to);
+        }
+
+        int32_t findLast(const uint8_t* row, int32_t from, int32_t to) const {
+            int32_t x = to;
+            for (; x - 4 >= from; x -= 4) {
+                if (const uint32_t bits = getContentBits(row + 4 * (x - 4))) {
+                    return x - 4 + getHighestBit(bits);
+                }
+            }
+            return scalar.findLast(row, from, x);
+        }
+    };
+
+    Bounds findContentBoundsSSE2(const uint8_t* pixels,
+                                 size_t pitch,
+                                 int32_t width,
+                                 int32_t height,
+                                 uint32_t background,
+                                 uint32_t mask,
+                                 uint8_t tolerance) {
+        return findContentBoundsRows(pixels, pitch, width, height, ContentScannerSSE2{{background, mask, tolerance}});
+    }
+
+    TARGET_AVX2 void swizzleAVX2(const uint8_t* source, uint8_t* destination, size_t pixels) {
+        const __m256i shuffle = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8) {
+            const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 4 * i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + 4 * i), _mm256_shuffle_epi8(p, shuffle));
+        }
+        swizzleScalar(source + 4 * i, destination + 4 * i, pixels - i);
+    }
+
+    TARGET_AVX2 void fixAlphaAVX2(uint8_t* pixels, size_t count) {
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i* p = reinterpret_cast<__m256i*>(pixels + 4 * i);
+            _mm256_storeu_si256(p, _mm256_or_si256(_mm256_loadu_si256(p), alpha));
+        }
+        fixAlphaScalar(pixels + 4 * i, count - i);
+    }
+
+    TARGET_AVX2 inline __m256i premultiply16AVX2(__m256i p, __m256i alphaMask) {
+        const __m256i alpha =
+            _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(p, alpha), _mm256_set1_epi16(128));
+        t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+        return _mm256_blendv_epi8(t, p, alphaMask);
+    }
+
+    TARGET_AVX2 void premultiplyAVX2(uint8_t* pixels, size_t count) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i alphaMask =
+            _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i* p = reinterpret_cast<__m256i*>(pixels + 4 * i);
+            const __m256i v = _mm256_loadu_si256(p);
+            // The unpacks and the pack operate within each 128-bit lane, so the pixel order is preserved.
+            const __m256i lo = premultiply16AVX2(_mm256_unpacklo_epi8(v, zero), alphaMask);
+            const __m256i hi = premultiply16AVX2(_mm256_unpackhi_epi8(v, zero), alphaMask);
+            _mm256_storeu_si256(p, _mm256_packus_epi16(lo, hi));
+        }
+        premultiplyScalar(pixels + 4 * i, count - i);
+    }
+
+    TARGET_AVX2 void downscale2xAVX2(const uint8_t* source,
+                                     size_t sourcePitch,
+                                     int32_t sourceWidth,
+                                     int32_t sourceHeight,
+                                     uint8_t* destination,
+                                     size_t destinationPitch) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i rounding = _mm256_set1_epi16(2);
+        const int32_t width = sourceWidth / 2;
+        for (int32_t y = 0; y < sourceHeight / 2; y++) {
+            const uint8_t* row0 = source + 2 * y * sourcePitch;
+            const uint8_t* row1 = row0 + sourcePitch;
+            uint8_t* output = destination + y * destinationPitch;
+
+            // 8 source pixels from each row make 4 destination pixels. Each 128-bit lane is processed like SSE2.
+            int32_t x = 0;
+            for (; x + 4 <= width; x += 4) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 8 * x));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 8 * x));
+                const __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+                const __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+                const __m256i sum = _mm256_unpacklo_epi64(_mm256_add_epi16(lo, _mm256_srli_si256(lo, 8)),
+                                                          _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8)));
+                const __m256i average = _mm256_srli_epi16(_mm256_add_epi16(sum, rounding), 2);
+                const __m256i packed =
+                    _mm256_permute4x64_epi64(_mm256_packus_epi16(average, average), _MM_SHUFFLE(3, 1, 2, 0));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4 * x), _mm256_castsi256_si128(packed));
+            }
+            downscale2xRowScalar(row0, row1, output, x, width);
+        }
+    }
+
+    // The rows are scanned with AVX2, the loop over the rows is shared with the other instruction sets.
+    struct ContentScannerAVX2 {
+        ContentScannerScalar scalar;
+
+        TARGET_AVX2 uint32_t getContentBits(const uint8_t* pixels) const {
+            const __m256i background = _mm256_set1_epi32(static_cast<int>(scalar.background));
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels));
+            const __m256i difference =
+                _mm256_or_si256(_mm256_subs_epu8(v, background), _mm256_subs_epu8(background, v));
+            const __m256i excess = _mm256_and_si256(_mm256_subs_epu8(difference, _mm256_set1_epi8(scalar.tolerance)),
+                                                    _mm256_set1_epi32(static_cast<int>(scalar.mask)));
+            const __m256i isBackground = _mm256_cmpeq_epi32(excess, _mm256_setzero_si256());
+            return ~_mm256_movemask_ps(_mm256_castsi256_ps(isBackground)) & 0xFF;
+        }
+
+        TARGET_AVX2 int32_t findFirst(const uint8_t* row, int32_t from, int32_t to) const {
+            int32_t x = from;
+            for (; x + 8 <= to; x += 8) {
+                if (const uint32_t bits = getContentBits(row + 4 * x)) {
+                    return x + getLowestBit(bits);
+                }
+            }
+            return scalar.findFirst(row, x, to);
+        }
+
+        TARGET_AVX2 int32_t findLast(const uint8_t* row, int32_t from, int32_t to) const {
+            int32_t x = to;
+            for (; x - 8 >= from; x -= 8) {
+                if (const uint32_t bits = getContentBits(row + 4 * (x - 8))) {
+                    return x - 8 + getHighestBit(bits);
+                }
+            }
+            return scalar.findLast(row, from, x);
+        }
+    };
+
+    Bounds findContentBoundsAVX2(const uint8_t* pixels,
+                                 size_t pitch,
+                                 int32_t width,
+                                 int32_t height,
+                                 uint32_t background,
+                                 uint32_t mask,
+                                 uint8_t tolerance) {
+        return findContentBoundsRows(pixels, pitch, width, height, ContentScannerAVX2{{background, mask, tolerance}});
+    }
+
+    bool isAVX2Supported() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool osxsave = info[2] & (1 << 27);
+        const bool avx = info[2] & (1 << 28);
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return info[1] & (1 << 5);
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    const Kernels ScalarKernels{
+        Isa::Scalar, swizzleScalar, fixAlphaScalar, premultiplyScalar, downscale2xScalar, findContentBoundsScalar};
+#ifdef PIXEL_KERNELS_X86
+    const Kernels SSE2Kernels{
+        Isa::SSE2, swizzleSSE2, fixAlphaSSE2, premultiplySSE2, downscale2xSSE2, findContentBoundsSSE2};
+    const Kernels AVX2Kernels{
+        Isa::AVX2, swizzleAVX2, fixAlphaAVX2, premultiplyAVX2, downscale2xAVX2, findContentBoundsAVX2};
+#endif
+
+} // namespace
+
+namespace PixelKernels {
+
+    Isa getBestIsa() {
+#ifdef PIXEL_KERNELS_X86
+        static const Isa best = isAVX2Supported() ? Isa::AVX2 : Isa::SSE2;
+        return best;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    const Kernels& getKernels(Isa isa) {
+        isa = std::min(isa, getBestIsa());
+#ifdef PIXEL_KERNELS_X86
+        switch (isa) {
+        case Isa::AVX2:
+            return AVX2Kernels;
+        case Isa::SSE2:
+            return SSE2Kernels;
+        default:
+            break;
+        }
+#endif
+        return ScalarKernels;
+    }
+
+    const char* toString(Isa isa) {
+        switch (isa) {
+        case Isa::Scalar:
+            return "Scalar";
+        case Isa::SSE2:
+            return "SSE2";
+        case Isa::AVX2:
+            return "AVX2";
+        }
+        return "";
+    }
+
+} // namespace PixelKernels
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PixelKernels {
+
+    enum class Isa {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    struct Bounds {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    // Conversion and analysis kernels for 32-bit pixels. All the variants of a kernel produce exactly the same output. Buffers do
+    // not need to be aligned.
+    struct Kernels {
+        Isa isa;
+
+        // BGRA to RGBA (or the opposite). The source and destination may be the same.
+        void (*swizzle)(const uint8_t* source, uint8_t* destination, size_t pixels);
+        // Make all pixels opaque, for surfaces that leave the alpha undefined (GDI).
+        void (*fixAlpha)(uint8_t* pixels, size_t count);
+        // Multiply the color by the alpha, rounded to nearest.
+        void (*premultiply)(uint8_t* pixels, size_t count);
+        // Average each 2x2 block of pixels, rounded to nearest. The odd last column and row are dropped.
+        void (*downscale2x)(const uint8_t* source,
+                            size_t sourcePitch,
+                            int32_t sourceWidth,
+                            int32_t sourceHeight,
+                            uint8_t* destination,
+                            size_t destinationPitch);
+        // The smallest rectangle holding the pixels that differ from the background by more than the tolerance, on any
+        // channel of the mask (eg: only the alpha for a transparent background). The background and the mask are
+        // pixels, as laid out in memory. Empty (0x0) when the frame is only background.
+        Bounds (*findContentBounds)(const uint8_t* pixels,
+                                    size_t pitch,
+                                    int32_t width,
+                                    int32_t height,
+                                    uint32_t background,
+                                    uint32_t mask,
+                                    uint8_t tolerance);
+    };
+
+    // The best instruction set supported by the processor.
+    Isa getBestIsa();
+
+    // The kernels for an instruction set. Falls back to the best supported instruction set below the one requested.
+    const Kernels& getKernels(Isa isa = getBestIsa());
+
+    const char* toString(Isa isa);
+
+} // namespace PixelKernels
@@ -0,0 +1,559 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "recording.h"
+
+namespace {
+
+    using namespace Recording;
+
+    constexpr uint32_t ChunkMagic = 0x454d5246; // "FRME"
+    constexpr uint32_t KeyframeFlag = 1;
+    // Keyframes bound the damage of a corrupted chunk.
+    constexpr uint64_t KeyframeInterval = 300;
+    constexpr uint32_t MaxDimension = 16384;
+    constexpr uint32_t BytesPerPixel = 4;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    constexpr size_t MinMatch = 4;
+    constexpr size_t MaxOffset = 65535;
+    constexpr int HashBits = 14;
+
+    uint32_t read32(const uint8_t* pointer) {
+        uint32_t value;
+        memcpy(&value, pointer, sizeof(value));
+        return value;
+    }
+
+    uint8_t* writeLength(uint8_t* output, size_t length) {
+        while (length >= 255) {
+            *output++ = 255;
+            length -= 255;
+        }
+        *output++ = static_cast<uint8_t>(length);
+        return output;
+    }
+
+    // A sequence is a token (the literal length in the high nibble, the match length minus 4 in the low nibble, 15
+    // meaning that more length bytes follow), the literals, then the offset and the rest of the match length. The last
+    // sequence only has literals.
+    uint8_t* writeSequence(
+        uint8_t* output, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+        uint8_t* token = output++;
+        *token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15) {
+            output = writeLength(output, literalLength - 15);
+        }
+        memcpy(output, literals, literalLength);
+        output += literalLength;
+
+        if (matchLength) {
+            *output++ = static_cast<uint8_t>(offset);
+            *output++ = static_cast<uint8_t>(offset >> 8);
+            const size_t length = matchLength - MinMatch;
+            *token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+            if (length >= 15) {
+                output = writeLength(output, length - 15);
+            }
+        }
+        return output;
+    }
+
+    void corrupted() {
+        throw std::runtime_error("Corrupted recording");
+    }
+
+    size_t readLength(const uint8_t*& input, const uint8_t* end, size_t length) {
+        if (length != 15) {
+            return length;
+        }
+        uint8_t byte;
+        do {
+            if (input == end) {
+                corrupted();
+            }
+            byte = *input++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    }
+
+    DirtyRects::Rect unite(const DirtyRects::Rect& a, const DirtyRects::Rect& b) {
+        if (!a.area()) {
+            return b;
+        }
+        if (!b.area()) {
+            return a;
+        }
+        const int32_t left = std::min(a.x, b.x);
+        const int32_t top = std::min(a.y, b.y);
+        const int32_t right = std::max(a.x + a.width, b.x + b.width);
+        const int32_t bottom = std::max(a.y + a.height, b.y + b.height);
+        return {left, top, right - left, bottom - top};
+    }
+
+} // namespace
+
+namespace Recording {
+
+    size_t getMaxCompressedSize(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    size_t compress(const uint8_t* source, size_t size, uint8_t* destination) {
+        uint8_t* output = destination;
+        const uint8_t* anchor = source;
+
+        if (size > MinMatch) {
+            std::vector<uint32_t> table(size_t{1} << HashBits);
+            size_t position = 0;
+            while (position + MinMatch <= size) {
+                const uint32_t sequence = read32(source + position);
+                const uint32_t hash = (sequence * 2654435761u) >> (32 - HashBits);
+                const size_t candidate = table[hash];
+                table[hash] = static_cast<uint32_t>(position);
+
+                if (candidate < position && position - candidate <= MaxOffset &&
+                    read32(source + candidate) == sequence) {
+                    size_t length = MinMatch;
+                    while (position + length < size && source[candidate + length] == source[position + length]) {
+                        length++;
+                    }
+                    output = writeSequence(
+                        output, anchor, source + position - anchor, position - candidate, length);
+                    position += length;
+                    anchor = source + position;
+                } else {
+                    // Move faster through data that does not compress.
+                    position += 1 + ((source + position - anchor) >> 6);
+                }
+            }
+        }
+
+        output = writeSequence(output, anchor, source + size - anchor, 0, 0);
+        return output - destination;
+    }
+
+    void decompress(const uint8_t* source, size_t compressedSize, uint8_t* destination, size_t size) {
+        const uint8_t* input = source;
+        const uint8_t* const inputEnd = source + compressedSize;
+        uint8_t* output = destination;
+        uint8_t* const outputEnd = destination + size;
+
+        while (true) {
+            if (input == inputEnd) {
+                corrupted();
+            }
+            const uint8_t token = *input++;
+
+            const size_t literalLength = readLength(input, inputEnd, token >> 4);
+            if (literalLength > static_cast<size_t>(inputEnd - input) ||
+                literalLength > static_cast<size_t>(outputEnd - output)) {
+                corrupted();
+            }
+            memcpy(output, input, literalLength);
+            input += literalLength;
+            output += literalLength;
+
+            if (input == inputEnd) {
+                break;
+            }
+
+            if (inputEnd - input < 2) {
+                corrupted();
+            }
+            const size_t offset = input[0] | (input[1] << 8);
+            input += 2;
+            const size_t matchLength = readLength(input, inputEnd, token & 15) + MinMatch;
+            if (!offset || offset > static_cast<size_t>(output - destination) ||
+                matchLength > static_cast<size_t>(outputEnd - output)) {
+                corrupted();
+            }
+
+            // The match may overlap the output, eg: a run of the same byte.
+            const uint8_t* match = output - offset;
+            if (offset >= matchLength) {
+                memcpy(output, match, matchLength);
+                output += matchLength;
+            } else {
+                for (size_t i = 0; i < matchLength; i++) {
+                    *output++ = *match++;
+                }
+            }
+        }
+
+        if (output != outputEnd) {
+            corrupted();
+        }
+    }
+
+    Recorder::Recorder(const std::string& path, size_t maxQueuedBytes) : m_maxQueuedBytes(maxQueuedBytes) {
+        m_file = fopen(path.c_str(), "wb");
+        if (!m_file) {
+            throw std::runtime_error("Failed to create " + path);
+        }
+        const FileHeader header{Magic, Version};
+        fwrite(&header, sizeof(header), 1, m_file);
+
+        m_thread = std::thread([this] { threadMain(); });
+    }
+
+    Recorder::~Recorder() {
+        {
+            std::unique_lock lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        m_thread.join();
+        fclose(m_file);
+    }
+
+    bool Recorder::addFrame(uint64_t timestamp,
+                            uint32_t width,
+                            uint32_t height,
+                            uint32_t pitch,
+                            uint32_t format,
+                            const uint8_t* pixels) {
+        const size_t rowSize = static_cast<size_t>(width) * BytesPerPixel;
+        const size_t size = rowSize * height;
+
+        QueuedFrame frame{timestamp, width, height, format, {}};
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_queuedBytes + size > m_maxQueuedBytes) {
+                m_stats.dropped++;
+                return false;
+            }
+            m_queuedBytes += size;
+            if (!m_freeBuffers.empty()) {
+                frame.pixels = std::move(m_freeBuffers.back());
+                m_freeBuffers.pop_back();
+            }
+        }
+
+        frame.pixels.resize(size);
+        for (uint32_t y = 0; y < height; y++) {
+            memcpy(frame.pixels.data() + y * rowSize, pixels + static_cast<size_t>(y) * pitch, rowSize);
+        }
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_queue.push_back(std::move(frame));
+        }
+        m_wakeUp.notify_one();
+        return true;
+    }
+
+    void Recorder::flush() {
+        std::unique_lock lock(m_mutex);
+        m_written.wait(lock, [&] { return m_queuedBytes == 0; });
+        fflush(m_file);
+    }
+
+    RecorderStats Recorder::getStats() const {
+        std::unique_lock lock(m_mutex);
+        return m_stats;
+    }
+
+    void Recorder::threadMain() {
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            m_wakeUp.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                // Stopping, and everything was written.
+                break;
+            }
+
+            QueuedFrame frame = std::move(m_queue.front());
+            m_queue.pop_front();
+
+            lock.unlock();
+            writeFrame(frame);
+            lock.lock();
+
+            m_queuedBytes -= frame.pixels.size();
+            m_freeBuffers.push_back(std::move(frame.pixels));
+            m_written.notify_all();
+        }
+    }
+
+    void Recorder::writeFrame(const QueuedFrame& frame) {
+        const size_t rowSize = static_cast<size_t>(frame.width) * BytesPerPixel;
+        const bool isKeyframe = m_previous.empty() || frame.width != m_previousWidth ||
+                                frame.height != m_previousHeight || frame.format != m_previousFormat ||
+                                m_framesSinceKeyframe >= KeyframeInterval;
+        if (m_previous.empty()) {
+            m_firstTimestamp = frame.timestamp;
+        }
+
+        ChunkHeader header{};
+        header.magic = ChunkMagic;
+        header.timestamp = frame.timestamp - m_firstTimestamp;
+        header.width = frame.width;
+        header.height = frame.height;
+        header.format = frame.format;
+
+        const uint8_t* payload = frame.pixels.data();
+        if (isKeyframe) {
+            header.flags = KeyframeFlag;
+            header.dirty = {0, 0, static_cast<int32_t>(frame.width), static_cast<int32_t>(frame.height)};
+            header.rawSize = static_cast<uint32_t>(frame.pixels.size());
+            m_previous = frame.pixels;
+            m_previousWidth = frame.width;
+            m_previousHeight = frame.height;
+            m_previousFormat = frame.format;
+            m_framesSinceKeyframe = 0;
+        } else {
+            // Bounds of the pixels that changed.
+            const auto changed = [&](uint32_t y) {
+                return memcmp(frame.pixels.data() + y * rowSize, m_previous.data() + y * rowSize, rowSize) != 0;
+            };
+            uint32_t top = 0;
+            while (top < frame.height && !changed(top)) {
+                top++;
+            }
+            uint32_t bottom = frame.height;
+            while (bottom > top && !changed(bottom - 1)) {
+                bottom--;
+            }
+            uint32_t left = frame.width;
+            uint32_t right = 0;
+            for (uint32_t y = top; y < bottom; y++) {
+                const uint8_t* current = frame.pixels.data() + y * rowSize;
+                const uint8_t* previous = m_previous.data() + y * rowSize;
+                const auto differs = [&](uint32_t x) {
+                    return read32(current + x * BytesPerPixel) != read32(previous + x * BytesPerPixel);
+                };
+                uint32_t x = 0;
+                while (x < left && !differs(x)) {
+                    x++;
+                }
+                left = std::min(left, x);
+                x = frame.width;
+                while (x > right && !differs(x - 1)) {
+                    x--;
+                }
+                right = std::max(right, x);
+            }
+            if (top == bottom) {
+                left = right = 0;
+            }
+            header.dirty = {static_cast<int32_t>(left),
+                            static_cast<int32_t>(top),
+                            static_cast<int32_t>(right - left),
+                            static_cast<int32_t>(bottom - top)};
+
+            // XOR the dirty rectangle with the previous frame, which leaves mostly zeros, then bring the previous
+            // frame up-to-date.
+            const size_t dirtyRowSize = static_cast<size_t>(right - left) * BytesPerPixel;
+            m_delta.resize(dirtyRowSize * (bottom - top));
+            for (uint32_t y = top; y < bottom; y++) {
+                const size_t offset = y * rowSize + left * BytesPerPixel;
+                const uint8_t* current = frame.pixels.data() + offset;
+                uint8_t* previous = m_previous.data() + offset;
+                uint8_t* delta = m_delta.data() + (y - top) * dirtyRowSize;
+                for (size_t i = 0; i < dirtyRowSize; i++) {
+                    delta[i] = current[i] ^ previous[i];
+                }
+                memcpy(previous, current, dirtyRowSize);
+            }
+            header.rawSize = static_cast<uint32_t>(m_delta.size());
+            payload = m_delta.data();
+            m_framesSinceKeyframe++;
+        }
+
+        m_compressed.resize(getMaxCompressedSize(header.rawSize));
+        header.compressedSize = static_cast<uint32_t>(compress(payload, header.rawSize, m_compressed.data()));
+        fwrite(&header, sizeof(header), 1, m_file);
+        fwrite(m_compressed.data(), 1, header.compressedSize, m_file);
+
+        std::unique_lock lock(m_mutex);
+        m_stats.frames++;
+        m_stats.rawBytes += frame.pixels.size();
+        m_stats.writtenBytes += sizeof(header) + header.compressedSize;
+    }
+
+    Reader::Reader(const std::string& path) {
+        m_file = fopen(path.c_str(), "rb");
+        if (!m_file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        FileHeader header{};
+        if (fread(&header, sizeof(header), 1, m_file) != 1 || header.magic != Magic) {
+            fclose(m_file);
+            throw std::runtime_error("Not a recording: " + path);
+        }
+        if (header.version != Version) {
+            fclose(m_file);
+            throw std::runtime_error("Unsupported recording version " + std::to_string(header.version));
+        }
+        m_dataOffset = ftell(m_file);
+    }
+
+    Reader::~Reader() {
+        fclose(m_file);
+    }
+
+    bool Reader::readHeader() {
+        if (m_hasHeader) {
+            return true;
+        }
+        // A truncated chunk (eg: the application was killed while recording) ends the recording.
+        if (fread(&m_header, sizeof(m_header), 1, m_file) != 1) {
+            return false;
+        }
+        m_hasHeader = true;
+        return true;
+    }
+
+    bool Reader::peekTimestamp(uint64_t& timestamp) {
+        if (!readHeader()) {
+            return false;
+        }
+        timestamp = m_header.timestamp;
+        return true;
+    }
+
+    bool Reader::next(Frame& frame) {
+        if (!readHeader()) {
+            return false;
+        }
+        m_hasHeader = false;
+
+        const ChunkHeader& header = m_header;
+        const bool isKeyframe = header.flags & KeyframeFlag;
+        const DirtyRects::Rect& dirty = header.dirty;
+        if (header.magic != ChunkMagic || header.width > MaxDimension || header.height > MaxDimension ||
+            dirty.x < 0 || dirty.y < 0 || dirty.width < 0 || dirty.height < 0 ||
+            static_cast<uint32_t>(dirty.x + dirty.width) > header.width ||
+            static_cast<uint32_t>(dirty.y + dirty.height) > header.height ||
+            header.rawSize != dirty.area() * BytesPerPixel ||
+            (isKeyframe && header.rawSize != header.width * header.height * BytesPerPixel) ||
+            (!isKeyframe && (header.width != m_width || header.height != m_height)) ||
+            header.compressedSize > getMaxCompressedSize(header.rawSize)) {
+            corrupted();
+        }
+
+        m_compressed.resize(header.compressedSize);
+        if (fread(m_compressed.data(), 1, header.compressedSize, m_file) != header.compressedSize) {
+            return false;
+        }
+
+        const size_t rowSize = static_cast<size_t>(header.width) * BytesPerPixel;
+        if (isKeyframe) {
+            m_pixels.resize(header.rawSize);
+            decompress(m_compressed.data(), header.compressedSize, m_pixels.data(), header.rawSize);
+            m_width = header.width;
+            m_height = header.height;
+        } else {
+            m_delta.resize(header.rawSize);
+            decompress(m_compressed.data(), header.compressedSize, m_delta.data(), header.rawSize);
+            const size_t dirtyRowSize = static_cast<size_t>(dirty.width) * BytesPerPixel;
+            for (int32_t y = 0; y < dirty.height; y++) {
+                uint8_t* pixels = m_pixels.data() + (dirty.y + y) * rowSize + dirty.x * BytesPerPixel;
+                const uint8_t* delta = m_delta.data() + y * dirtyRowSize;
+                for (size_t i = 0; i < dirtyRowSize; i++) {
+                    pixels[i] ^= delta[i];
+                }
+            }
+        }
+
+        frame.timestamp = header.timestamp;
+        frame.width = header.width;
+        frame.height = header.height;
+        frame.pitch = static_cast<uint32_t>(rowSize);
+        frame.format = header.format;
+        frame.dirty = dirty;
+        frame.pixels = m_pixels.data();
+        return true;
+    }
+
+    void Reader::rewind() {
+        fseek(m_file, m_dataOffset, SEEK_SET);
+        m_hasHeader = false;
+        m_width = m_height = 0;
+    }
+
+    Player::Player(const std::string& path, bool isRealTime) : m_reader(path), m_isRealTime(isRealTime) {
+    }
+
+    const Frame* Player::update(uint64_t now) {
+        if (!m_started) {
+            m_started = true;
+            m_startTime = now;
+        }
+
+        bool updated = false;
+        DirtyRects::Rect dirty;
+        while (true) {
+            uint64_t timestamp;
+            if (!m_reader.peekTimestamp(timestamp)) {
+                if (!m_hasFrame) {
+                    // Nothing to play.
+                    return nullptr;
+                }
+                // Loop.
+                m_reader.rewind();
+                m_startTime = now;
+                if (updated) {
+                    break;
+                }
+                continue;
+            }
+            if (m_isRealTime ? m_startTime + timestamp > now : updated) {
+                break;
+            }
+
+            if (!m_reader.next(m_frame)) {
+                // Truncated, loop.
+                m_reader.rewind();
+                m_startTime = now;
+                if (!m_hasFrame || updated) {
+                    break;
+                }
+                continue;
+            }
+            m_hasFrame = true;
+            dirty = unite(dirty, m_frame.dirty);
+            updated = true;
+        }
+        if (!updated) {
+            return nullptr;
+        }
+
+        // The size may have changed between the frames.
+        const int32_t right = std::min(dirty.x + dirty.width, static_cast<int32_t>(m_frame.width));
+        const int32_t bottom = std::min(dirty.y + dirty.height, static_cast<int32_t>(m_frame.height));
+        m_frame.dirty = {dirty.x, dirty.y, std::max(right - dirty.x, 0), std::max(bottom - dirty.y, 0)};
+        return &m_frame;
+    }
+
+} // namespace Recording
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dirty_rects.h"
+
+// Recordings of the frames of an overlay, to replay a session offline.
+//
+// A recording is a header followed by one chunk per frame. Each chunk holds the timestamp, the size, the format and
+// the dirty rectangle of the frame, followed by the pixels: the whole frame for keyframes, otherwise the dirty
+// rectangle XOR-ed with the previous frame. The pixels are LZ-compressed. Pixels are 4 bytes, the format is opaque.
+namespace Recording {
+
+    constexpr uint32_t Magic = 0x43524b53; // "SKRC"
+    constexpr uint32_t Version = 1;
+
+    // LZ77 compression of a block, in the spirit of LZ4. The output must hold getMaxCompressedSize() bytes.
+    size_t getMaxCompressedSize(size_t size);
+    size_t compress(const uint8_t* source, size_t size, uint8_t* destination);
+    // Throws std::runtime_error if the block is corrupted or does not decompress to exactly `size` bytes.
+    void decompress(const uint8_t* source, size_t compressedSize, uint8_t* destination, size_t size);
+
+    // Followed by the compressed pixels.
+    struct ChunkHeader {
+        uint32_t magic;
+        uint32_t flags;
+        uint64_t timestamp; // In nanoseconds since the first frame.
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        DirtyRects::Rect dirty;
+        uint32_t rawSize;
+        uint32_t compressedSize;
+    };
+
+    struct RecorderStats {
+        uint64_t frames = 0;
+        uint64_t dropped = 0; // Frames dropped because the writer was too far behind.
+        uint64_t rawBytes = 0;
+        uint64_t writtenBytes = 0;
+    };
+
+    // Writes the frames to a file from a background thread.
+    class Recorder {
+      public:
+        // Throws std::runtime_error if the file cannot be created.
+        explicit Recorder(const std::string& path, size_t maxQueuedBytes = 256 << 20);
+        // Writes the queued frames before returning.
+        ~Recorder();
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        // Copy a frame into the queue. Returns false if the frame was dropped. The timestamp is in nanoseconds.
+        bool addFrame(uint64_t timestamp,
+                      uint32_t width,
+                      uint32_t height,
+                      uint32_t pitch,
+                      uint32_t format,
+                      const uint8_t* pixels);
+
+        // Wait until the queued frames are written.
+        void flush();
+
+        RecorderStats getStats() const;
+
+      private:
+        struct QueuedFrame {
+            uint64_t timestamp;
+            uint32_t width;
+            uint32_t height;
+            uint32_t format;
+            std::vector<uint8_t> pixels;
+        };
+
+        void threadMain();
+        void writeFrame(const QueuedFrame& frame);
+
+        FILE* m_file = nullptr;
+        const size_t m_maxQueuedBytes;
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        std::condition_variable m_written;
+        std::deque<QueuedFrame> m_queue;
+        std::vector<std::vector<uint8_t>> m_freeBuffers;
+        size_t m_queuedBytes = 0;
+        RecorderStats m_stats;
+        bool m_stop = false;
+
+        // Owned by the writer thread.
+        std::vector<uint8_t> m_previous;
+        uint32_t m_previousWidth = 0;
+        uint32_t m_previousHeight = 0;
+        uint32_t m_previousFormat = 0;
+        uint64_t m_firstTimestamp = 0;
+        uint64_t m_framesSinceKeyframe = 0;
+        std::vector<uint8_t> m_delta;
+        std::vector<uint8_t> m_compressed;
+
+        std::thread m_thread;
+    };
+
+    struct Frame {
+        uint64_t timestamp = 0; // In nanoseconds since the first frame.
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t pitch = 0;
+        uint32_t format = 0;
+        DirtyRects::Rect dirty; // Region that changed since the previous frame.
+        const uint8_t* pixels = nullptr;
+    };
+
+    // Reads the frames of a recording, in order.
+    class Reader {
+      public:
+        // Throws std::runtime_error if the file cannot be opened or is not a recording.
+        explicit Reader(const std::string& path);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Decode the next frame. The pixels remain valid until the next call. Returns false at the end of the
+        // recording, throws std::runtime_error if it is corrupted.
+        bool next(Frame& frame);
+
+        // Timestamp of the next frame, without decoding it. Returns false at the end of the recording.
+        bool peekTimestamp(uint64_t& timestamp);
+
+        void rewind();
+
+      private:
+        bool readHeader();
+
+        FILE* m_file = nullptr;
+        long m_dataOffset = 0;
+        ChunkHeader m_header{};
+        bool m_hasHeader = false;
+        std::vector<uint8_t> m_pixels;
+        std::vector<uint8_t> m_delta;
+        std::vector<uint8_t> m_compressed;
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+    };
+
+    // Plays a recording back in a loop, at its original pace or as fast as possible.
+    class Player {
+      public:
+        Player(const std::string& path, bool isRealTime);
+
+        // Returns the most recent frame due at that time (in nanoseconds), or nullptr if there is no new frame. When
+        // several frames were due, the dirty rectangle covers all of them.
+        const Frame* update(uint64_t now);
+
+      private:
+        Reader m_reader;
+        const bool m_isRealTime;
+        Frame m_frame;
+        bool m_hasFrame = false;
+        bool m_started = false;
+        uint64_t m_startTime = 0;
+    };
+
+} // namespace Recording
@@ -0,0 +1,215 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+
+#include "rect_packer.h"
+
+namespace {
+
+    // Shelves are opened at a multiple of this height, so that they can be reused by rectangles of slightly different
+    // heights.
+    constexpr int32_t ShelfGranularity = 8;
+
+    // A rectangle may go in a taller shelf, as long as it does not waste more than that fraction of its height.
+    constexpr float MaxShelfWaste = 0.5f;
+
+} // namespace
+
+namespace Atlas {
+
+    // The page is treated as if it had the padding on its right and bottom edges, so that rectangles can touch them.
+    RectPacker::RectPacker(int32_t width, int32_t height, int32_t padding)
+        : m_width(width), m_height(height), m_padding(padding) {
+    }
+
+    bool RectPacker::isEmpty(const Shelf& shelf) const {
+        return shelf.free.size() == 1 && shelf.free[0].width == m_width + m_padding;
+    }
+
+    std::optional<RectPacker::Placement> RectPacker::place(int32_t width, int32_t height) {
+        const int32_t paddedWidth = width + m_padding;
+        const int32_t paddedHeight = height + m_padding;
+        if (width <= 0 || height <= 0 || paddedWidth > m_width + m_padding || paddedHeight > m_height + m_padding) {
+            return {};
+        }
+
+        // Best fit among the existing shelves: the least height wasted, then the narrowest span. Empty shelves take
+        // any height, the others only similar heights, unless the page is full.
+        const auto findShelf = [&](bool allowWaste) -> std::optional<std::pair<uint32_t, size_t>> {
+            std::optional<std::pair<uint32_t, size_t>> best;
+            int32_t bestWaste = 0;
+            int32_t bestSpan = 0;
+            for (uint32_t i = 0; i < m_shelves.size(); i++) {
+                const Shelf& shelf = m_shelves[i];
+                const int32_t waste = shelf.height - paddedHeight;
+                if (waste < 0 || (!allowWaste && !isEmpty(shelf) && waste > paddedHeight * MaxShelfWaste)) {
+                    continue;
+                }
+                for (size_t j = 0; j < shelf.free.size(); j++) {
+                    const int32_t span = shelf.free[j].width;
+                    if (span < paddedWidth) {
+                        continue;
+                    }
+                    if (!best || waste < bestWaste || (waste == bestWaste && span < bestSpan)) {
+                        best = {i, j};
+                        bestWaste = waste;
+                        bestSpan = span;
+                    }
+                }
+            }
+            return best;
+        };
+
+        auto found = findShelf(false);
+        if (!found) {
+            // Open a new shelf.
+            if (m_top + paddedHeight <= m_height + m_padding) {
+                const int32_t shelfHeight =
+                    std::min((paddedHeight + ShelfGranularity - 1) / ShelfGranularity * ShelfGranularity,
+                             m_height + m_padding - m_top);
+                m_shelves.push_back({m_top, shelfHeight, {{0, m_width + m_padding}}});
+                m_top += shelfHeight;
+                found = {{static_cast<uint32_t>(m_shelves.size() - 1), 0}};
+            } else {
+                found = findShelf(true);
+            }
+        }
+        if (!found) {
+            return {};
+        }
+
+        Shelf& shelf = m_shelves[found->first];
+        Span& span = shelf.free[found->second];
+        const Placement placement{found->first, {span.x, shelf.y, width, height}};
+        span.x += paddedWidth;
+        span.width -= paddedWidth;
+        if (!span.width) {
+            shelf.free.erase(shelf.free.begin() + found->second);
+        }
+        return placement;
+    }
+
+    std::optional<RectPacker::Id> RectPacker::allocate(int32_t width, int32_t height) {
+        const auto placement = place(width, height);
+        if (!placement) {
+            return {};
+        }
+
+        Id id;
+        if (!m_freeIds.empty()) {
+            id = m_freeIds.back();
+            m_freeIds.pop_back();
+        } else {
+            m_allocations.emplace_back();
+            id = static_cast<Id>(m_allocations.size());
+        }
+        Allocation& allocation = m_allocations[id - 1];
+        allocation.rect = placement->rect;
+        allocation.shelf = placement->shelf;
+        allocation.live = true;
+        m_count++;
+        m_allocatedArea += static_cast<int64_t>(width) * height;
+        return id;
+    }
+
+    void RectPacker::free(Id id) {
+        Allocation& allocation = m_allocations[id - 1];
+        allocation.live = false;
+        m_freeIds.push_back(id);
+        m_count--;
+        m_allocatedArea -= static_cast<int64_t>(allocation.rect.width) * allocation.rect.height;
+
+        // Give the range back to the shelf, merged with its neighbors.
+        Shelf& shelf = m_shelves[allocation.shelf];
+        Span freed{allocation.rect.x, allocation.rect.width + m_padding};
+        auto next = std::lower_bound(
+            shelf.free.begin(), shelf.free.end(), freed.x, [](const Span& span, int32_t x) { return span.x < x; });
+        if (next != shelf.free.end() && freed.x + freed.width == next->x) {
+            freed.width += next->width;
+            next = shelf.free.erase(next);
+        }
+        if (next != shelf.free.begin()) {
+            Span& previous = *(next - 1);
+            if (previous.x + previous.width == freed.x) {
+                previous.width += freed.width;
+                freed.width = 0;
+            }
+        }
+        if (freed.width) {
+            shelf.free.insert(next, freed);
+        }
+
+        // Reclaim the empty shelves at the top.
+        while (!m_shelves.empty() && isEmpty(m_shelves.back())) {
+            m_top = m_shelves.back().y;
+            m_shelves.pop_back();
+        }
+    }
+
+    bool RectPacker::repack() {
+        std::vector<Id> ids;
+        ids.reserve(m_count);
+        for (Id id = 1; id <= m_allocations.size(); id++) {
+            if (m_allocations[id - 1].live) {
+                ids.push_back(id);
+            }
+        }
+        std::sort(ids.begin(), ids.end(), [&](Id a, Id b) {
+            const Rect& rectA = m_allocations[a - 1].rect;
+            const Rect& rectB = m_allocations[b - 1].rect;
+            if (rectA.height != rectB.height) {
+                return rectA.height > rectB.height;
+            }
+            if (rectA.width != rectB.width) {
+                return rectA.width > rectB.width;
+            }
+            return a < b;
+        });
+
+        std::vector<Shelf> shelves;
+        shelves.swap(m_shelves);
+        const int32_t top = m_top;
+        m_top = 0;
+
+        std::vector<Placement> placements;
+        placements.reserve(ids.size());
+        for (const Id id : ids) {
+            const Rect& rect = m_allocations[id - 1].rect;
+            const auto placement = place(rect.width, rect.height);
+            if (!placement) {
+                m_shelves.swap(shelves);
+                m_top = top;
+                return false;
+            }
+            placements.push_back(placement.value());
+        }
+
+        for (size_t i = 0; i < ids.size(); i++) {
+            m_allocations[ids[i] - 1].rect = placements[i].rect;
+            m_allocations[ids[i] - 1].shelf = placements[i].shelf;
+        }
+        return true;
+    }
+
+} // namespace Atlas
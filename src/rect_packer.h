@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Atlas {
+
+    struct Rect {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    // Packs rectangles into a page, in shelves (rows of rectangles of similar heights). Freed space is reused by later
+    // rectangles of a similar height, and the shelves left empty at the top of the page are reclaimed. repack()
+    // compacts the page from scratch once it becomes too fragmented.
+    class RectPacker {
+      public:
+        // Never 0.
+        using Id = uint32_t;
+
+        // The padding is left between the rectangles, so that filtering does not bleed across them.
+        RectPacker(int32_t width, int32_t height, int32_t padding = 1);
+
+        std::optional<Id> allocate(int32_t width, int32_t height);
+        void free(Id id);
+
+        const Rect& get(Id id) const {
+            return m_allocations[id - 1].rect;
+        }
+
+        // Place all the rectangles again, tallest first. The ids are kept, the rectangles may move. Returns false and
+        // leaves the page untouched if they no longer fit.
+        bool repack();
+
+        // Area of the rectangles over the area of the page.
+        float getOccupancy() const {
+            return static_cast<float>(m_allocatedArea) / (static_cast<float>(m_width) * m_height);
+        }
+
+        size_t getCount() const {
+            return m_count;
+        }
+
+        int32_t getWidth() const {
+            return m_width;
+        }
+
+        int32_t getHeight() const {
+            return m_height;
+        }
+
+      private:
+        // A free range of a shelf.
+        struct Span {
+            int32_t x;
+            int32_t width;
+        };
+
+        struct Shelf {
+            int32_t y;
+            int32_t height;
+            // Sorted by position.
+            std::vector<Span> free;
+        };
+
+        struct Allocation {
+            Rect rect;
+            uint32_t shelf = 0;
+            bool live = false;
+        };
+
+        struct Placement {
+            uint32_t shelf;
+            Rect rect;
+        };
+
+        std::optional<Placement> place(int32_t width, int32_t height);
+        bool isEmpty(const Shelf& shelf) const;
+
+        const int32_t m_width;
+        const int32_t m_height;
+        const int32_t m_padding;
+
+        std::vector<Shelf> m_shelves;
+        int32_t m_top = 0;
+
+        std::vector<Allocation> m_allocations;
+        std::vector<Id> m_freeIds;
+        size_t m_count = 0;
+        int64_t m_allocatedArea = 0;
+    };
+
+} // namespace Atlas
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Capture {
+
+    struct ResizeConfig {
+        // How long the content size must stay the same before we resize, in seconds.
+        double settleTime = 0.15;
+        // Resize anyway when the size keeps changing for that long, so that a slow drag still refreshes.
+        double maxDelay = 0.5;
+    };
+
+    // Decides when to recreate a frame pool whose size no longer matches the content, without reallocating on every
+    // frame of a live resize.
+    class ResizeDebouncer {
+      public:
+        explicit ResizeDebouncer(const ResizeConfig& config = {}) : m_config(config) {
+        }
+
+        // Returns true when the pool should be recreated with the content size. Call on every poll with the content
+        // size of the latest frame, not only when frames arrive: a window may stop presenting right after a resize.
+        bool update(int32_t contentWidth, int32_t contentHeight, int32_t poolWidth, int32_t poolHeight, double now) {
+            if (contentWidth == poolWidth && contentHeight == poolHeight) {
+                m_isPending = false;
+                return false;
+            }
+
+            if (!m_isPending || contentWidth != m_pendingWidth || contentHeight != m_pendingHeight) {
+                if (!m_isPending) {
+                    m_firstMismatch = now;
+                }
+                m_isPending = true;
+                m_pendingWidth = contentWidth;
+                m_pendingHeight = contentHeight;
+                m_lastChange = now;
+            }
+
+            if (now - m_lastChange >= m_config.settleTime || now - m_firstMismatch >= m_config.maxDelay) {
+                m_isPending = false;
+                return true;
+            }
+            return false;
+        }
+
+      private:
+        const ResizeConfig m_config;
+
+        bool m_isPending = false;
+        int32_t m_pendingWidth = 0;
+        int32_t m_pendingHeight = 0;
+        double m_firstMismatch = 0;
+        double m_lastChange = 0;
+    };
+
+} // namespace Capture
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+
+    // Entries stored in reusable slots and indexed by key. Erasing an entry leaves the other entries in place, and the
+    // ids are never reused, so a stale id simply no longer resolves. Pointers to the entries are invalidated by
+    // insertions only.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class SlotMap {
+      public:
+        // The generation in the upper half and the slot index in the lower half. Never 0.
+        using Id = uint64_t;
+
+        // Returns the id of the entry and whether it was inserted. An existing entry with the same key is left as-is.
+        std::pair<Id, bool> insert(const Key& key, Value value) {
+            const auto [it, inserted] = m_index.try_emplace(key, 0);
+            if (!inserted) {
+                return {it->second, false};
+            }
+
+            uint32_t index;
+            if (!m_free.empty()) {
+                index = m_free.back();
+                m_free.pop_back();
+            } else {
+                index = static_cast<uint32_t>(m_slots.size());
+                m_slots.emplace_back();
+            }
+            Slot& slot = m_slots[index];
+            slot.key = key;
+            slot.value.emplace(std::move(value));
+
+            it->second = makeId(slot.generation, index);
+            m_size++;
+            return {it->second, true};
+        }
+
+        Value* find(const Key& key) {
+            const auto it = m_index.find(key);
+            return it != m_index.end() ? &*m_slots[getIndex(it->second)].value : nullptr;
+        }
+
+        Value* get(Id id) {
+            const uint32_t index = getIndex(id);
+            if (index >= m_slots.size() || m_slots[index].generation != getGeneration(id) || !m_slots[index].value) {
+                return nullptr;
+            }
+            return &*m_slots[index].value;
+        }
+
+        bool erase(const Key& key) {
+            const auto it = m_index.find(key);
+            if (it == m_index.end()) {
+                return false;
+            }
+            release(getIndex(it->second));
+            m_index.erase(it);
+            return true;
+        }
+
+        bool erase(Id id) {
+            if (!get(id)) {
+                return false;
+            }
+            const uint32_t index = getIndex(id);
+            m_index.erase(m_slots[index].key);
+            release(index);
+            return true;
+        }
+
+        // Visit the entries in slot order. The callback may erase the entry it is given, but must not insert.
+        template <typename Callback>
+        void forEach(Callback&& callback) {
+            for (uint32_t index = 0; index < m_slots.size(); index++) {
+                Slot& slot = m_slots[index];
+                if (slot.value) {
+                    callback(makeId(slot.generation, index), *slot.value);
+                }
+            }
+        }
+
+        size_t size() const {
+            return m_size;
+        }
+
+        bool empty() const {
+            return m_size == 0;
+        }
+
+      private:
+        struct Slot {
+            uint32_t generation = 1;
+            Key key{};
+            std::optional<Value> value;
+        };
+
+        static Id makeId(uint32_t generation, uint32_t index) {
+            return (static_cast<uint64_t>(generation) << 32) | index;
+        }
+
+        static uint32_t getIndex(Id id) {
+            return static_cast<uint32_t>(id);
+        }
+
+        static uint32_t getGeneration(Id id) {
+            return static_cast<uint32_t>(id >> 32);
+        }
+
+        void release(uint32_t index) {
+            Slot& slot = m_slots[index];
+            slot.value.reset();
+            // Skip 0 on wrap-around, so that ids are never 0.
+            slot.generation = slot.generation + 1 ? slot.generation + 1 : 1;
+            m_free.push_back(index);
+            m_size--;
+        }
+
+        std::vector<Slot> m_slots;
+        std::vector<uint32_t> m_free;
+        std::unordered_map<Key, Id, Hash> m_index;
+        size_t m_size = 0;
+    };
+
+} // namespace Utils
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace Capture {
+
+    struct TextureKey {
+        int32_t width = 0;
+        int32_t height = 0;
+        int64_t format = 0;
+
+        bool operator==(const TextureKey& other) const {
+            return width == other.width && height == other.height && format == other.format;
+        }
+
+        // All the formats we capture to use 4 bytes per pixel.
+        uint64_t getSize() const {
+            return static_cast<uint64_t>(width) * height * 4;
+        }
+    };
+
+    struct TexturePoolStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    // Keeps released textures, keyed by size and format, for reuse by new or resized overlays. The least recently
+    // released textures are evicted once the pool exceeds its budget. Thread-safe.
+    template <typename Texture>
+    class TexturePool {
+      public:
+        explicit TexturePool(uint64_t maxBytes = 256ull << 20) : m_maxBytes(maxBytes) {
+        }
+
+        // Returns an empty texture if there is no match.
+        Texture acquire(const TextureKey& key) {
+            std::unique_lock lock(m_mutex);
+            for (auto it = m_free.rbegin(); it != m_free.rend(); it++) {
+                if (it->first == key) {
+                    Texture texture = std::move(it->second);
+                    m_free.erase(std::next(it).base());
+                    m_bytes -= key.getSize();
+                    m_stats.hits++;
+                    return texture;
+                }
+            }
+            m_stats.misses++;
+            return {};
+        }
+
+        void release(const TextureKey& key, Texture texture) {
+            if (!texture || key.getSize() > m_maxBytes) {
+                return;
+            }
+
+            std::unique_lock lock(m_mutex);
+            m_free.emplace_back(key, std::move(texture));
+            m_bytes += key.getSize();
+            while (m_bytes > m_maxBytes) {
+                m_bytes -= m_free.front().first.getSize();
+                m_free.pop_front();
+                m_stats.evictions++;
+            }
+        }
+
+        TexturePoolStats getStats() const {
+            std::unique_lock lock(m_mutex);
+            return m_stats;
+        }
+
+        uint64_t getBytes() const {
+            std::unique_lock lock(m_mutex);
+            return m_bytes;
+        }
+
+      private:
+        const uint64_t m_maxBytes;
+
+        mutable std::mutex m_mutex;
+        std::deque<std::pair<TextureKey, Texture>> m_free;
+        uint64_t m_bytes = 0;
+        TexturePoolStats m_stats;
+    };
+
+} // namespace Capture
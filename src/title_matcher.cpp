@@ -0,0 +1,221 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <cstring>
+#include <deque>
+
+#include "title_matcher.h"
+
+namespace {
+
+    constexpr uint32_t NoTransition = ~0u;
+
+    char foldCase(char c) {
+        return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+
+    bool isAlphaNumeric(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+
+    // Extract the case-folded literal from an expression that does not use any regular expression construct other
+    // than anchors and escaped punctuation.
+    bool parseLiteral(const std::string& expression, std::string& literal, bool& anchorBegin, bool& anchorEnd) {
+        size_t begin = 0;
+        size_t end = expression.size();
+
+        anchorBegin = begin < end && expression[begin] == '^';
+        if (anchorBegin) {
+            begin++;
+        }
+
+        // Only consider a trailing $ if it is not escaped.
+        size_t backslashes = 0;
+        while (end >= 2 + backslashes && expression[end - 2 - backslashes] == '\\') {
+            backslashes++;
+        }
+        anchorEnd = end > begin && expression[end - 1] == '$' && backslashes % 2 == 0;
+        if (anchorEnd) {
+            end--;
+        }
+
+        literal.clear();
+        for (size_t i = begin; i < end; i++) {
+            char c = expression[i];
+            if (c == '\\') {
+                if (i + 1 >= end || isAlphaNumeric(expression[i + 1])) {
+                    return false;
+                }
+                c = expression[++i];
+            } else if (strchr("^$.|?*+()[]{}", c)) {
+                return false;
+            }
+            literal += foldCase(c);
+        }
+
+        return !literal.empty();
+    }
+
+} // namespace
+
+namespace TitleMatcher {
+
+    void Matcher::add(const std::string& expression) {
+        addFilter(expression);
+        compile();
+    }
+
+    void Matcher::add(const std::vector<std::string>& expressions) {
+        for (const auto& expression : expressions) {
+            addFilter(expression);
+        }
+        compile();
+    }
+
+    void Matcher::addFilter(const std::string& expression) {
+        Filter filter;
+        std::string literal;
+        if (parseLiteral(expression, literal, filter.anchorBegin, filter.anchorEnd)) {
+            filter.isLiteral = true;
+            filter.length = literal.size();
+        } else {
+            filter.regex = std::regex(expression, std::regex_constants::ECMAScript | std::regex_constants::icase);
+            literal.clear();
+        }
+
+        m_filters.push_back(std::move(filter));
+        m_literals.push_back(std::move(literal));
+    }
+
+    MatchSet Matcher::match(std::string_view title) const {
+        MatchSet matches(m_filters.size(), false);
+
+        if (m_transitions.size() > m_classCount) {
+            uint32_t state = 0;
+            for (size_t i = 0; i < title.size(); i++) {
+                state = m_transitions[state * m_classCount + m_classes[static_cast<uint8_t>(title[i])]];
+
+                const auto& output = m_stateOutputs[state];
+                for (uint32_t j = output.first; j < output.second; j++) {
+                    const uint32_t index = m_outputs[j];
+                    const auto& filter = m_filters[index];
+                    if (filter.anchorBegin && i + 1 != filter.length) {
+                        continue;
+                    }
+                    if (filter.anchorEnd && i + 1 != title.size()) {
+                        continue;
+                    }
+                    matches[index] = true;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < m_filters.size(); i++) {
+            if (!m_filters[i].isLiteral) {
+                matches[i] = std::regex_search(title.begin(), title.end(), m_filters[i].regex);
+            }
+        }
+
+        return matches;
+    }
+
+    void Matcher::compile() {
+        // Group the characters that do not appear in any literal into the same class, and make both cases of a letter
+        // share a class.
+        memset(m_classes, 0, sizeof(m_classes));
+        m_classCount = 1;
+        for (const auto& literal : m_literals) {
+            for (const char c : literal) {
+                auto& characterClass = m_classes[static_cast<uint8_t>(c)];
+                if (!characterClass) {
+                    characterClass = static_cast<uint8_t>(m_classCount++);
+                }
+            }
+        }
+        for (char c = 'A'; c <= 'Z'; c++) {
+            m_classes[static_cast<uint8_t>(c)] = m_classes[static_cast<uint8_t>(foldCase(c))];
+        }
+
+        // Build the trie.
+        std::vector<std::vector<uint32_t>> stateOutputs(1);
+        m_transitions.assign(m_classCount, NoTransition);
+        for (uint32_t i = 0; i < m_literals.size(); i++) {
+            if (m_literals[i].empty()) {
+                continue;
+            }
+
+            uint32_t state = 0;
+            for (const char c : m_literals[i]) {
+                auto& next = m_transitions[state * m_classCount + m_classes[static_cast<uint8_t>(c)]];
+                if (next == NoTransition) {
+                    next = static_cast<uint32_t>(stateOutputs.size());
+                    stateOutputs.emplace_back();
+                    m_transitions.resize(m_transitions.size() + m_classCount, NoTransition);
+                }
+                // Resizing may have invalidated the reference.
+                state = m_transitions[state * m_classCount + m_classes[static_cast<uint8_t>(c)]];
+            }
+            stateOutputs[state].push_back(i);
+        }
+
+        // Compute the suffix links breadth-first, and turn the trie into a complete automaton.
+        std::vector<uint32_t> suffix(stateOutputs.size(), 0);
+        std::deque<uint32_t> queue;
+        for (uint32_t c = 0; c < m_classCount; c++) {
+            auto& next = m_transitions[c];
+            if (next == NoTransition) {
+                next = 0;
+            } else {
+                queue.push_back(next);
+            }
+        }
+        while (!queue.empty()) {
+            const uint32_t state = queue.front();
+            queue.pop_front();
+
+            const auto& inherited = stateOutputs[suffix[state]];
+            stateOutputs[state].insert(stateOutputs[state].end(), inherited.begin(), inherited.end());
+
+            for (uint32_t c = 0; c < m_classCount; c++) {
+                auto& next = m_transitions[state * m_classCount + c];
+                const uint32_t fallback = m_transitions[suffix[state] * m_classCount + c];
+                if (next == NoTransition) {
+                    next = fallback;
+                } else {
+                    suffix[next] = fallback;
+                    queue.push_back(next);
+                }
+            }
+        }
+
+        // Flatten the outputs.
+        m_stateOutputs.resize(stateOutputs.size());
+        m_outputs.clear();
+        for (size_t i = 0; i < stateOutputs.size(); i++) {
+            m_stateOutputs[i].first = static_cast<uint32_t>(m_outputs.size());
+            m_outputs.insert(m_outputs.end(), stateOutputs[i].begin(), stateOutputs[i].end());
+            m_stateOutputs[i].second = static_cast<uint32_t>(m_outputs.size());
+        }
+    }
+
+} // namespace TitleMatcher
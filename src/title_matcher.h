@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace TitleMatcher {
+
+    // Which filters matched, indexed like the filters were added.
+    using MatchSet = std::vector<bool>;
+
+    // Matches window titles against a set of case-insensitive ECMAScript expressions.
+    //
+    // Expressions that are plain literals (optionally anchored with ^ and $, and with escaped punctuation) are all
+    // compiled into a single case-folded Aho-Corasick automaton, which finds every literal in one pass over the title.
+    // Other expressions fall back to std::regex.
+    class Matcher {
+      public:
+        // Throws std::regex_error if the expression is invalid.
+        void add(const std::string& expression);
+        // Same as adding the expressions one by one, but only builds the automaton once.
+        void add(const std::vector<std::string>& expressions);
+
+        MatchSet match(std::string_view title) const;
+
+        size_t size() const {
+            return m_filters.size();
+        }
+
+        bool empty() const {
+            return m_filters.empty();
+        }
+
+      private:
+        struct Filter {
+            bool isLiteral = false;
+            bool anchorBegin = false;
+            bool anchorEnd = false;
+            size_t length = 0;
+            std::regex regex;
+        };
+
+        void addFilter(const std::string& expression);
+        void compile();
+
+        std::vector<std::string> m_literals;
+        std::vector<Filter> m_filters;
+
+        // The automaton, as a dense transition table over equivalence classes of characters.
+        uint8_t m_classes[256] = {};
+        uint32_t m_classCount = 1;
+        std::vector<uint32_t> m_transitions;
+        // Filters ending at each state (including via the suffix links), as ranges of m_outputs.
+        std::vector<std::pair<uint32_t, uint32_t>> m_stateOutputs;
+        std::vector<uint32_t> m_outputs;
+    };
+
+    // Caches the result of the matcher per window, so that windows whose title did not change are never re-matched.
+    template <typename Handle>
+    class MatchCache {
+      public:
+        // Returns the matches for the window, and whether they had to be computed (new window or new title).
+        std::pair<const MatchSet*, bool> match(const Matcher& matcher, Handle handle, std::string_view title) {
+            const uint64_t hash = std::hash<std::string_view>()(title);
+            auto& entry = m_entries[handle];
+            entry.pass = m_pass;
+            if (entry.valid && entry.hash == hash) {
+                return {&entry.matches, false};
+            }
+
+            entry.valid = true;
+            entry.hash = hash;
+            entry.matches = matcher.match(title);
+            return {&entry.matches, true};
+        }
+
+        // Forget the windows that were not looked up since the previous sweep.
+        void sweep() {
+            for (auto it = m_entries.begin(); it != m_entries.end();) {
+                if (it->second.pass != m_pass) {
+                    it = m_entries.erase(it);
+                } else {
+                    it++;
+                }
+            }
+            m_pass++;
+        }
+
+        void clear() {
+            m_entries.clear();
+        }
+
+      private:
+        struct Entry {
+            bool valid = false;
+            uint64_t hash = 0;
+            uint64_t pass = 0;
+            MatchSet matches;
+        };
+
+        std::unordered_map<Handle, Entry> m_entries;
+        uint64_t m_pass = 0;
+    };
+
+} // namespace TitleMatcher
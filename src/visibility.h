@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+namespace Visibility {
+
+    struct Vec3 {
+        float x = 0;
+        float y = 0;
+        float z = 0;
+    };
+
+    enum class Class {
+        InView,
+        Peripheral,
+        OutOfView,
+        Minimized,
+    };
+
+    struct Config {
+        // Half-angle of the cone considered in view, in radians. Roughly the field of view of the headset.
+        float inViewHalfAngle = 55.f * 3.14159265f / 180.f;
+        // Half-angle of the cone considered in the periphery, in radians. Beyond that, the overlay is out of view.
+        float peripheralHalfAngle = 85.f * 3.14159265f / 180.f;
+        // Minimum interval between two captured frames while in the periphery, in seconds.
+        float peripheralInterval = 0.1f;
+        // How far past the edge of its cone an overlay must be to leave a class, in radians.
+        float hysteresis = 5.f * 3.14159265f / 180.f;
+        // How long an overlay must stay out of view before its capture is suspended, in seconds.
+        float suspendDelay = 0.5f;
+    };
+
+    // What to do with an overlay given its visibility.
+    struct Policy {
+        bool capture = true;
+        bool render = true;
+        float minimumInterval = 0;
+    };
+
+    struct Head {
+        Vec3 position;
+        Vec3 forward; // Unit vector.
+    };
+
+    // Bounding sphere of an overlay.
+    struct Bounds {
+        Vec3 center;
+        float radius = 0;
+    };
+
+    struct Ray {
+        Vec3 origin;
+        Vec3 direction; // Unit vector.
+    };
+
+    // How much of the user's attention an overlay gets.
+    struct Attention {
+        // 1 at the center of the view, down to 0 at the edge of the in-view cone.
+        float gaze = 0;
+        // Angular radius of the overlay relative to the in-view cone, up to 1.
+        float apparentSize = 0;
+    };
+
+    // The class of an overlay over time.
+    struct State {
+        Class current = Class::InView;
+        // When the overlay went out of view while it still has its previous class, or a negative value.
+        double outOfViewSince = -1;
+    };
+
+    // An overlay only leaves the class it had previously once past the edge of its cone by the hysteresis margin. It
+    // enters a more visible class right at the edge.
+    inline Class classify(const Head& head,
+                          const Bounds& bounds,
+                          bool minimized,
+                          Class previous,
+                          const Config& config = {}) {
+        if (minimized) {
+            return Class::Minimized;
+        }
+
+        const Vec3 direction{bounds.center.x - head.position.x,
+                             bounds.center.y - head.position.y,
+                             bounds.center.z - head.position.z};
+        const float distance =
+            std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+        if (distance <= bounds.radius) {
+            // The head is within the overlay bounds.
+            return Class::InView;
+        }
+
+        const float cosine =
+            (direction.x * head.forward.x + direction.y * head.forward.y + direction.z * head.forward.z) / distance;
+        const float angle = std::acos(std::clamp(cosine, -1.f, 1.f));
+
+        // Account for the angular size of the overlay, so that we only reject it once fully outside of the cone.
+        const float angularRadius = std::asin(bounds.radius / distance);
+        const float nearestAngle = angle - angularRadius;
+        const float inViewMargin = previous == Class::InView ? config.hysteresis : 0;
+        const float peripheralMargin =
+            previous == Class::InView || previous == Class::Peripheral ? config.hysteresis : 0;
+        if (nearestAngle <= config.inViewHalfAngle + inViewMargin) {
+            return Class::InView;
+        }
+        if (nearestAngle <= config.peripheralHalfAngle + peripheralMargin) {
+            return Class::Peripheral;
+        }
+        return Class::OutOfView;
+    }
+
+    // Without a previous class, the edges of the cones are exact.
+    inline Class classify(const Head& head, const Bounds& bounds, bool minimized, const Config& config = {}) {
+        return classify(head, bounds, minimized, Class::OutOfView, config);
+    }
+
+    // Classifies an overlay on every frame. Stopping and restarting a capture costs much more than capturing, so a
+    // head pose hovering at an edge must not flip the class on every frame: on top of the hysteresis, an overlay keeps
+    // its class until it stayed out of view for the suspend delay. It comes back in view right away.
+    inline Class track(State& state,
+                       const Head& head,
+                       const Bounds& bounds,
+                       bool minimized,
+                       double now,
+                       const Config& config = {}) {
+        Class visibility = classify(head, bounds, minimized, state.current, config);
+        if (visibility != Class::OutOfView || state.current == Class::OutOfView ||
+            state.current == Class::Minimized) {
+            state.outOfViewSince = -1;
+        } else {
+            if (state.outOfViewSince < 0) {
+                state.outOfViewSince = now;
+            }
+            if (now - state.outOfViewSince < config.suspendDelay) {
+                visibility = state.current;
+            } else {
+                state.outOfViewSince = -1;
+            }
+        }
+        state.current = visibility;
+        return visibility;
+    }
+
+    inline Attention getAttention(const Head& head, const Bounds& bounds, const Config& config = {}) {
+        const Vec3 direction{bounds.center.x - head.position.x,
+                             bounds.center.y - head.position.y,
+                             bounds.center.z - head.position.z};
+        const float distance =
+            std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+        if (distance <= bounds.radius) {
+            return {1, 1};
+        }
+
+        const float cosine =
+            (direction.x * head.forward.x + direction.y * head.forward.y + direction.z * head.forward.z) / distance;
+        const float angle = std::acos(std::clamp(cosine, -1.f, 1.f));
+        const float angularRadius = std::asin(bounds.radius / distance);
+
+        Attention attention;
+        attention.gaze = std::clamp(1 - std::max(angle - angularRadius, 0.f) / config.inViewHalfAngle, 0.f, 1.f);
+        attention.apparentSize = std::min(angularRadius / config.inViewHalfAngle, 1.f);
+        return attention;
+    }
+
+    // Whether the ray (eg: from a hand) goes through the bounds of an overlay.
+    inline bool isPointedAt(const Ray& ray, const Bounds& bounds) {
+        const Vec3 toCenter{bounds.center.x - ray.origin.x,
+                            bounds.center.y - ray.origin.y,
+                            bounds.center.z - ray.origin.z};
+        const float along = toCenter.x * ray.direction.x + toCenter.y * ray.direction.y + toCenter.z * ray.direction.z;
+        const float squaredDistance = toCenter.x * toCenter.x + toCenter.y * toCenter.y + toCenter.z * toCenter.z;
+        if (along < 0) {
+            return squaredDistance <= bounds.radius * bounds.radius;
+        }
+        return squaredDistance - along * along <= bounds.radius * bounds.radius;
+    }
+
+    inline Policy getPolicy(Class visibility, const Config& config = {}) {
+        Policy policy;
+        switch (visibility) {
+        case Class::InView:
+            break;
+        case Class::Peripheral:
+            policy.minimumInterval = config.peripheralInterval;
+            break;
+        case Class::OutOfView:
+        case Class::Minimized:
+            policy.capture = policy.render = false;
+            break;
+        }
+        return policy;
+    }
+
+    inline const char* toString(Class visibility) {
+        switch (visibility) {
+        case Class::InView:
+            return "In view";
+        case Class::Peripheral:
+            return "Peripheral";
+        case Class::OutOfView:
+            return "Out of view";
+        case Class::Minimized:
+            return "Minimized";
+        }
+        return "";
+    }
+
+} // namespace Visibility
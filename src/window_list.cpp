@@ -0,0 +1,188 @@
+// MIT License
+//
+// Copyright(c) 2024 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+
+#include "instrumentation.h"
+#include "window_list.h"
+
+namespace WindowList {
+
+    bool WindowListModel::apply(const Event& event, IWindowEventSource& source) {
+        if (event.type == EventType::Destroyed) {
+            return erase(event.handle);
+        }
+
+        // Creation and renames are re-queried, since the window might not be eligible (yet).
+        const auto info = source.query(event.handle);
+        if (!info) {
+            return erase(event.handle);
+        }
+        return upsert(info.value());
+    }
+
+    bool WindowListModel::reset(const std::vector<WindowInfo>& windows) {
+        bool changed = false;
+
+        std::unordered_map<Handle, Entry> previous;
+        previous.swap(m_windows);
+        m_windows.reserve(windows.size());
+        for (const auto& info : windows) {
+            auto it = previous.find(info.handle);
+            if (it != previous.end()) {
+                // Keep the original order of known windows.
+                changed = changed || it->second.title != info.title || it->second.process != info.process;
+                it->second.title = info.title;
+                it->second.process = info.process;
+                m_windows.insert(previous.extract(it));
+            } else {
+                m_windows.emplace(info.handle, Entry{info.title, info.process, m_nextOrder++});
+                changed = true;
+            }
+        }
+
+        // Whatever was not re-enumerated is gone.
+        return changed || !previous.empty();
+    }
+
+    std::shared_ptr<const Snapshot> WindowListModel::makeSnapshot(uint64_t generation) const {
+        std::vector<std::pair<uint64_t, WindowInfo>> ordered;
+        ordered.reserve(m_windows.size());
+        for (const auto& [handle, entry] : m_windows) {
+            ordered.push_back({entry.order, WindowInfo{handle, entry.title, entry.process}});
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->generation = generation;
+        snapshot->windows.reserve(ordered.size());
+        for (auto& entry : ordered) {
+            snapshot->windows.push_back(std::move(entry.second));
+        }
+
+        return snapshot;
+    }
+
+    bool WindowListModel::upsert(const WindowInfo& info) {
+        auto it = m_windows.find(info.handle);
+        if (it == m_windows.end()) {
+            m_windows.emplace(info.handle, Entry{info.title, info.process, m_nextOrder++});
+            return true;
+        }
+        if (it->second.title != info.title || it->second.process != info.process) {
+            it->second.title = info.title;
+            it->second.process = info.process;
+            return true;
+        }
+        return false;
+    }
+
+    bool WindowListModel::erase(Handle handle) {
+        return m_windows.erase(handle) > 0;
+    }
+
+    WindowEnumerator::WindowEnumerator(std::shared_ptr<IWindowEventSource> source,
+                                       std::chrono::milliseconds rescanPeriod)
+        : m_source(std::move(source)), m_rescanPeriod(rescanPeriod) {
+        m_source->start([this](const Event& event) { pushEvent(event); });
+        m_thread = std::thread([this] { threadMain(); });
+    }
+
+    WindowEnumerator::~WindowEnumerator() {
+        m_source->stop();
+        {
+            std::unique_lock lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_one();
+        m_thread.join();
+    }
+
+    void WindowEnumerator::requestRescan() {
+        {
+            std::unique_lock lock(m_mutex);
+            m_rescanRequested = true;
+        }
+        m_wakeUp.notify_one();
+    }
+
+    void WindowEnumerator::pushEvent(const Event& event) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_pendingEvents.push_back(event);
+        }
+        m_wakeUp.notify_one();
+    }
+
+    void WindowEnumerator::threadMain() {
+        WindowListModel model;
+        uint64_t generation = 0;
+        std::vector<Event> events;
+        std::vector<WindowInfo> windows;
+        auto nextRescan = std::chrono::steady_clock::now();
+
+        while (true) {
+            bool rescan;
+            {
+                std::unique_lock lock(m_mutex);
+                m_wakeUp.wait_until(lock, nextRescan, [&] {
+                    return m_stop || m_rescanRequested || !m_pendingEvents.empty();
+                });
+                if (m_stop) {
+                    break;
+                }
+                rescan = m_rescanRequested || std::chrono::steady_clock::now() >= nextRescan;
+                m_rescanRequested = false;
+                events.swap(m_pendingEvents);
+            }
+
+            bool changed = false;
+            if (rescan) {
+                // A full rescan supersedes any pending event.
+                Instrumentation::Scope scope("enumeration rescan");
+                windows.clear();
+                m_source->enumerate(windows);
+                changed = model.reset(windows);
+                nextRescan = std::chrono::steady_clock::now() + m_rescanPeriod;
+            } else {
+                // Windows tend to emit bursts of events, only process the most recent one for each window.
+                Instrumentation::Scope scope("enumeration events");
+                std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+                    return std::less<Handle>()(a.handle, b.handle);
+                });
+                for (auto it = events.begin(); it != events.end(); it++) {
+                    auto next = it + 1;
+                    if (next != events.end() && next->handle == it->handle) {
+                        continue;
+                    }
+                    changed = model.apply(*it, *m_source) || changed;
+                }
+            }
+            events.clear();
+
+            if (changed || !getSnapshot()) {
+                std::atomic_store(&m_snapshot, model.makeSnapshot(++generation));
+            }
+        }
+    }
+
+} // namespace WindowList
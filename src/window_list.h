@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace WindowList {
+
+    // Opaque native window handle (HWND on Windows).
+    using Handle = void*;
+
+    struct WindowInfo {
+        Handle handle = nullptr;
+        std::string title;
+        // Image name of the owning process (eg: "notepad.exe"), if known.
+        std::string process;
+    };
+
+    // Immutable list of windows published by the enumerator. Windows are listed in the order they were discovered.
+    struct Snapshot {
+        uint64_t generation = 0;
+        std::vector<WindowInfo> windows;
+    };
+
+    enum class EventType {
+        Created,
+        Destroyed,
+        NameChanged,
+    };
+
+    struct Event {
+        EventType type;
+        Handle handle;
+    };
+
+    // Platform source of window events and window information.
+    struct IWindowEventSource {
+        virtual ~IWindowEventSource() = default;
+
+        // Start delivering events to the sink. The sink may be invoked from any thread.
+        virtual void start(std::function<void(const Event&)> sink) = 0;
+        virtual void stop() = 0;
+
+        // Full enumeration of the eligible windows.
+        virtual void enumerate(std::vector<WindowInfo>& windows) = 0;
+
+        // Information about a single window, or nothing if the window is no longer eligible.
+        virtual std::optional<WindowInfo> query(Handle handle) = 0;
+
+        // Whether the window still exists, regardless of its eligibility.
+        virtual bool isAlive(Handle handle) = 0;
+
+        // Enumeration of the monitors. Monitors are not tracked by the events.
+        virtual void enumerateMonitors(std::vector<WindowInfo>& monitors) = 0;
+
+        // Enumeration of the frame streams published by other processes (see frame_ring.h). Streams are not tracked by
+        // the events.
+        virtual void enumerateStreams(std::vector<WindowInfo>& streams) = 0;
+    };
+
+    // The incrementally maintained set of windows. Not thread-safe.
+    class WindowListModel {
+      public:
+        // Apply a window event. Returns true if the list changed.
+        bool apply(const Event& event, IWindowEventSource& source);
+
+        // Replace the content with a full enumeration. Returns true if the list changed.
+        bool reset(const std::vector<WindowInfo>& windows);
+
+        std::shared_ptr<const Snapshot> makeSnapshot(uint64_t generation) const;
+
+        size_t size() const {
+            return m_windows.size();
+        }
+
+      private:
+        bool upsert(const WindowInfo& info);
+        bool erase(Handle handle);
+
+        struct Entry {
+            std::string title;
+            std::string process;
+            uint64_t order;
+        };
+
+        std::unordered_map<Handle, Entry> m_windows;
+        uint64_t m_nextOrder = 0;
+    };
+
+    // Maintains the list of windows on a background thread, from the events of the source and with periodic full
+    // rescans as a fallback for missed events.
+    class WindowEnumerator {
+      public:
+        WindowEnumerator(std::shared_ptr<IWindowEventSource> source, std::chrono::milliseconds rescanPeriod);
+        ~WindowEnumerator();
+
+        // Latest published snapshot. Never blocks on the enumeration.
+        std::shared_ptr<const Snapshot> getSnapshot() const {
+            return std::atomic_load(&m_snapshot);
+        }
+
+        // Request a full rescan as soon as possible.
+        void requestRescan();
+
+      private:
+        void pushEvent(const Event& event);
+        void threadMain();
+
+        const std::shared_ptr<IWindowEventSource> m_source;
+        const std::chrono::milliseconds m_rescanPeriod;
+
+        std::shared_ptr<const Snapshot> m_snapshot;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        std::vector<Event> m_pendingEvents;
+        bool m_rescanRequested = true;
+        bool m_stop = false;
+
+        std::thread m_thread;
+    };
+
+} // namespace WindowList
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Utils {
+
+    // A fixed set of threads running tasks in submission order. Tasks still queued on destruction are abandoned, and
+    // their futures report a broken promise.
+    class WorkerPool {
+      public:
+        explicit WorkerPool(size_t threadCount) {
+            for (size_t i = 0; i < threadCount; i++) {
+                m_threads.emplace_back([this] { threadMain(); });
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::unique_lock lock(m_mutex);
+                m_stop = true;
+                m_tasks.clear();
+            }
+            m_wakeUp.notify_all();
+            for (auto& thread : m_threads) {
+                thread.join();
+            }
+        }
+
+        template <typename Function>
+        std::future<std::invoke_result_t<Function>> submit(Function&& function) {
+            using Result = std::invoke_result_t<Function>;
+
+            // std::function requires copyable callables.
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+            auto future = task->get_future();
+            {
+                std::unique_lock lock(m_mutex);
+                m_tasks.push_back([task] { (*task)(); });
+            }
+            m_wakeUp.notify_one();
+
+            return future;
+        }
+
+      private:
+        void threadMain() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_wakeUp.wait(lock, [&] { return m_stop || !m_tasks.empty(); });
+                    if (m_stop) {
+                        break;
+                    }
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        std::deque<std::function<void()>> m_tasks;
+        bool m_stop = false;
+        std::vector<std::thread> m_threads;
+    };
+
+} // namespace Utils